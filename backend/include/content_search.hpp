@@ -0,0 +1,201 @@
+#ifndef CONTENT_SEARCH_HPP
+#define CONTENT_SEARCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <regex.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "fuzzy_finder.hpp"
+#include "thread_pool.hpp"
+
+// A compiled /api/search query: a literal string, or a POSIX extended
+// regular expression matched one line at a time. Literals are found with an
+// SSE2 scan for the first and last bytes, verified by comparison; a regex
+// is only run on lines holding the longest literal every match must
+// contain, when it has one.
+class SearchPattern {
+public:
+    SearchPattern() = default;
+    ~SearchPattern();
+
+    SearchPattern(const SearchPattern&) = delete;
+    SearchPattern& operator=(const SearchPattern&) = delete;
+
+    // False with error set for an empty query or an invalid expression
+    bool compile(const std::string& query, bool regex, bool ignore_case, std::string& error);
+
+    // First match starting at or after from, which must be the start of a
+    // line; false if there is none
+    bool find(const char* data, size_t size, size_t from, size_t& match_start, size_t& match_length) const;
+
+    // Case-folded trigrams every matching file contains
+    const std::vector<uint32_t>& trigrams() const { return required_trigrams; }
+
+private:
+    bool is_regex = false;
+    bool ignore_case = false;
+    std::string literal;                 // The query, or the regex's required literal; lowercase if ignoring case
+    std::vector<uint32_t> required_trigrams;
+    regex_t compiled;
+    bool compiled_valid = false;
+};
+
+// Case-folded trigrams of a file hashed into a bit set of about eight bits
+// per distinct trigram, so a query of a few trigrams passes a file without
+// them only rarely
+class TrigramFilter {
+public:
+    // Collects a file's trigrams as it is read in pieces. Builders share
+    // per-thread scratch space, so a thread fills one at a time.
+    class Builder {
+    public:
+        Builder() = default;
+        Builder(const Builder&) = delete;
+        Builder& operator=(const Builder&) = delete;
+        ~Builder() { clear(); }
+
+        void add(const char* data, size_t size);
+        // The filter of everything added; the builder is then empty again
+        TrigramFilter finish();
+        void clear();
+
+    private:
+        std::vector<uint32_t> distinct;
+        uint32_t trigram = 0;            // Last bytes added, folded
+        size_t primed = 0;               // Bytes in trigram, up to two
+    };
+
+    // Built from the file's contents
+    static TrigramFilter build(const char* data, size_t size);
+
+    bool may_contain(const std::vector<uint32_t>& trigrams) const;
+    size_t memory_used() const { return bits.capacity() * sizeof(uint64_t); }
+
+private:
+    std::vector<uint64_t> bits;
+    unsigned shift = 0;                  // 32 - log2 of the bit count
+};
+
+// One file to search, with the stamp its listing gave it
+struct SearchFile {
+    std::string path;                    // Relative to the workspace root
+    FileStamp stamp;
+    bool refresh = true;                 // No current filter: build one while searching
+};
+
+// Trigram filters of each user's text files, so a search reads only files
+// that can match. Filters are built by the searches that read the files
+// anyway and are current while the file's size and modification time
+// are; files searched for the first time or changed since are always
+// read. Users' filters are dropped least recently used beyond the memory
+// budget.
+class ContentIndex {
+public:
+    explicit ContentIndex(size_t memory_budget) : memory_budget(memory_budget) {}
+
+    ContentIndex(const ContentIndex&) = delete;
+    ContentIndex& operator=(const ContentIndex&) = delete;
+
+    // Keep the files that may contain trigrams; complete says files is the
+    // whole workspace, so filters of files no longer in it are dropped.
+    // Returns how many files the filters ruled out.
+    size_t select(const std::string& username, std::vector<SearchFile>& files, const std::vector<uint32_t>& trigrams,
+                  bool complete);
+    // Store a file's filter after reading it; binary files get none and are skipped until changed
+    void update(const std::string& username, const std::string& path, const FileStamp& stamp, bool binary,
+                TrigramFilter filter);
+
+    size_t memory_used() const;
+    size_t user_count() const;
+
+private:
+    struct Entry {
+        FileStamp stamp;
+        bool binary = false;
+        TrigramFilter filter;
+        uint64_t seen = 0;               // Last select() that listed the file
+    };
+
+    struct UserFilters {
+        std::unordered_map<std::string, Entry> entries;
+        size_t bytes = 0;
+        uint64_t last_used = 0;
+        uint64_t generation = 0;
+    };
+
+    static size_t entry_bytes(const std::string& path, const Entry& entry);
+    // Drop other users until needed more bytes fit
+    void evict_for(const UserFilters* keep, size_t needed);
+
+    size_t memory_budget;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, UserFilters> users;
+    size_t total_bytes = 0;
+    uint64_t use_clock = 0;
+};
+
+struct SearchOptions {
+    size_t max_matches = 1000;           // Matching lines reported before stopping
+    size_t context_lines = 0;            // Lines before and after each match
+};
+
+// A content search running on a thread pool. Files are claimed one at a
+// time by up to one task per pool thread, and their hits are published as
+// newline-delimited JSON when each file is done, or sooner once many have
+// collected, so results arrive in file completion order. Readers never
+// block: take() hands over what is there, and wait() arranges a callback
+// for when there is more.
+class SearchJob : public std::enable_shared_from_this<SearchJob> {
+public:
+    SearchJob(std::string root, std::vector<SearchFile> files, std::shared_ptr<const SearchPattern> pattern,
+              SearchOptions options, ContentIndex* index, std::string username, size_t pruned);
+
+    void start(WorkStealingPool& pool);
+    // Stop claiming files and drop any waiting reader; running tasks finish
+    // the file they have
+    void cancel();
+
+    // Move output produced so far into out, possibly none. Ends with a
+    // summary line; false once that has been taken.
+    bool take(std::string& out);
+    // False if take() has something now; otherwise keep resume and call it
+    // once, from a search thread, when it does
+    bool wait(std::function<void()> resume);
+
+private:
+    void run();
+    void search_file(const SearchFile& file, std::string& buffer, TrigramFilter::Builder& trigrams, std::string& out);
+    void publish(std::string& out);
+    // line_lead counts bytes of the line that were dropped with an earlier block
+    void append_hit(std::string& out, const std::string& path, const char* data, size_t size, size_t line_start,
+                    size_t line_lead, size_t line_number, size_t match_start, size_t match_length);
+
+    std::string root;
+    std::vector<SearchFile> files;
+    std::shared_ptr<const SearchPattern> pattern;
+    SearchOptions options;
+    ContentIndex* index;
+    std::string username;
+    size_t pruned;
+    uint64_t start_us;
+
+    std::atomic<size_t> next_file{0};
+    std::atomic<size_t> matches{0};
+    std::atomic<size_t> files_read{0};
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> truncated{false};
+
+    std::mutex mutex;
+    std::string pending;                 // Output not yet taken
+    std::function<void()> waiter;        // Reader to resume when output arrives
+    size_t running = 0;                  // Tasks still searching
+    bool finished = false;               // Summary taken
+};
+
+#endif // CONTENT_SEARCH_HPP
@@ -0,0 +1,36 @@
+#ifndef CRYPTO_HPP
+#define CRYPTO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Fill out with bytes from the OpenSSL CSPRNG. Bytes are drawn in blocks
+// into a per-thread buffer, so small requests rarely enter OpenSSL.
+void random_bytes(void* out, size_t length);
+
+// Lowercase hex encoding
+std::string to_hex(const unsigned char* data, size_t length);
+
+// Key derivation used for new password hashes. Stored hashes record their
+// own parameters, so changing these never invalidates existing accounts.
+struct PasswordKdf {
+    enum Algorithm { PBKDF2_SHA256, SCRYPT };
+    Algorithm algorithm = PBKDF2_SHA256;
+    uint32_t pbkdf2_iterations = 600000;
+    uint32_t scrypt_log2_n = 15;      // N = 2^15, with r = 8 and p = 3
+    uint32_t scrypt_r = 8;
+    uint32_t scrypt_p = 3;
+};
+
+// Encoded as "pbkdf2-sha256$iterations$salt$hash" or "scrypt$log2n$r$p$salt$hash"
+std::string hash_password(const std::string& password, const PasswordKdf& kdf);
+
+// Check password against any stored format, including legacy "salt:sha256"
+// hashes. The final comparison runs in constant time.
+bool verify_password(const std::string& password, const std::string& stored);
+
+// True if stored was produced by a different algorithm or parameters than kdf
+bool needs_rehash(const std::string& stored, const PasswordKdf& kdf);
+
+#endif // CRYPTO_HPP
@@ -0,0 +1,70 @@
+#ifndef DIRECTORY_LISTING_HPP
+#define DIRECTORY_LISTING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One directory entry's metadata, from a single stat; contents are never read
+struct ListingEntry {
+    std::string name;
+    uint64_t size = 0;           // Regular files only; 0 otherwise
+    time_t last_modified = 0;    // Seconds since the epoch
+    bool is_directory = false;   // Symlinks are followed, as for the file operations
+};
+
+enum class ListingSort { NAME, SIZE, MODIFIED };
+
+// Fields written for each entry, as a bit set
+enum ListingField : unsigned {
+    LISTING_NAME = 1u << 0,
+    LISTING_FULL_PATH = 1u << 1,
+    LISTING_PATH = 1u << 2,
+    LISTING_SIZE = 1u << 3,
+    LISTING_LAST_MODIFIED = 1u << 4,
+    LISTING_IS_DIRECTORY = 1u << 5,
+    LISTING_ALL_FIELDS = (1u << 6) - 1,
+};
+
+struct ListingQuery {
+    ListingSort sort = ListingSort::NAME;
+    bool descending = false;
+    size_t limit = 0;            // Entries per page; 0 returns every entry
+    std::string cursor;          // next_cursor of the previous page; empty for the first
+};
+
+struct ListingPage {
+    std::vector<ListingEntry> entries;
+    std::string next_cursor;     // Empty on the last page
+};
+
+// List a directory in one readdir (getdents64) pass plus an fstatat per
+// entry it needs: sorted by name, only the entries on the page are
+// stat'ed. Ties on size or time are broken by name, and the cursor is an
+// opaque hex token of the last entry's sort key and name, so paging stays
+// consistent while entries are added or removed. Returns false with errno
+// set when the directory cannot be opened or the cursor does not match the
+// sort (EINVAL).
+bool list_directory(const std::string& path, const ListingQuery& query, ListingPage& page);
+
+// Apply query's cursor, order and limit to entries already collected, which
+// are consumed. False with errno EINVAL when the cursor does not match.
+bool select_page(std::vector<ListingEntry>& entries, const ListingQuery& query, ListingPage& page);
+
+// Query parameter parsing: sort is "name", "size" or "modified", prefixed
+// with '-' for descending; fields is a comma-separated list of JSON names
+bool parse_listing_sort(const std::string& value, ListingSort& sort, bool& descending);
+bool parse_listing_fields(const std::string& value, unsigned& fields);
+
+// value as a quoted JSON string
+void append_json_string(std::string& out, std::string_view value);
+
+// Entry as a JSON object with the selected fields; relative_dir is its
+// directory relative to the user's root, empty for the root itself
+void append_listing_entry(std::string& out, const ListingEntry& entry, const std::string& relative_dir,
+                          unsigned fields);
+
+#endif // DIRECTORY_LISTING_HPP
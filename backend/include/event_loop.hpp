@@ -0,0 +1,93 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <atomic>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "http_parser.hpp"
+#include "metrics.hpp"
+#include "response_writer.hpp"
+#include "timer_wheel.hpp"
+
+// Connection state machine: a connection reads a request, waits while a
+// worker runs its handler, then writes the response. Persistent
+// connections go back to READING and pick up any pipelined requests.
+enum class ConnectionState {
+    READING,
+    PROCESSING,
+    WRITING
+};
+
+// Deadlines and caps that keep slow or idle clients from holding resources
+struct ConnectionLimits {
+    uint32_t header_timeout_ms = 10000;  // First byte of a request to the end of its headers
+    uint32_t body_timeout_ms = 30000;    // Longest pause between body reads
+    uint32_t idle_timeout_ms = 60000;    // Keep-alive wait for the next request
+    uint32_t write_timeout_ms = 30000;   // Longest pause between response writes
+    size_t max_connections_per_ip = 256;
+};
+
+// Per-connection buffers for the non-blocking reactor
+struct Connection {
+    int fd = -1;
+    uint64_t id = 0;          // Distinguishes reuses of the same fd
+    ConnectionState state = ConnectionState::READING;
+    std::string in_buf;       // Bytes received but not yet consumed
+    HttpParser parser;        // Incremental parse state for the request at the front of in_buf
+    bool continue_sent = false;
+    bool head_screened = false; // screen_request_head() has seen the request whose body is being read
+    ResponseWriter writer;    // Response currently being sent
+    size_t requests_served = 0;
+    bool close_after_write = false; // Response carries Connection: close
+    bool peer_closed = false;       // Read side reached EOF
+    std::string peer;               // Raw peer address bytes, for the per-IP cap
+    TimerNode timer;                // Deadline for the current state; idle while PROCESSING
+    uint64_t header_deadline = 0;   // Fixed when the request's first byte arrives
+    uint64_t parse_us = 0;          // Parser time spent on the request being read
+    RequestTrace trace;             // Response being written, recorded once it is sent
+};
+
+// A response, or the next piece of a streamed one, produced on a worker
+// thread and handed back to the loop
+struct Completion {
+    int fd;
+    uint64_t connection_id;
+    ResponseWriter writer;
+    bool keep_alive;
+    RequestTrace trace;          // Inactive for the later pieces of a streamed response
+    bool resume = false;         // No writer: run the producer of a parked stream again
+};
+
+// Edge-triggered epoll reactor state. The server runs one loop per
+// acceptor; each owns its listener and connections and is only touched
+// by its own thread, except for the completion queue.
+struct EventLoop {
+    size_t index = 0;
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    int wake_fd = -1;                      // eventfd signalled when completions are queued
+    std::thread thread;                    // Not used by loop 0, which runs on the caller of start()
+    uint64_t next_connection_id = 1;
+    uint64_t now_ms = monotonic_ms();      // Refreshed after every epoll_wait
+    bool draining = false;                 // Listener withdrawn; the loop exits once its connections finish
+    TimerWheel timers{100, now_ms};        // Declared before connections, which unlink from it on destruction
+    std::unordered_map<int, std::unique_ptr<Connection>> connections; // fd -> Connection
+    
+    std::mutex completion_mutex;
+    std::vector<Completion> completions;   // Guarded by completion_mutex
+    
+    // Written by the loop thread, read by /api/metrics
+    std::atomic<uint64_t> bytes_written{0}; // Response bytes sent
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> connections_accepted{0};
+    std::atomic<uint64_t> connections_closed{0};
+    std::atomic<uint64_t> connections_refused{0};   // Over the per-IP cap
+    std::atomic<uint64_t> connections_timed_out{0};
+};
+
+#endif // EVENT_LOOP_HPP
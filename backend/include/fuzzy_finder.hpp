@@ -0,0 +1,66 @@
+#ifndef FUZZY_FINDER_HPP
+#define FUZZY_FINDER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Every path in a workspace, packed for matching: the paths back to back
+// in one buffer and again in lowercase, with a mask of the characters each
+// contains alongside so most paths are rejected without reading them.
+class PathList {
+public:
+    void add(std::string_view path, bool is_directory);
+    void clear();
+
+    size_t size() const { return directories.size(); }
+    std::string_view path(size_t index) const {
+        return {paths.data() + offsets[index], offsets[index + 1] - offsets[index]};
+    }
+    std::string_view lowered_path(size_t index) const {
+        return {lowered.data() + offsets[index], offsets[index + 1] - offsets[index]};
+    }
+    bool is_directory(size_t index) const { return directories[index] != 0; }
+    const uint64_t* masks_data() const { return masks.data(); }
+    size_t memory_used() const;
+
+private:
+    std::string paths;
+    std::string lowered;
+    std::vector<uint32_t> offsets{0};   // Start of each path, plus the end of the last
+    std::vector<uint64_t> masks;        // fuzzy_char_mask() of each path
+    std::vector<uint8_t> directories;
+};
+
+// Size and modification time of a PathList entry
+struct FileStamp {
+    uint64_t size = 0;                  // Regular files only; 0 otherwise
+    int64_t modified_ns = 0;            // Nanoseconds since the epoch
+
+    bool operator==(const FileStamp& other) const { return size == other.size && modified_ns == other.modified_ns; }
+};
+
+struct FuzzyMatch {
+    uint32_t index;                     // Into the PathList
+    int score;
+    std::vector<uint32_t> positions;    // Matched byte offsets in the path
+};
+
+// Bit set of the characters in text, case-insensitively: a path can only
+// match a query whose mask is a subset of its own
+uint64_t fuzzy_char_mask(std::string_view text);
+
+// The best limit matches of query in list, best first, ties going to
+// shorter paths. Paths are scored as in fzf: a subsequence match with
+// bonuses at word, path segment and camelCase boundaries and in the file
+// name. Whitespace in the query is ignored. Returns how many paths
+// matched in all.
+size_t fuzzy_find(const PathList& list, std::string_view query, size_t limit, std::vector<FuzzyMatch>& matches);
+
+// Walk root into list without following symlinked directories, for
+// workspaces the index does not hold; stat each entry into stamps if given
+bool list_paths(const std::string& root, PathList& list, std::vector<FileStamp>* stamps = nullptr);
+
+#endif // FUZZY_FINDER_HPP
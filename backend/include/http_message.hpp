@@ -0,0 +1,96 @@
+#ifndef HTTP_MESSAGE_HPP
+#define HTTP_MESSAGE_HPP
+
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+// Header names are case-insensitive (RFC 9110 section 5.1)
+struct CaseInsensitiveLess {
+    bool operator()(const std::string& a, const std::string& b) const {
+        return strcasecmp(a.c_str(), b.c_str()) < 0;
+    }
+};
+
+using HeaderMap = std::map<std::string, std::string, CaseInsensitiveLess>;
+
+// File region sent with sendfile(); the descriptor closes with the last reference
+struct FileBody {
+    int fd;
+    off_t offset;
+    size_t length;
+
+    FileBody(int fd, off_t offset, size_t length) : fd(fd), offset(offset), length(length) {}
+    ~FileBody() { if (fd >= 0) close(fd); }
+    FileBody(const FileBody&) = delete;
+    FileBody& operator=(const FileBody&) = delete;
+};
+
+// Produces a streamed body on a worker thread, one piece per call: append
+// the next piece to chunk and return false once the body is complete.
+// The next call is only made after the previous piece has been sent.
+using BodyProducer = std::function<bool(std::string& chunk)>;
+
+// Lets a producer whose data comes from elsewhere wait without holding a
+// worker. After the producer hands back an empty piece with more to come,
+// this is called instead of running it again: it returns false if data is
+// ready now, or keeps resume and calls it once when there is more.
+using StreamWait = std::function<bool(std::function<void()> resume)>;
+
+// HTTP Request structure
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string version;
+    std::string body;
+    HeaderMap headers;
+    std::map<std::string, std::string> query_params;
+    std::map<std::string, std::string> path_params;  // Captured {name} route segments
+    std::string session_token;                       // Set by the auth middleware
+    std::string username;                            // Set by the auth middleware
+};
+
+// HTTP Response structure
+struct HttpResponse {
+    int status_code;
+    std::string status_text;
+    HeaderMap headers;
+    std::string body;
+    std::shared_ptr<const std::string> shared_body = nullptr; // Immutable cached body, sent instead of body
+    std::shared_ptr<FileBody> file_body = nullptr;            // Sent with sendfile() instead of body
+    BodyProducer stream = nullptr;                            // Sent chunked instead of body
+    StreamWait stream_wait = nullptr;                         // Optional, for a stream fed by another thread
+    std::function<HttpResponse()> deferred = nullptr;         // Handler to finish on the crypto pool
+    
+    size_t content_length() const {
+        if (shared_body) return shared_body->size();
+        if (file_body) return file_body->length;
+        return body.size();
+    }
+};
+
+// Run a streamed body's producer to the end, appending its pieces to body;
+// blocks the calling thread while a waitable stream has nothing ready
+inline void collect_body(HttpResponse& response) {
+    if (!response.stream) return;
+    BodyProducer producer = std::move(response.stream);
+    StreamWait wait = std::move(response.stream_wait);
+    response.stream = nullptr;
+    response.stream_wait = nullptr;
+    size_t collected = response.body.size();
+    while (producer(response.body)) {
+        if (wait && response.body.size() == collected) {
+            auto ready = std::make_shared<std::promise<void>>();
+            std::future<void> resumed = ready->get_future();
+            if (wait([ready] { ready->set_value(); })) resumed.wait();
+        }
+        collected = response.body.size();
+    }
+}
+
+#endif // HTTP_MESSAGE_HPP
@@ -0,0 +1,96 @@
+#ifndef HTTP_PARSER_HPP
+#define HTTP_PARSER_HPP
+
+#include <string>
+#include <string_view>
+#include "http_message.hpp"
+
+// Size limits enforced while parsing a request
+struct HttpLimits {
+    size_t max_header_size = 64 * 1024;         // Request line plus all header lines
+    size_t max_header_count = 100;
+    size_t max_body_size = 64 * 1024 * 1024;    // Decoded body, Content-Length or chunked
+};
+
+// Decode %XX escapes and '+' (application/x-www-form-urlencoded)
+std::string percent_decode(std::string_view str);
+
+// Value of the named cookie in a Cookie header, without allocating; empty if absent
+std::string_view cookie_value(std::string_view header, std::string_view name);
+
+// Resumable HTTP/1.x request parser.
+//
+// parse() is handed a view of the connection buffer starting at the first
+// byte of the current request. Each call continues from where the previous
+// one stopped, so bytes are scanned once no matter how the request is split
+// across reads. The buffer may be reallocated between calls; only offsets
+// are kept. Bodies are read by Content-Length or Transfer-Encoding: chunked.
+class HttpParser {
+public:
+    enum class Status {
+        NEED_MORE,
+        COMPLETE,
+        ERROR
+    };
+
+    explicit HttpParser(const HttpLimits& limits = HttpLimits());
+
+    Status parse(std::string_view data);
+
+    // Valid after COMPLETE: bytes of data that made up the request
+    size_t consumed() const { return pos; }
+    HttpRequest take_request();
+
+    // Valid after ERROR: status code and reason for the error response
+    int error_status() const { return error_code; }
+    const char* error_reason() const { return error_text; }
+
+    // True once the header block is parsed and the client awaits 100 Continue
+    bool expects_continue() const;
+    // True once the header block is parsed and body bytes are being read
+    bool reading_body() const;
+    // Valid once reading_body(): the request line and headers, body still to come
+    const HttpRequest& head() const { return request; }
+    // Lower the body limit for the request being read, to its route's say;
+    // ERROR with 413 if the declared length already exceeds it
+    Status limit_body(size_t max_body);
+
+    // While reading a body, hand back the bytes already copied into the request
+    // so the caller can drop them from its buffer; offsets restart at zero
+    size_t release_consumed();
+
+    void reset();
+
+private:
+    enum class State {
+        REQUEST_LINE,
+        HEADERS,
+        BODY,
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+        CHUNK_TRAILERS,
+        COMPLETE,
+        ERROR
+    };
+
+    Status fail(int code, const char* reason);
+    bool next_line(std::string_view data, std::string_view& line);
+    Status parse_request_line(std::string_view line);
+    Status parse_header_line(std::string_view line);
+    Status finish_headers();
+    void parse_target(std::string_view target);
+
+    HttpLimits limits;
+    State state;
+    HttpRequest request;
+    size_t pos;              // Next unconsumed byte in data
+    size_t scan;             // Resume offset for the line-ending search
+    size_t header_count;
+    size_t body_remaining;   // Bytes left in the body or current chunk
+    size_t body_limit;       // limits.max_body_size, or lower for this request
+    int error_code;
+    const char* error_text;
+};
+
+#endif // HTTP_PARSER_HPP
@@ -0,0 +1,57 @@
+#ifndef LOG_FILE_HPP
+#define LOG_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Building blocks shared by the append-only stores. A record on disk is
+// [payload length u32][crc32 of payload u32][payload]; a record that fails
+// either check marks the end of the usable log.
+namespace log_file {
+
+const uint32_t RECORD_HEADER_SIZE = 8;
+const uint32_t MAX_RECORD_SIZE = 16 << 20;   // Sanity bound on a length read back from disk
+
+// Start a record: reserves the header, which finish_record fills in
+std::string begin_record();
+void finish_record(std::string& record);
+
+void put_u8(std::string& out, uint8_t value);
+void put_u32(std::string& out, uint32_t value);
+void put_i64(std::string& out, int64_t value);
+void put_string(std::string& out, const std::string& value);
+
+// Bounds-checked decoding of a record payload
+class Reader {
+public:
+    Reader(const char* data, size_t size) : data(data), size(size) {}
+
+    bool read_bytes(void* out, size_t length);
+    bool read_u8(uint8_t& out) { return read_bytes(&out, sizeof(out)); }
+    bool read_u32(uint32_t& out) { return read_bytes(&out, sizeof(out)); }
+    bool read_i64(int64_t& out) { return read_bytes(&out, sizeof(out)); }
+    bool read_string(std::string& out);
+    bool at_end() const { return position == size; }
+
+private:
+    const char* data;
+    size_t size;
+    size_t position = 0;
+};
+
+// Read and verify the record at offset; length receives its size on disk
+bool read_record(int fd, uint64_t offset, std::string& payload, uint32_t& length);
+
+// pwrite/pread the whole range, retrying short transfers and EINTR
+bool write_all(int fd, const char* data, size_t length, uint64_t offset);
+bool read_all(int fd, char* data, size_t length, uint64_t offset);
+
+uint64_t file_size(int fd);
+
+// Make creates and renames within dir durable
+void sync_directory(const std::string& dir);
+
+} // namespace log_file
+
+#endif // LOG_FILE_HPP
@@ -0,0 +1,117 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+enum class LogLevel : uint8_t { DEBUG = 0, INFO = 1, WARN = 2, ERROR = 3 };
+enum class LogFormat { TEXT, JSON };
+
+// Statements below this level are compiled out; add
+// -DLOG_COMPILED_LEVEL=1 to CXXFLAGS to drop LOG_DEBUG from the binary
+#ifndef LOG_COMPILED_LEVEL
+#define LOG_COMPILED_LEVEL 0
+#endif
+
+// Asynchronous logger.
+//
+// Each thread appends finished lines to its own single-producer ring
+// buffer without locking or formatting; a background thread drains all
+// rings every few milliseconds, orders the lines by timestamp, formats
+// them and writes them to stdout in one write(). A full ring drops the
+// line rather than stall the caller, and the drops are reported.
+namespace logging {
+
+extern std::atomic<int> runtime_level;
+
+constexpr bool compiled_in(int level) {
+    return level >= LOG_COMPILED_LEVEL;
+}
+
+inline bool enabled(LogLevel level) {
+    return (int)level >= runtime_level.load(std::memory_order_relaxed);
+}
+
+void configure(LogLevel level, LogFormat format);
+// Block until every line logged before the call has been written
+void flush();
+
+bool parse_level(const std::string& name, LogLevel& level);
+bool parse_format(const std::string& name, LogFormat& format);
+
+} // namespace logging
+
+// A key/value pair: key=value in text output, its own member in JSON
+struct LogField {
+    std::string_view key;
+    std::string_view value;
+};
+
+inline LogField log_field(std::string_view key, std::string_view value) {
+    return {key, value};
+}
+
+// One log statement. Text is collected in a fixed buffer (long lines are
+// truncated) and handed to the thread's ring when the statement ends.
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : level(level) {}
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(std::string_view text) {
+        append(text.data(), text.size());
+        return *this;
+    }
+    LogLine& operator<<(const char* text) { return *this << std::string_view(text ? text : "(null)"); }
+    LogLine& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    LogLine& operator<<(char c) {
+        append(&c, 1);
+        return *this;
+    }
+    LogLine& operator<<(bool value) { return *this << (value ? "true" : "false"); }
+    LogLine& operator<<(double value);
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogLine& operator<<(T value) {
+        if (std::is_signed<T>::value) {
+            append_signed((long long)value);
+        } else {
+            append_unsigned((unsigned long long)value);
+        }
+        return *this;
+    }
+    LogLine& operator<<(const LogField& field);
+
+private:
+    static const size_t MAX_LINE = 4096;
+
+    void append(const char* data, size_t length);
+    void append_raw(const char* data, size_t length);
+    void append_signed(long long value);
+    void append_unsigned(unsigned long long value);
+
+    LogLevel level;
+    uint32_t message_length = 0;  // Message text, before any fields
+    uint32_t length = 0;
+    uint32_t field_count = 0;
+    bool in_fields = false;
+    char buffer[MAX_LINE];
+};
+
+#define LOG_AT(level) \
+    if (!logging::compiled_in((int)(level)) || !logging::enabled(level)) { \
+    } else \
+        LogLine(level)
+
+#define LOG_DEBUG LOG_AT(LogLevel::DEBUG)
+#define LOG_INFO LOG_AT(LogLevel::INFO)
+#define LOG_WARN LOG_AT(LogLevel::WARN)
+#define LOG_ERROR LOG_AT(LogLevel::ERROR)
+
+#endif // LOGGER_HPP
@@ -0,0 +1,135 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+
+inline uint64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Latency histogram in the style of HdrHistogram: every power of two is
+// split into SUB_BUCKETS linear buckets, so any value is held to within
+// 1/SUB_BUCKETS of itself in a fixed, small array. Recording is a couple
+// of shifts and relaxed atomic adds; readers may see a histogram mid-update.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_VALUE_BITS = 36;   // ~19 hours in microseconds; larger values are clamped
+    static const size_t BUCKETS = SUB_BUCKETS * (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1);
+
+    void record(uint64_t micros);
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_us.load(std::memory_order_relaxed); }
+    // Values recorded at or below micros, to within the bucket resolution
+    uint64_t count_at_or_below(uint64_t micros) const;
+    // Smallest value that percentile percent of recordings do not exceed,
+    // rounded up to the end of its bucket; 0 when empty
+    uint64_t value_at_percentile(double percentile) const;
+
+private:
+    static size_t bucket_of(uint64_t micros);
+    static uint64_t lowest_in(size_t bucket);
+
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum_us{0};
+};
+
+// Where a request spends its time. PARSE is CPU time in the parser; SEND
+// runs from the first write of the response to its last byte, including
+// the producer time of a streamed body.
+enum class RequestStage { PARSE, QUEUE, AUTH, HANDLER, SERIALIZE, SEND, COUNT };
+
+// Slow operations timed on their own, whichever route runs them
+enum class Operation { CREATE_VERSION, TERMINAL_COMMAND, PASSWORD_CHECK, CONTENT_SEARCH, COUNT };
+
+// A route as seen by metrics: labels must outlive the server, so they
+// point at the route table or at string literals
+struct RouteLabel {
+    uint32_t id = 0;             // Below Metrics::MAX_ROUTES
+    std::string_view method;
+    std::string_view pattern;
+};
+
+// Timings of one request, filled in as it moves from the loop to a worker
+// and back
+struct RequestTrace {
+    uint64_t start_us = 0;       // Request parsed; 0 when nothing is being traced
+    uint64_t send_start_us = 0;
+    RouteLabel route;
+    int status = 0;
+    uint64_t stage_us[(size_t)RequestStage::COUNT] = {};
+    unsigned stages_seen = 0;    // Bit per RequestStage; stages a request skips are not recorded
+
+    bool active() const { return start_us != 0; }
+    void add(RequestStage stage, uint64_t micros) {
+        stage_us[(size_t)stage] += micros;
+        stages_seen |= 1u << (unsigned)stage;
+    }
+};
+
+// Server-wide metrics registry.
+//
+// Histograms are created on first use for each route and status code and
+// kept for the registry's lifetime, so recording never takes a lock. Counters and gauges owned
+// by other components are read when the registry is rendered.
+class Metrics {
+public:
+    static const uint32_t MAX_ROUTES = 64;
+
+    Metrics();
+    ~Metrics();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // Record a finished request: its total time and each stage
+    void record_request(const RequestTrace& trace, uint64_t now_us);
+    void record_operation(Operation operation, uint64_t micros);
+
+    // Prometheus text exposition of every histogram, followed by extra,
+    // which the caller renders from its own counters and gauges
+    std::string render(const std::string& extra) const;
+
+    // Helpers for rendering counters and gauges in the same format
+    static void render_value(std::string& out, const char* name, const char* type, const char* help, double value);
+
+private:
+    static const int MIN_STATUS = 100;
+    static const int STATUS_SLOTS = 500;   // 100-599; anything else is counted as 599
+
+    struct RouteSeries;
+    RouteSeries& route_series(const RouteLabel& route);
+    LatencyHistogram& status_histogram(RouteSeries& series, int status);
+
+    std::unique_ptr<std::atomic<RouteSeries*>[]> routes;
+    LatencyHistogram operations[(size_t)Operation::COUNT];
+};
+
+// Times a scope into an operation histogram
+class OperationTimer {
+public:
+    OperationTimer(Metrics& metrics, Operation operation)
+        : metrics(metrics), operation(operation), start(monotonic_us()) {}
+    ~OperationTimer() { metrics.record_operation(operation, monotonic_us() - start); }
+
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+private:
+    Metrics& metrics;
+    Operation operation;
+    uint64_t start;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,118 @@
+#ifndef REPOSITORY_STORE_HPP
+#define REPOSITORY_STORE_HPP
+
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "sharded_map.hpp"
+
+// Version control structures
+struct Version {
+    std::string id;
+    std::string message;
+    std::string author;
+    time_t timestamp = 0;
+    std::string parent_id;
+    std::map<std::string, std::string> file_hashes; // filename -> content hash
+    std::vector<std::string> changed_files;
+};
+
+struct Repository {
+    std::string name;
+    std::string path;
+    std::string current_branch;
+    std::map<std::string, Version> versions; // version_id -> Version
+    std::map<std::string, std::string> branches; // branch_name -> version_id
+    std::string head_version;
+};
+
+// Changes to one repository, logged and applied as a single record
+class RepositoryChange {
+public:
+    void add_version(const Version& version);
+    void set_branch(const std::string& branch, const std::string& version_id);
+    void set_head(const std::string& version_id);
+    void set_current_branch(const std::string& branch);
+
+    bool empty() const { return ops.empty(); }
+
+private:
+    friend class RepositoryStore;
+    std::string ops;  // Encoded operations, in order
+};
+
+// Durable repository metadata.
+//
+// Each repository has its own log under data/repositories, named by a hash
+// of its "username/path" key. A change is one CRC-checked record holding a
+// batch of operations, so it is either replayed whole or not at all, and a
+// commit costs one append and one fdatasync whatever the number of other
+// repositories. Logs are read on first access; a torn tail is truncated and
+// logs mostly made of superseded head and branch moves are rewritten then.
+class RepositoryStore {
+public:
+    explicit RepositoryStore(const std::string& data_dir);
+
+    RepositoryStore(const RepositoryStore&) = delete;
+    RepositoryStore& operator=(const RepositoryStore&) = delete;
+
+    // Create the log directory, importing a legacy repositories.txt once
+    bool open(std::string& error);
+
+    bool contains(const std::string& key);
+
+    // Run fn(const Repository&) on the cached repository; returns false if absent
+    template <typename F>
+    bool read(const std::string& key, F&& fn) {
+        return load(key) && cache.read(key, std::forward<F>(fn));
+    }
+
+    // Create and persist; false, logged, if the key is taken or its log
+    // cannot be written
+    bool create(const std::string& key, const Repository& repository);
+
+    // Run fn(const Repository&, RepositoryChange&), then persist and apply
+    // the change. Returns false if the repository is absent or fn recorded
+    // nothing. Throws std::runtime_error if the log cannot be written.
+    template <typename F>
+    bool update(const std::string& key, F&& fn) {
+        if (!load(key)) return false;
+        int fd = -1;
+        cache.update(key, [&](Repository& repository) {
+            RepositoryChange change;
+            fn(static_cast<const Repository&>(repository), change);
+            if (change.empty()) return;
+            // Appending under the entry's lock keeps the log in update order
+            fd = append(key, change);
+            apply(change.ops.data(), change.ops.size(), repository);
+        });
+        if (fd < 0) return false;
+        sync(fd);
+        return true;
+    }
+
+private:
+    std::string log_path(const std::string& key) const;
+    // Bring key into the cache from its log; false if there is none or it cannot be read
+    bool load(const std::string& key);
+    bool replay(int fd, const std::string& key, Repository& repository, size_t& records);
+    // Rewrite the log as a snapshot of repository; unless replace, fail with
+    // EEXIST rather than overwrite a log already at path
+    bool rewrite(const std::string& key, const Repository& repository, const std::string& path, bool replace = true);
+    // Write the change to key's log; returns the descriptor to sync
+    int append(const std::string& key, const RepositoryChange& change);
+    void sync(int fd);
+    // Apply encoded operations; only a log's first record, which creates the
+    // repository, is applied with key to receive the key it was logged under
+    static bool apply(const char* ops, size_t size, Repository& repository, std::string* key = nullptr);
+    bool import_legacy(const std::string& path);
+
+    std::string data_dir;
+    std::string repositories_dir;
+    ShardedMap<std::string, Repository> cache;
+    std::mutex load_mutex;  // Serializes first loads, which may rewrite a log
+};
+
+#endif // REPOSITORY_STORE_HPP
@@ -0,0 +1,81 @@
+#ifndef RESPONSE_WRITER_HPP
+#define RESPONSE_WRITER_HPP
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include "http_message.hpp"
+
+// Serialized response waiting to go out on a non-blocking socket.
+//
+// The status line and headers are written into a fixed inline buffer (a
+// heap string only when they do not fit); the body is moved or shared in
+// from the HttpResponse and never copied. Head and body leave in a single
+// scatter-gather send, and a partial write resumes where it stopped on the
+// next call. File bodies follow with sendfile().
+//
+// A streamed response is a head-only writer that holds the producer; once
+// it is sent, the producer runs on a worker and each piece comes back as a
+// chunk() writer framed for Transfer-Encoding: chunked. Only one piece is
+// in flight per connection, so a slow client throttles the producer. A
+// stream with a StreamWait that returns an empty piece is parked instead of
+// run again until its source calls resume.
+class ResponseWriter {
+public:
+    enum class Status {
+        DONE,       // Everything has been handed to the kernel
+        BLOCKED,    // Socket buffer full; call again on EPOLLOUT
+        ERROR       // Peer gone or the file shrank
+    };
+
+    ResponseWriter() = default;
+    // HTTP/1.0 peers get streamed bodies unframed, delimited by closing the connection
+    explicit ResponseWriter(HttpResponse&& response, bool chunked = true);
+
+    // One piece of a streamed body; a null producer makes it the last piece
+    static ResponseWriter chunk(std::string data, BodyProducer next, bool chunked, StreamWait wait = nullptr);
+
+    Status write_to(int fd);
+
+    // After DONE: whether the producer has more of the body to generate
+    bool has_more() const { return (bool)producer; }
+    BodyProducer take_producer() {
+        BodyProducer next = std::move(producer);
+        producer = nullptr;
+        return next;
+    }
+    StreamWait take_stream_wait() {
+        StreamWait wait = std::move(stream_wait);
+        stream_wait = nullptr;
+        return wait;
+    }
+    // After an empty piece: true if the stream's source keeps resume to call
+    // once it has more, false if the producer should run now
+    bool wait_for_more(std::function<void()> resume) { return empty() && stream_wait && stream_wait(std::move(resume)); }
+    bool is_chunked() const { return chunked; }
+
+    bool empty() const { return head_size == 0 && body_data().empty(); }
+    size_t bytes_written() const { return written; }
+    size_t total_size() const;
+
+private:
+    static const size_t INLINE_HEAD_SIZE = 512;
+
+    const char* head_data() const { return heap_head.empty() ? inline_head : heap_head.data(); }
+    const std::string& body_data() const { return shared_body ? *shared_body : body; }
+
+    char inline_head[INLINE_HEAD_SIZE];
+    std::string heap_head;
+    size_t head_size = 0;
+    std::string body;
+    std::shared_ptr<const std::string> shared_body;
+    std::shared_ptr<FileBody> file_body;
+    char tail[8];           // Chunk terminator, plus the last-chunk marker
+    size_t tail_size = 0;
+    BodyProducer producer;
+    StreamWait stream_wait;
+    bool chunked = false;
+    size_t written = 0;     // Head, body, tail, then file bytes sent so far
+};
+
+#endif // RESPONSE_WRITER_HPP
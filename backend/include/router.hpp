@@ -0,0 +1,138 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+// Per-route middleware, applied in this order before the handler runs
+enum RouteFlags : unsigned {
+    ROUTE_PUBLIC = 0,
+    ROUTE_AUTH = 1u << 0,   // Require a valid session; fills request.username
+    ROUTE_METRICS = 1u << 1, // As ROUTE_AUTH, unless the server opens metrics to scrapers
+    ROUTE_CRYPTO = 1u << 2, // Run the handler on the bounded crypto pool (password hashing)
+};
+
+// One endpoint. A pattern segment written as {name} matches any single
+// path segment and is captured into request.path_params.
+template <typename Handler>
+struct Route {
+    std::string_view method;
+    std::string_view pattern;
+    Handler handler{};
+    unsigned flags = ROUTE_PUBLIC;
+    size_t max_body = 0;    // 0 leaves the server-wide body limit in force
+};
+
+// FNV-1a over method and path; the seed is chosen by RouteTable so that
+// the literal routes land in distinct slots
+constexpr uint32_t route_hash(std::string_view method, std::string_view path, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : method) hash = (hash ^ (uint8_t)c) * 16777619u;
+    hash = (hash ^ ' ') * 16777619u;
+    for (char c : path) hash = (hash ^ (uint8_t)c) * 16777619u;
+    // Fold the high bits down: the low bits alone see only the seed's low
+    // bits, which leaves too few distinct seeds to try for a slot mask
+    return hash ^ (hash >> 16);
+}
+
+// Route lookup table built entirely at compile time.
+//
+// Literal routes are placed with a perfect hash: the constructor searches
+// for a seed under which no two of them share a slot, so a lookup is one
+// hash, one slot read and one string comparison. Routes with {params} are
+// matched segment by segment, and only when the literal lookup misses.
+template <typename Handler, size_t N>
+class RouteTable {
+public:
+    using Params = std::map<std::string, std::string>;
+
+    constexpr explicit RouteTable(const Route<Handler> (&table)[N])
+        : routes(), slots(), seed(0), param_routes(), param_count(0) {
+        for (size_t i = 0; i < N; i++) {
+            routes[i] = table[i];
+            if (has_params(table[i].pattern)) param_routes[param_count++] = i;
+        }
+        while (!try_seed(seed)) seed++;
+    }
+
+    static constexpr size_t size() { return N; }
+    // Position of a route returned by match() in the original table
+    size_t index_of(const Route<Handler>* route) const { return (size_t)(route - routes.data()); }
+
+    // Null if no route matches; params receives the captured segments
+    const Route<Handler>* match(std::string_view method, std::string_view path, Params* params) const {
+        uint16_t slot = slots[route_hash(method, path, seed) & (SLOTS - 1)];
+        if (slot != 0) {
+            const Route<Handler>& route = routes[slot - 1];
+            if (route.method == method && route.pattern == path) return &route;
+        }
+        for (size_t i = 0; i < param_count; i++) {
+            const Route<Handler>& route = routes[param_routes[i]];
+            if (route.method == method && match_pattern(route.pattern, path, params)) return &route;
+        }
+        return nullptr;
+    }
+
+private:
+    // Load factor of at most 1/4 keeps the seed search short
+    static constexpr size_t SLOTS = [] {
+        size_t size = 8;
+        while (size < N * 4) size *= 2;
+        return size;
+    }();
+
+    static constexpr bool has_params(std::string_view pattern) {
+        return pattern.find('{') != std::string_view::npos;
+    }
+
+    constexpr bool try_seed(uint32_t candidate) {
+        for (auto& slot : slots) slot = 0;
+        for (size_t i = 0; i < N; i++) {
+            if (has_params(routes[i].pattern)) continue;
+            size_t index = route_hash(routes[i].method, routes[i].pattern, candidate) & (SLOTS - 1);
+            if (slots[index] != 0) return false;
+            slots[index] = (uint16_t)(i + 1);
+        }
+        return true;
+    }
+
+    static bool match_pattern(std::string_view pattern, std::string_view path, Params* params) {
+        Params captured;
+        while (!pattern.empty() && !path.empty()) {
+            size_t pattern_end = pattern.find('/', 1);
+            size_t path_end = path.find('/', 1);
+            std::string_view expected = pattern.substr(0, pattern_end);
+            std::string_view actual = path.substr(0, path_end);
+
+            if (expected.size() > 3 && expected[1] == '{' && expected.back() == '}') {
+                if (actual.size() < 2) return false;
+                captured[std::string(expected.substr(2, expected.size() - 3))] = std::string(actual.substr(1));
+            } else if (expected != actual) {
+                return false;
+            }
+
+            pattern.remove_prefix(expected.size());
+            path.remove_prefix(actual.size());
+        }
+        if (!pattern.empty() || !path.empty()) return false;
+        if (params) *params = std::move(captured);
+        return true;
+    }
+
+    std::array<Route<Handler>, N> routes;
+    std::array<uint16_t, SLOTS> slots;          // Route index + 1; 0 marks an empty slot
+    uint32_t seed;
+    std::array<size_t, N> param_routes;
+    size_t param_count;
+};
+
+// Deduces N from the array so tables can be declared without counting routes
+template <typename Handler, size_t N>
+constexpr RouteTable<Handler, N> make_route_table(const Route<Handler> (&table)[N]) {
+    return RouteTable<Handler, N>(table);
+}
+
+#endif // ROUTER_HPP
@@ -17,43 +17,24 @@
 #include <ctime>
 #include <random>
 #include <algorithm>
+#include "content_search.hpp"
+#include "directory_listing.hpp"
+#include "http_parser.hpp"
+#include "event_loop.hpp"
+#include "server_config.hpp"
+#include "repository_store.hpp"
+#include "router.hpp"
+#include "session_snapshot.hpp"
+#include "session_store.hpp"
+#include "static_cache.hpp"
+#include "sharded_map.hpp"
+#include "thread_pool.hpp"
+#include "user_store.hpp"
+#include "workspace_index.hpp"
 
-// User structure
-struct User {
-    std::string username;
-    std::string password_hash;
-    std::string session_token;
-    time_t last_activity;
-    std::string filesystem_path;
-    std::string api_key;
-    std::string api_provider;
-    std::string api_model;
-};
-
-// Version control structures
-struct Version {
-    std::string id;
-    std::string message;
-    std::string author;
-    time_t timestamp;
-    std::string parent_id;
-    std::map<std::string, std::string> file_hashes; // filename -> content hash
-    std::vector<std::string> changed_files;
-};
-
-struct Repository {
-    std::string name;
-    std::string path;
-    std::string current_branch;
-    std::map<std::string, Version> versions; // version_id -> Version
-    std::map<std::string, std::string> branches; // branch_name -> version_id
-    std::string head_version;
-};
-
-// File structure
+// File structure; metadata only, contents are read where they are needed
 struct FileInfo {
     std::string name;
-    std::string content;
     time_t last_modified;
     size_t size;
     bool is_directory;
@@ -61,32 +42,6 @@ struct FileInfo {
     std::string hash;  // Content hash for version control
 };
 
-// Session structure
-struct Session {
-    std::string token;
-    std::string username;
-    time_t created;
-    time_t last_activity;
-    std::string current_directory;  // Track current working directory
-};
-
-// HTTP Request structure
-struct HttpRequest {
-    std::string method;
-    std::string path;
-    std::string body;
-    std::map<std::string, std::string> headers;
-    std::map<std::string, std::string> query_params;
-};
-
-// HTTP Response structure
-struct HttpResponse {
-    int status_code;
-    std::string status_text;
-    std::map<std::string, std::string> headers;
-    std::string body;
-};
-
 // Terminal command structure
 struct TerminalCommand {
     std::string command;
@@ -97,25 +52,47 @@ struct TerminalCommand {
 
 // Server class
 class WebServer {
+    // Times the per-request helpers without a socket (bench/microbench.cpp)
+    friend class MicroBenchmarks;
+
 private:
-    int server_fd;
-    uint16_t port;
-    std::unordered_map<std::string, User> users;
-    std::unordered_map<std::string, Session> sessions;
-    std::unordered_map<std::string, Repository> repositories; // username/path -> Repository
+    ServerConfig config;
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::atomic<bool> running{false};
+    // Set from SIGTERM/SIGINT (STOP) or SIGUSR2 (RESTART); the loops then drain and exit
+    enum class Shutdown { NONE, STOP, RESTART };
+    std::atomic<Shutdown> shutdown_mode{Shutdown::NONE};
+    std::atomic<uint64_t> drain_deadline_ms{0};
+    int signal_fd = -1;  // Read end of the signal self-pipe, watched by loop 0
+    ShardedMap<std::string, size_t> connections_per_ip; // Shared by all loops
+    Metrics metrics;
+    std::atomic<long> requests_in_progress{0};  // Queued or running in a handler
+    UserStore users;
+    ShardedMap<std::string, std::string> session_directories; // Session token -> terminal working directory
+    SessionStore sessions;
+    RepositoryStore repositories; // username/path -> Repository
     std::string data_dir;
+    std::unique_ptr<StaticFileCache> static_cache;
+    std::unique_ptr<WorkspaceIndex> workspace_index;
+    std::unique_ptr<ContentIndex> content_index;
+    std::unique_ptr<WorkStealingPool> search_pool; // Content searches, so one cannot occupy every request worker
+    std::unique_ptr<WorkStealingPool> crypto_pool; // ROUTE_CRYPTO handlers, kept off the request workers
+    std::unique_ptr<WorkStealingPool> pool; // Request handlers; declared last so it drains first
     
     // Helper functions
-    std::string hash_password(const std::string& password);
-    std::string generate_session_token();
-    std::string generate_salt();
-    bool verify_password(const std::string& password, const std::string& hash);
+    // Verify a login, upgrading the stored hash if it predates the configured KDF
+    bool check_credentials(const std::string& username, const std::string& password);
     std::string url_decode(const std::string& str);
     std::string url_encode(const std::string& str);
     std::string get_mime_type(const std::string& filename);
     std::string read_file_content(const std::string& path);
     bool write_file_content(const std::string& path, const std::string& content);
+    BodyProducer stream_encoded_file(const std::string& file_path, std::string prefix, std::string suffix,
+                                     bool remove_when_done);
     std::vector<FileInfo> list_user_files(const std::string& username, const std::string& path = "");
+    bool list_workspace(const std::string& username, const std::string& relative_dir, const ListingQuery& query,
+                        ListingPage& page);
+    bool workspace_entry_exists(const std::string& username, const std::string& relative_path);
     std::string create_user_filesystem(const std::string& username);
     bool delete_user_filesystem(const std::string& username);
     
@@ -127,19 +104,78 @@ private:
     std::string sanitize_path(const std::string& path, const std::string& username);
     
     // Terminal functions
-    std::string execute_terminal_command(const std::string& command, const std::string& username, const std::string& directory);
+    // With output_file, a command's output is left in that file for the caller to stream and remove
+    std::string execute_terminal_command(const std::string& command, const std::string& username,
+                                         const std::string& session_token, const std::string& directory,
+                                         std::string* output_file = nullptr);
     std::string get_current_directory(const std::string& username);
     bool change_directory(const std::string& username, const std::string& new_directory);
     
+    // Event loop
+    bool open_listener(EventLoop& loop);
+    // Take over a listener passed down by a warm restart; false if it does not fit this config
+    bool adopt_listener(EventLoop& loop, int fd);
+    void handle_signals();
+    void begin_drain(EventLoop& loop);
+    void run_loop(EventLoop& loop);
+    void accept_connections(EventLoop& loop);
+    bool handle_readable(EventLoop& loop, Connection& conn);
+    bool handle_writable(EventLoop& loop, Connection& conn);
+    // Run the parser over the connection's buffer, dropping body bytes it has taken
+    HttpParser::Status parse_buffered(Connection& conn);
+    void process_request(EventLoop& loop, Connection& conn);
+    void produce_next_chunk(EventLoop& loop, Connection& conn);
+    void complete_request(EventLoop& loop, int fd, uint64_t connection_id, bool keep_alive, bool chunked,
+                          HttpResponse response, RequestTrace trace);
+    void post_completion(EventLoop& loop, Completion completion);
+    void reject_request(Connection& conn, int status_code, const char* status_text);
+    void reject_request(Connection& conn, HttpResponse response);
+    // Record the request whose response has just been sent
+    void finish_trace(Connection& conn);
+    void drain_completions(EventLoop& loop);
+    void update_deadline(EventLoop& loop, Connection& conn);
+    void expire_connections(EventLoop& loop);
+    void close_connection(EventLoop& loop, int fd);
+    void release_peer(const std::string& peer);
+    
+    // Routing
+    using RouteHandler = HttpResponse (WebServer::*)(const HttpRequest&);
+    // Metrics ids for requests outside the route table; table routes follow
+    static const uint32_t ROUTE_ID_STATIC = 0;
+    static const uint32_t ROUTE_ID_UNMATCHED = 1;
+    static const uint32_t ROUTE_ID_INVALID = 2;
+    static const uint32_t ROUTE_ID_FIRST = 3;
+    // Table route for the request, with its metrics id; null if none matches
+    static const Route<RouteHandler>* find_route(const HttpRequest& request, uint32_t& route_id,
+                                                 std::map<std::string, std::string>* params);
+    // ROUTE_AUTH, or ROUTE_METRICS without --metrics-public
+    bool requires_session(const Route<RouteHandler>& route) const;
+    // Fills in trace's route and auth time
+    HttpResponse route_request(HttpRequest& request, RequestTrace& trace);
+    // Once a request's headers are in and its body is still to come: the
+    // route's body limit in max_body, or false and the response refusing a
+    // request without the session its route requires, so neither waits for
+    // the body
+    bool screen_request_head(const HttpRequest& head, size_t& max_body, HttpResponse& refusal);
+    // Run a handler, turning an escaped exception into a 500
+    static HttpResponse run_handler(const std::function<HttpResponse()>& handler);
+    bool authenticate(HttpRequest& request);
+    
     // HTTP parsing
     HttpRequest parse_http_request(const std::string& request);
-    std::string build_http_response(const HttpResponse& response);
     std::string extract_session_token(const HttpRequest& request);
-    bool is_session_valid(const std::string& token);
-    void update_session_activity(const std::string& token);
+    // Username for a live session token, or null; marks the session active
+    const std::string* session_username(const std::string& token);
+    // Log username in; false when the session table is full
+    bool start_session(const std::string& username, std::string& token);
+    // Carry sessions and their terminal directories across a restart
+    void restore_sessions();
+    void save_sessions();
     
     // Version control functions
     std::string calculate_file_hash(const std::string& content);
+    // Hash of a file's contents, read in blocks; unreadable files hash as empty
+    std::string calculate_file_hash_at(const std::string& path);
     std::string generate_version_id();
     bool init_repository(const std::string& username, const std::string& path);
     bool create_version(const std::string& username, const std::string& path, const std::string& message);
@@ -147,11 +183,9 @@ private:
     bool create_branch(const std::string& username, const std::string& path, const std::string& branch_name);
     bool switch_branch(const std::string& username, const std::string& path, const std::string& branch_name);
     std::vector<Version> get_version_history(const std::string& username, const std::string& path);
-    void load_repositories();
-    void save_repositories();
     
     // Route handlers
-    HttpResponse handle_static_file(const std::string& path);
+    HttpResponse handle_static_file(const HttpRequest& request);
     HttpResponse handle_auth(const HttpRequest& request);
     HttpResponse handle_login_internal(const std::string& username, const std::string& password);
     HttpResponse handle_register_internal(const std::string& username, const std::string& password);
@@ -161,6 +195,9 @@ private:
     HttpResponse handle_logout(const HttpRequest& request);
     HttpResponse handle_get_files(const HttpRequest& request);
     HttpResponse handle_get_file(const HttpRequest& request);
+    HttpResponse handle_get_raw_file(const HttpRequest& request);
+    HttpResponse handle_find(const HttpRequest& request);
+    HttpResponse handle_search(const HttpRequest& request);
     HttpResponse handle_save_file(const HttpRequest& request);
     HttpResponse handle_create_file(const HttpRequest& request);
     HttpResponse handle_create_directory(const HttpRequest& request);
@@ -175,18 +212,29 @@ private:
     HttpResponse handle_save_api_key(const HttpRequest& request);
     HttpResponse handle_get_api_key(const HttpRequest& request);
     HttpResponse handle_terminal_execute(const HttpRequest& request);
-    HttpResponse handle_index();
+    HttpResponse handle_index(const HttpRequest& request);
+    HttpResponse handle_metrics(const HttpRequest& request);
 
 public:
-    WebServer(uint16_t port);
+    explicit WebServer(const ServerConfig& config);
     ~WebServer();
-    void start();
+
+    // Handle one request on the calling thread, without a socket: routing,
+    // auth middleware and the handler, with password hashing run inline
+    // rather than on the crypto pool. A streamed body is left in
+    // response.stream (see collect_body()). Safe to call from several
+    // threads, and alongside start(); recorded in the request metrics.
+    HttpResponse dispatch(HttpRequest request);
+
+    // Serve until a signal ends the server; true if it drained for a warm restart
+    bool start();
     void stop();
-    void load_users();
-    void save_users();
+    // Listening sockets, detached from the loops and inheritable across exec
+    std::vector<int> release_listeners();
 };
 
 // Function declarations
-void start_server(uint16_t port);
+// Run the server; SIGUSR2 re-executes argv on the same listening sockets
+void start_server(const ServerConfig& config, char** argv);
 
 #endif // SERVER_HPP
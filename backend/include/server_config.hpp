@@ -0,0 +1,46 @@
+#ifndef SERVER_CONFIG_HPP
+#define SERVER_CONFIG_HPP
+
+#include <cstdint>
+#include <string>
+#include "crypto.hpp"
+#include "http_parser.hpp"
+#include "event_loop.hpp"
+#include "logger.hpp"
+
+// Runtime configuration. Defaults are overridden by WEBEDITOR_* environment
+// variables, which are in turn overridden by command-line flags.
+struct ServerConfig {
+    uint16_t port = 8080;
+    size_t acceptors = 1;           // Event loops, each with its own SO_REUSEPORT listener
+    int backlog = 1024;             // listen() backlog per listener
+    bool pin_cpus = false;          // Pin event loop i to CPU i
+    int defer_accept_secs = 0;      // TCP_DEFER_ACCEPT; 0 leaves it off
+    int fastopen_queue = 0;         // TCP_FASTOPEN queue length; 0 leaves it off
+    size_t worker_threads = 0;      // Handler pool size; 0 uses the core count
+    size_t crypto_threads = 2;      // Password hashing pool size
+    size_t crypto_queue = 64;       // Hashing jobs waiting beyond this get 503
+    size_t search_threads = 0;      // Content search pool size; 0 uses the core count
+    PasswordKdf password_kdf;       // Used for new and upgraded password hashes
+    std::string data_dir = "data";
+    std::string frontend_dir = "frontend";
+    size_t static_cache_max_file = 1024 * 1024;  // Larger frontend files are sent with sendfile()
+    size_t workspace_index_budget = 64 * 1024 * 1024;  // Memory for indexed workspace trees; 0 disables the index
+    size_t search_index_budget = 256 * 1024 * 1024;  // Memory for content search filters; 0 disables them
+    size_t max_sessions = 65536;    // Concurrent logins; further logins get 503
+    uint64_t session_timeout_ms = 3600 * 1000;  // Sessions unused this long are expired
+    bool metrics_public = false;    // Serve /api/metrics without a session, for scrapers
+    uint64_t drain_timeout_ms = 10000;  // Wait for in-flight requests on shutdown or warm restart
+    LogLevel log_level = LogLevel::INFO;
+    LogFormat log_format = LogFormat::TEXT;
+    HttpLimits http_limits;
+    ConnectionLimits connection_limits;
+};
+
+// Apply environment variables and then argv to config. Returns false with a
+// message in error on bad input, or with an empty error after --help.
+bool parse_server_config(int argc, char** argv, ServerConfig& config, std::string& error);
+
+std::string server_config_usage(const char* program);
+
+#endif // SERVER_CONFIG_HPP
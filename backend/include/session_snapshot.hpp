@@ -0,0 +1,23 @@
+#ifndef SESSION_SNAPSHOT_HPP
+#define SESSION_SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+#include "session_store.hpp"
+
+// A session and its terminal state, as written at shutdown
+struct SessionSnapshotEntry {
+    SessionStore::SavedSession session;
+    std::string directory;   // Terminal working directory; empty if never set
+};
+
+// Write entries to path through a memory-mapped temporary file that is
+// renamed into place, so readers see the old snapshot or the complete new one
+bool write_session_snapshot(const std::string& path, const std::vector<SessionSnapshotEntry>& entries,
+                            std::string& error);
+
+// Read a snapshot written by write_session_snapshot. Idle times include the
+// wall-clock time the snapshot spent on disk. A missing file yields no entries.
+bool read_session_snapshot(const std::string& path, std::vector<SessionSnapshotEntry>& entries, std::string& error);
+
+#endif // SESSION_SNAPSHOT_HPP
@@ -0,0 +1,130 @@
+#ifndef SESSION_STORE_HPP
+#define SESSION_STORE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "timer_wheel.hpp"
+
+// 256-bit random session identifier. Clients see it as 64 hex digits.
+struct SessionToken {
+    uint64_t words[4] = {};
+
+    // Fresh token from the OpenSSL CSPRNG, via the batched random_bytes()
+    static SessionToken generate();
+    // Decode exactly 64 hex digits; false on any other input
+    static bool parse(std::string_view hex, SessionToken& out);
+    std::string to_hex() const;
+
+    bool operator==(const SessionToken& other) const {
+        return words[0] == other.words[0] && words[1] == other.words[1] &&
+               words[2] == other.words[2] && words[3] == other.words[3];
+    }
+};
+
+// Concurrent session table.
+//
+// Sessions live in a fixed open-addressing table of cache-line sized slots.
+// Each slot is guarded by a sequence lock: validate() reads it optimistically
+// and retries only if a writer raced it, so lookups take no locks and never
+// write shared memory apart from a once-a-second activity stamp. Inserts and
+// removals claim a slot by making its sequence odd.
+//
+// Idle sessions are expired by a background thread driving a timer wheel.
+// A timer fires at the last known expiry; if the session was used since, it
+// is simply rescheduled, so activity never touches the wheel.
+class SessionStore {
+public:
+    // Called with the token of every session that ends, by logout or expiry
+    using EndCallback = std::function<void(const SessionToken&)>;
+
+    // A live session as carried across a restart
+    struct SavedSession {
+        SessionToken token;
+        std::string username;
+        uint64_t idle_ms = 0;   // Time since it was last used
+    };
+
+    SessionStore(size_t max_sessions, uint64_t idle_timeout_ms, EndCallback on_end = nullptr);
+    ~SessionStore();
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    // Start a session for username; false when max_sessions are live
+    bool create(const std::string& username, SessionToken& token);
+    // Username of a live session, marking it active; null if unknown or idle
+    // too long. The string stays valid for the lifetime of the store.
+    const std::string* validate(const SessionToken& token);
+    void remove(const SessionToken& token);
+
+    // Copy out every live session
+    std::vector<SavedSession> save() const;
+    // Reinstate a saved session under its old token; false if the table is
+    // full, the session has since expired or the token is already live
+    bool restore(const SavedSession& session);
+
+    size_t size() const { return live.load(std::memory_order_relaxed); }
+
+private:
+    enum : uint32_t { EMPTY = 0, LIVE = 1, DELETED = 2 };
+
+    struct alignas(64) Slot {
+        std::atomic<uint32_t> sequence{0};          // Odd while a writer owns the slot
+        std::atomic<uint32_t> state{EMPTY};
+        std::atomic<uint64_t> token[4] = {};
+        std::atomic<uint64_t> last_active_ms{0};    // Written outside the sequence lock
+        std::atomic<const std::string*> username{nullptr};
+    };
+
+    // Consistent copy of a slot taken under the sequence lock
+    struct SlotView {
+        uint32_t state;
+        SessionToken token;
+        const std::string* username;
+    };
+
+    size_t home_slot(const SessionToken& token) const { return token.words[0] & mask; }
+    SlotView read_slot(const Slot& slot) const;
+    void lock_slot(Slot& slot);
+    void unlock_slot(Slot& slot);
+    // Index of the slot holding token, or capacity if absent
+    size_t find_slot(const SessionToken& token, SlotView& view) const;
+    // Claim a slot for token and start its expiry timer; false when full
+    bool insert(const SessionToken& token, const std::string& username, uint64_t last_active_ms);
+    bool erase_slot(size_t index, const SessionToken& token);
+    const std::string* intern(const std::string& username);
+    void sweep_loop();
+
+    size_t capacity;
+    size_t mask;
+    size_t max_sessions;
+    uint64_t idle_timeout_ms;
+    uint64_t activity_resolution_ms;    // Coarser stamps keep validation from dirtying the slot's cache line
+    EndCallback on_end;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> max_probe{0};   // Longest distance from home slot of any insert
+
+    // Usernames are interned so slots can hold a stable pointer
+    std::mutex names_mutex;
+    std::unordered_set<std::string> names;
+
+    // Expiry timers, one per slot, owned by the sweeper
+    std::mutex timers_mutex;
+    std::condition_variable timers_changed;
+    std::unique_ptr<TimerNode[]> timer_nodes;
+    TimerWheel timers;
+    bool stopping = false;
+    std::thread sweeper;
+};
+
+#endif // SESSION_STORE_HPP
@@ -0,0 +1,143 @@
+#ifndef SHARDED_MAP_HPP
+#define SHARDED_MAP_HPP
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+// Lock-striped hash map: keys are spread over independent shards, each
+// guarded by its own reader/writer lock. Readers of the same shard never
+// block each other, and writers only contend within a shard.
+//
+// Values are never handed out by reference; callers copy them out or
+// operate on them inside a callback while the shard lock is held.
+template <typename K, typename V, size_t ShardCount = 64>
+class ShardedMap {
+public:
+    // Copy the value for key into out; returns false if absent
+    bool find(const K& key, V& out) const {
+        const Shard& shard = shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    bool contains(const K& key) const {
+        const Shard& shard = shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.find(key) != shard.map.end();
+    }
+
+    // Run fn(const V&) under a shared lock; returns false if absent
+    template <typename F>
+    bool read(const K& key, F&& fn) const {
+        const Shard& shard = shard_for(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        fn(it->second);
+        return true;
+    }
+
+    // Run fn(V&) under an exclusive lock; returns false if absent
+    template <typename F>
+    bool update(const K& key, F&& fn) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) return false;
+        fn(it->second);
+        return true;
+    }
+
+    // Run fn(V&) under an exclusive lock, default-constructing the value if
+    // absent; the entry is erased when fn returns false
+    template <typename F>
+    void upsert(const K& key, F&& fn) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.try_emplace(key).first;
+        if (!fn(it->second)) shard.map.erase(it);
+    }
+
+    // Insert only if the key is absent; returns false if it already existed
+    bool insert(const K& key, V value) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.emplace(key, std::move(value)).second;
+    }
+
+    // Insert or overwrite
+    void assign(const K& key, V value) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map[key] = std::move(value);
+    }
+
+    bool erase(const K& key) {
+        Shard& shard = shard_for(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.erase(key) > 0;
+    }
+
+    // Erase entries matching pred(const K&, const V&), one shard at a time
+    template <typename F>
+    size_t erase_if(F&& pred) {
+        size_t erased = 0;
+        for (Shard& shard : shards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            for (auto it = shard.map.begin(); it != shard.map.end();) {
+                if (pred(it->first, it->second)) {
+                    it = shard.map.erase(it);
+                    erased++;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return erased;
+    }
+
+    // Visit every entry with fn(const K&, const V&), one shard at a time.
+    // The snapshot is consistent per shard, not across the whole map.
+    template <typename F>
+    void for_each(F&& fn) const {
+        for (const Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto& pair : shard.map) {
+                fn(pair.first, pair.second);
+            }
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<K, V> map;
+    };
+
+    Shard& shard_for(const K& key) {
+        return shards[std::hash<K>{}(key) % ShardCount];
+    }
+
+    const Shard& shard_for(const K& key) const {
+        return shards[std::hash<K>{}(key) % ShardCount];
+    }
+
+    std::array<Shard, ShardCount> shards;
+};
+
+#endif // SHARDED_MAP_HPP
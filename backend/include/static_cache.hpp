@@ -0,0 +1,76 @@
+#ifndef STATIC_CACHE_HPP
+#define STATIC_CACHE_HPP
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unordered_map>
+
+// MIME type from the file extension, or fallback when it is not known
+std::string mime_type_for(const std::string& filename, const char* fallback = "text/plain");
+
+// IMF-fixdate, as used by Last-Modified
+std::string http_date(time_t when);
+
+// Weak entity tag from size and modification time, for files sent without
+// reading them
+std::string weak_etag(const struct stat& st);
+
+// One servable frontend file. Entries are immutable once published; a
+// change on disk replaces the whole entry.
+struct StaticAsset {
+    std::string file_path;       // Location on disk, for sendfile() of uncached files
+    std::string mime_type;
+    std::string etag;            // Quoted entity tag of the identity representation
+    std::string gzip_etag;       // Tags of the coded representations, when present
+    std::string brotli_etag;
+    std::string last_modified;   // IMF-fixdate
+    size_t size = 0;
+    // Preloaded representations; identity is null when the file is too large to cache
+    std::shared_ptr<const std::string> identity;
+    std::shared_ptr<const std::string> gzip;
+    std::shared_ptr<const std::string> brotli;
+};
+
+// In-memory cache of the frontend directory. Files are loaded and
+// precompressed once; lookups read an immutable snapshot that is swapped
+// atomically when inotify reports a change, so readers never lock.
+class StaticFileCache {
+public:
+    StaticFileCache(const std::string& root, size_t max_cached_size);
+    ~StaticFileCache();
+
+    StaticFileCache(const StaticFileCache&) = delete;
+    StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+    // Scan the root directory and publish the initial snapshot
+    void load();
+    // Start the inotify thread that keeps the snapshot current
+    void start_watching();
+
+    // Look up a URL path ("/" maps to /index.html); null if not servable
+    std::shared_ptr<const StaticAsset> find(const std::string& url_path) const;
+
+private:
+    using Snapshot = std::unordered_map<std::string, std::shared_ptr<const StaticAsset>>;
+
+    std::shared_ptr<const StaticAsset> load_asset(const std::string& url_path) const;
+    void scan_directory(const std::string& url_dir, Snapshot& snapshot);
+    void add_watch(const std::string& url_dir);
+    void watch_loop();
+    void publish(std::shared_ptr<const Snapshot> next);
+
+    std::string root;
+    size_t max_cached_size;
+    std::shared_ptr<const Snapshot> snapshot; // Accessed with std::atomic_load/atomic_store
+
+    int inotify_fd;
+    std::unordered_map<int, std::string> watched_dirs; // watch descriptor -> URL directory
+    std::atomic<bool> stopping{false};
+    std::thread watcher;
+};
+
+#endif // STATIC_CACHE_HPP
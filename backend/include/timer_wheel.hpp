@@ -0,0 +1,97 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+// Milliseconds on the monotonic clock, unaffected by wall-clock changes
+inline uint64_t monotonic_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Intrusive timer entry, embedded in the object it times out. Linking and
+// unlinking never allocate, and a node unlinks itself when destroyed.
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint64_t expires = 0;      // Absolute tick
+    void* owner = nullptr;     // Handed back on expiry
+
+    bool scheduled() const { return next != nullptr; }
+    void unlink() {
+        if (!next) return;
+        prev->next = next;
+        next->prev = prev;
+        prev = next = nullptr;
+    }
+
+    TimerNode() = default;
+    ~TimerNode() { unlink(); }
+    TimerNode(const TimerNode&) = delete;
+    TimerNode& operator=(const TimerNode&) = delete;
+};
+
+// Hierarchical timer wheel with four levels of 64 slots each.
+//
+// Level 0 covers the next 64 ticks one slot per tick; each higher level
+// covers 64 times the span of the one below. Timers far in the future sit
+// in a coarse slot and are cascaded down as the wheel turns, so schedule,
+// reschedule and cancel are O(1) and advancing costs one slot per tick
+// plus an occasional cascade, independent of how many timers exist.
+class TimerWheel {
+public:
+    TimerWheel(uint64_t tick_ms, uint64_t now_ms);
+
+    // (Re)arm node to fire at deadline_ms; deadlines in the past fire on the next tick
+    void schedule(TimerNode& node, uint64_t deadline_ms);
+    void cancel(TimerNode& node) { if (node.scheduled()) { node.unlink(); count--; } }
+
+    // Fire every timer due by now_ms. Expired nodes are unlinked before
+    // on_expire(node) runs, which may freely schedule or cancel timers.
+    template <typename F>
+    void advance(uint64_t now_ms, F&& on_expire);
+
+    size_t size() const { return count; }
+    uint64_t tick_ms() const { return tick; }
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const uint64_t SLOTS = 1 << SLOT_BITS;
+
+    void place(TimerNode& node);
+    void cascade(int level);
+
+    TimerNode slots[LEVELS][SLOTS];    // Sentinels of circular lists
+    uint64_t tick;
+    uint64_t current;                  // Last tick processed
+    size_t count;
+};
+
+template <typename F>
+void TimerWheel::advance(uint64_t now_ms, F&& on_expire) {
+    uint64_t target = now_ms / tick;
+    while (current < target && count > 0) {
+        current++;
+        // A wrap of level 0 pulls the next slot of level 1 down, and so on upwards
+        for (int level = 1; level < LEVELS; level++) {
+            if ((current >> (SLOT_BITS * (level - 1))) & (SLOTS - 1)) break;
+            cascade(level);
+        }
+
+        TimerNode& slot = slots[0][current & (SLOTS - 1)];
+        while (slot.next != &slot) {
+            TimerNode* node = slot.next;
+            node->unlink();
+            count--;
+            on_expire(*node);
+        }
+    }
+    // Nothing pending: jump straight to the present
+    if (current < target) current = target;
+}
+
+#endif // TIMER_WHEEL_HPP
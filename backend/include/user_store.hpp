@@ -0,0 +1,130 @@
+#ifndef USER_STORE_HPP
+#define USER_STORE_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include "sharded_map.hpp"
+
+// User structure
+struct User {
+    std::string username;
+    std::string password_hash;
+    std::string session_token;   // Latest session; not persisted
+    time_t last_activity = 0;
+    std::string filesystem_path;
+    std::string api_key;
+    std::string api_provider;
+    std::string api_model;
+};
+
+// Durable user table.
+//
+// Every change appends one CRC-checked record to users.log; concurrent
+// writers share a single fdatasync (group commit). users.idx is a memory-
+// mapped open-addressing index from username hash to the offset of the
+// user's latest record. It is checkpointed periodically and on close, so
+// opening the store maps the index and replays only records written since
+// the last checkpoint. Records are read on first access and kept in memory.
+//
+// When superseded records outweigh live ones the log is compacted into a
+// fresh generation; an index from another generation is rebuilt.
+class UserStore {
+public:
+    explicit UserStore(const std::string& data_dir);
+    ~UserStore();
+
+    UserStore(const UserStore&) = delete;
+    UserStore& operator=(const UserStore&) = delete;
+
+    // Open or create the log and index, importing a legacy users.txt once
+    bool open(std::string& error);
+
+    bool find(const std::string& username, User& out);
+    bool contains(const std::string& username);
+
+    // Run fn(const User&) on the cached record; returns false if absent
+    template <typename F>
+    bool read(const std::string& username, F&& fn) {
+        return load(username) && cache.read(username, std::forward<F>(fn));
+    }
+
+    // Insert and persist; false if the username is taken
+    bool insert(const User& user);
+
+    // Apply fn(User&) and persist the result; returns false if absent
+    template <typename F>
+    bool update(const std::string& username, F&& fn) {
+        if (!load(username)) return false;
+        uint64_t offset = 0, end = 0;
+        bool found = cache.update(username, [&](User& user) {
+            User updated = user;
+            fn(updated);
+            // Appending under the entry's lock keeps the log in update order
+            end = append(updated, offset);
+            user = std::move(updated);
+        });
+        return found && commit(username, offset, end);
+    }
+
+    size_t size() const;
+
+private:
+    struct IndexHeader;
+    struct IndexSlot;
+    // One mapping of an index file
+    struct Index {
+        int fd = -1;
+        size_t size = 0;
+        IndexHeader* header = nullptr;
+        IndexSlot* slots = nullptr;
+    };
+
+    // Bring username into the cache from the log; false if unknown
+    bool load(const std::string& username);
+    // Write the record at offset and return the log offset just past it
+    uint64_t append(const User& user, uint64_t& offset);
+    // Wait until the record is durable, then point the index at it
+    bool commit(const std::string& username, uint64_t offset, uint64_t end);
+    void wait_durable(uint64_t end);
+
+    // Parse the record at offset; length receives its size on disk
+    bool read_record(int fd, uint64_t offset, User& user, uint32_t& length) const;
+    // Slot holding username (its record copied to found, if given), or the empty slot ending its probe
+    IndexSlot* find_slot(uint64_t hash, const std::string& username, User* found = nullptr) const;
+    void index_record(const std::string& username, uint64_t offset, uint32_t length);
+    bool map_index(const std::string& path, uint64_t capacity, bool create, Index& out) const;
+    void unmap_index(Index& mapping) const;
+    void grow_index();
+    bool rebuild_index();
+    bool replay(uint64_t from);
+    void checkpoint();
+    void compact();
+    bool import_legacy(const std::string& path);
+
+    std::string log_path;
+    std::string index_path;
+    int log_fd = -1;
+    Index index;
+    uint64_t generation = 0;         // Bumped by compaction; the index must match the log
+
+    ShardedMap<std::string, User> cache;
+
+    // Guards the index and the log file itself; compaction takes it exclusively
+    mutable std::shared_mutex store_mutex;
+
+    std::mutex append_mutex;
+    uint64_t log_end = 0;            // Next append offset
+    uint64_t unindexed = 0;          // Appended records not yet in the index
+    uint64_t updates_since_checkpoint = 0;
+
+    std::mutex sync_mutex;
+    std::condition_variable sync_done;
+    uint64_t durable_end = 0;
+    bool syncing = false;
+};
+
+#endif // USER_STORE_HPP
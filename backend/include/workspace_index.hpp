@@ -0,0 +1,137 @@
+#ifndef WORKSPACE_INDEX_HPP
+#define WORKSPACE_INDEX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "directory_listing.hpp"
+#include "fuzzy_finder.hpp"
+
+// In-memory tree of each user's workspace, so listings and existence
+// checks do not touch the disk.
+//
+// A user's tree is built from one walk of their directory on first access
+// and then kept current from inotify. Every directory in it is watched, so
+// changes made from the terminal show up as well as the editor's own.
+// Pending events are applied before each lookup: a change that completed
+// before a request started is always visible to it. Trees are flat arrays
+// of nodes with their names in one arena, under a single mutex. When the
+// total passes the memory budget the least recently used trees are
+// dropped, to be rebuilt when next needed.
+class WorkspaceIndex {
+public:
+    enum class Result {
+        FOUND,
+        NOT_FOUND,
+        BAD_CURSOR,
+        UNAVAILABLE     // Not indexed: disabled, over budget, out of watches or behind a symlink; ask the disk
+    };
+
+    // users_root holds one directory per user; a budget of 0 disables the index
+    WorkspaceIndex(const std::string& users_root, size_t memory_budget);
+    ~WorkspaceIndex();
+
+    WorkspaceIndex(const WorkspaceIndex&) = delete;
+    WorkspaceIndex& operator=(const WorkspaceIndex&) = delete;
+
+    // Start the thread that applies events while no lookups arrive
+    void start_watching();
+
+    // Entries of relative_dir ("" for the workspace root), as list_directory()
+    Result list(const std::string& username, const std::string& relative_dir, const ListingQuery& query,
+                ListingPage& page);
+    // Metadata of a single file or directory
+    Result find(const std::string& username, const std::string& relative_path, ListingEntry& entry);
+    // Every path in the workspace, built on first use after its names last changed
+    Result paths(const std::string& username, std::shared_ptr<const PathList>& list);
+    // The same, with the current size and modification time of each path
+    Result paths(const std::string& username, std::shared_ptr<const PathList>& list, std::vector<FileStamp>& stamps);
+
+    size_t memory_used() const;
+    size_t user_count() const;
+
+private:
+    static const uint32_t NO_NODE = UINT32_MAX;
+
+    struct Node {
+        uint32_t parent = NO_NODE;
+        uint32_t name_offset = 0;        // In Tree::names
+        uint32_t name_length = 0;
+        int watch = -1;                  // inotify watch on an indexed directory
+        uint64_t size = 0;
+        int64_t modified_ns = 0;
+        bool is_directory = false;       // Following symlinks
+        bool indexed = false;            // A real directory whose children are in the tree
+        bool live = false;
+        std::vector<uint32_t> children;  // Sorted by name
+    };
+
+    struct Tree {
+        std::string username;
+        std::vector<Node> nodes;         // nodes[0] is the workspace root
+        std::string names;
+        std::vector<uint32_t> free_nodes;
+        size_t dead_name_bytes = 0;
+        size_t child_slots = 0;
+        size_t bytes = 0;                // Last accounted footprint
+        uint64_t last_used = 0;
+        std::shared_ptr<const PathList> path_list;  // Reset whenever a node is added or removed
+        std::vector<uint32_t> path_nodes;           // Node of each path_list entry
+
+        std::string_view name(uint32_t node) const {
+            return {names.data() + nodes[node].name_offset, nodes[node].name_length};
+        }
+    };
+
+    struct Watch {
+        Tree* tree;
+        uint32_t node;
+    };
+
+    // All of these run with mutex held
+    Tree* tree_for(const std::string& username);
+    bool build(Tree& tree);
+    bool scan_directory(Tree& tree, uint32_t node);
+    // real_directory is set for a directory that is not a symlink, which is indexed
+    bool stat_node(Tree& tree, uint32_t node, bool& real_directory);
+    uint32_t add_node(Tree& tree, uint32_t parent, std::string_view name);
+    void remove_node(Tree& tree, uint32_t node);
+    uint32_t find_child(const Tree& tree, uint32_t parent, std::string_view name) const;
+    // False if the path leaves what the tree can answer for; node is NO_NODE when it does not exist
+    bool resolve(const Tree& tree, const std::string& relative_path, uint32_t& node) const;
+    std::string path_of(const Tree& tree, uint32_t node) const;
+    ListingEntry entry_of(const Tree& tree, uint32_t node) const;
+    void collect_paths(const Tree& tree, uint32_t node, std::string& prefix, PathList& list,
+                       std::vector<uint32_t>& nodes) const;
+    // tree's path list, rebuilt if names have changed since it was last made
+    const std::shared_ptr<const PathList>& path_list_of(Tree& tree);
+    void drain_events();
+    void apply_event(Tree& tree, uint32_t node, uint32_t mask, const char* name);
+    void account(Tree& tree);
+    void enforce_budget(const Tree* keep);
+    void drop_tree(const std::string& username);
+    void watch_loop();
+
+    std::string users_root;
+    size_t memory_budget;
+    int inotify_fd = -1;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::unique_ptr<Tree>> trees;
+    std::unordered_map<int, Watch> watches;
+    std::unordered_map<std::string, uint64_t> retry_after_ms;  // Users whose tree did not fit, until then
+    size_t total_bytes = 0;
+    uint64_t use_clock = 0;
+
+    std::atomic<bool> stopping{false};
+    std::thread watcher;
+};
+
+#endif // WORKSPACE_INDEX_HPP
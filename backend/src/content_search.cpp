@@ -0,0 +1,675 @@
+//content_search.cpp
+#include "../include/content_search.hpp"
+#include "../include/directory_listing.hpp"
+#include "../include/metrics.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const size_t NOT_FOUND = (size_t)-1;
+// Most of a file read and searched at once
+const size_t READ_BLOCK = 4 * 1024 * 1024;
+// A line still unfinished at this much buffered text is searched in pieces, without context
+const size_t MAX_LINE_BUFFER = 4 * READ_BLOCK;
+// A NUL byte this early marks a file as binary
+const size_t BINARY_PROBE = 8192;
+// Longest text sent for a matching or context line
+const size_t MAX_LINE_TEXT = 512;
+// Text kept before the match when a long line is cut
+const size_t LINE_LEAD = 128;
+// Output a task collects before publishing it mid-file
+const size_t PUBLISH_BYTES = 64 * 1024;
+// Filter sizes, as log2 of the bit count
+const unsigned MIN_FILTER_BITS = 9;
+const unsigned MAX_FILTER_BITS = 24;
+
+inline unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+inline unsigned char unfold(unsigned char c) {
+    return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+}
+
+inline uint32_t trigram_hash(uint32_t trigram) {
+    return trigram * 0x9E3779B1u;
+}
+
+void add_trigrams(const std::string& text, std::vector<uint32_t>& trigrams) {
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        trigrams.push_back((uint32_t)fold(text[i]) << 16 | (uint32_t)fold(text[i + 1]) << 8 | fold(text[i + 2]));
+    }
+}
+
+// Runs of literal characters every match of an extended regular expression
+// contains. Conservative: groups, bracket expressions, escapes of letters
+// and anything a quantifier can make optional break runs, and alternation
+// outside a group leaves nothing required.
+std::vector<std::string> required_runs(const std::string& pattern) {
+    std::vector<std::string> runs;
+    std::string run;
+    auto flush = [&] {
+        if (!run.empty()) runs.push_back(run);
+        run.clear();
+    };
+    auto skip_bracket = [&](size_t i) {
+        // i is at '['; a ']' first in the list is literal, and one inside
+        // [:class:], [=equivalence=] or [.collating.] does not end the list
+        i++;
+        if (i < pattern.size() && pattern[i] == '^') i++;
+        if (i < pattern.size() && pattern[i] == ']') i++;
+        while (i < pattern.size() && pattern[i] != ']') {
+            if (pattern[i] == '[' && i + 1 < pattern.size() &&
+                (pattern[i + 1] == ':' || pattern[i + 1] == '=' || pattern[i + 1] == '.')) {
+                size_t close = pattern.find(std::string{pattern[i + 1], ']'}, i + 2);
+                if (close != std::string::npos) {
+                    i = close + 2;
+                    continue;
+                }
+            }
+            i++;
+        }
+        return i;
+    };
+
+    int depth = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        char c = pattern[i];
+        if (depth > 0) {
+            if (c == '\\') i++;
+            else if (c == '[') i = skip_bracket(i);
+            else if (c == '(') depth++;
+            else if (c == ')') depth--;
+            continue;
+        }
+        switch (c) {
+        case '|':
+            return {};
+        case '(':
+            flush();
+            depth = 1;
+            break;
+        case '[':
+            flush();
+            i = skip_bracket(i);
+            break;
+        case '.': case '^': case '$': case '+':
+            flush();
+            break;
+        case '*': case '?':
+            if (!run.empty()) run.pop_back();
+            flush();
+            break;
+        case '{':
+            if (!run.empty()) run.pop_back();
+            flush();
+            while (i < pattern.size() && pattern[i] != '}') i++;
+            break;
+        case '\\':
+            if (i + 1 < pattern.size() && !isalnum((unsigned char)pattern[i + 1])) {
+                run += pattern[++i];
+            } else {
+                flush();
+                i++;
+            }
+            break;
+        default:
+            run += c;
+            break;
+        }
+    }
+    flush();
+    return runs;
+}
+
+bool matches_at(const char* text, const std::string& needle, bool ignore_case) {
+    if (!ignore_case) return memcmp(text, needle.data(), needle.size()) == 0;
+    for (size_t i = 0; i < needle.size(); i++) {
+        if (fold(text[i]) != (unsigned char)needle[i]) return false;
+    }
+    return true;
+}
+
+// First occurrence of needle at or after from; needle is lowercase when ignoring case
+size_t find_literal(const char* data, size_t size, size_t from, const std::string& needle, bool ignore_case) {
+    size_t length = needle.size();
+    if (length == 0 || size < length || from > size - length) return NOT_FOUND;
+    size_t last_start = size - length;
+    size_t i = from;
+#ifdef __SSE2__
+    // Candidates are positions where both the first and the last byte of
+    // the needle match, sixteen at a time; only those are compared in full
+    unsigned char first = needle[0], last = needle[length - 1];
+    __m128i first_lower = _mm_set1_epi8((char)first);
+    __m128i first_upper = _mm_set1_epi8((char)(ignore_case ? unfold(first) : first));
+    __m128i last_lower = _mm_set1_epi8((char)last);
+    __m128i last_upper = _mm_set1_epi8((char)(ignore_case ? unfold(last) : last));
+    for (; i + 15 <= last_start; i += 16) {
+        __m128i starts = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i ends = _mm_loadu_si128((const __m128i*)(data + i + length - 1));
+        __m128i first_hits = _mm_or_si128(_mm_cmpeq_epi8(starts, first_lower), _mm_cmpeq_epi8(starts, first_upper));
+        __m128i last_hits = _mm_or_si128(_mm_cmpeq_epi8(ends, last_lower), _mm_cmpeq_epi8(ends, last_upper));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(first_hits, last_hits));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (matches_at(data + i + bit, needle, ignore_case)) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i <= last_start; i++) {
+        if (matches_at(data + i, needle, ignore_case)) return i;
+    }
+    return NOT_FOUND;
+}
+
+size_t line_start_of(const char* data, size_t floor, size_t position) {
+    const void* newline = memrchr(data + floor, '\n', position - floor);
+    return newline ? (const char*)newline - data + 1 : floor;
+}
+
+size_t line_end_of(const char* data, size_t size, size_t position) {
+    const void* newline = memchr(data + position, '\n', size - position);
+    return newline ? (const char*)newline - data : size;
+}
+
+// Move a cut point off UTF-8 continuation bytes
+size_t char_boundary(const char* data, size_t position, size_t floor) {
+    while (position > floor && ((unsigned char)data[position] & 0xC0) == 0x80) position--;
+    return position;
+}
+
+// One bit per possible trigram, marking those a builder has already collected
+std::vector<uint64_t>& seen_trigrams() {
+    thread_local std::vector<uint64_t> seen(1u << 18);
+    return seen;
+}
+
+// Fill buffer from offset, stopping early only at end of file or on an error
+size_t read_at(int fd, char* buffer, size_t size, uint64_t offset) {
+    size_t filled = 0;
+    while (filled < size) {
+        ssize_t count = pread(fd, buffer + filled, size - filled, (off_t)(offset + filled));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        filled += count;
+    }
+    return filled;
+}
+
+void append_line(std::string& out, const char* data, size_t start, size_t end) {
+    if (end > start && data[end - 1] == '\r') end--;
+    if (end - start > MAX_LINE_TEXT) end = char_boundary(data, start + MAX_LINE_TEXT, start);
+    append_json_string(out, std::string_view(data + start, end - start));
+}
+
+} // namespace
+
+// SearchPattern
+
+SearchPattern::~SearchPattern() {
+    if (compiled_valid) regfree(&compiled);
+}
+
+bool SearchPattern::compile(const std::string& query, bool regex, bool ignore_case, std::string& error) {
+    if (query.empty()) {
+        error = "Query required";
+        return false;
+    }
+    if (query.find('\n') != std::string::npos) {
+        error = "Query must be a single line";
+        return false;
+    }
+    is_regex = regex;
+    this->ignore_case = ignore_case;
+
+    std::vector<std::string> runs;
+    if (regex) {
+        int status = regcomp(&compiled, query.c_str(), REG_EXTENDED | REG_NEWLINE | (ignore_case ? REG_ICASE : 0));
+        if (status != 0) {
+            char message[256];
+            regerror(status, &compiled, message, sizeof(message));
+            error = std::string("Invalid regular expression: ") + message;
+            return false;
+        }
+        compiled_valid = true;
+        runs = required_runs(query);
+    } else {
+        runs.push_back(query);
+    }
+
+    for (const std::string& run : runs) {
+        add_trigrams(run, required_trigrams);
+        if (run.size() > literal.size()) literal = run;
+    }
+    std::sort(required_trigrams.begin(), required_trigrams.end());
+    required_trigrams.erase(std::unique(required_trigrams.begin(), required_trigrams.end()), required_trigrams.end());
+    if (ignore_case) {
+        for (char& c : literal) {
+            c = (char)fold(c);
+        }
+    }
+    return true;
+}
+
+bool SearchPattern::find(const char* data, size_t size, size_t from, size_t& match_start,
+                         size_t& match_length) const {
+    if (!is_regex) {
+        match_start = find_literal(data, size, from, literal, ignore_case);
+        match_length = literal.size();
+        return match_start != NOT_FOUND;
+    }
+
+    regmatch_t match[1];
+    if (literal.empty()) {
+        match[0].rm_so = (regoff_t)from;
+        match[0].rm_eo = (regoff_t)size;
+        if (from > size || regexec(&compiled, data, 1, match, REG_STARTEND) != 0) return false;
+        match_start = match[0].rm_so;
+        match_length = match[0].rm_eo - match[0].rm_so;
+        return true;
+    }
+
+    // Only lines holding the required literal can match
+    while (from < size) {
+        size_t hit = find_literal(data, size, from, literal, ignore_case);
+        if (hit == NOT_FOUND) return false;
+        size_t line_start = line_start_of(data, from, hit);
+        size_t line_end = line_end_of(data, size, hit);
+        match[0].rm_so = (regoff_t)line_start;
+        match[0].rm_eo = (regoff_t)line_end;
+        if (regexec(&compiled, data, 1, match, REG_STARTEND) == 0) {
+            match_start = match[0].rm_so;
+            match_length = match[0].rm_eo - match[0].rm_so;
+            return true;
+        }
+        from = line_end + 1;
+    }
+    return false;
+}
+
+// TrigramFilter
+
+void TrigramFilter::Builder::add(const char* data, size_t size) {
+    size_t i = 0;
+    for (; i < size && primed < 2; i++, primed++) {
+        trigram = (trigram << 8 | fold(data[i])) & 0xFFFF;
+    }
+    std::vector<uint64_t>& seen = seen_trigrams();
+    for (; i < size; i++) {
+        trigram = (trigram << 8 | fold(data[i])) & 0xFFFFFF;
+        uint64_t bit = 1ull << (trigram & 63);
+        if (!(seen[trigram >> 6] & bit)) {
+            seen[trigram >> 6] |= bit;
+            distinct.push_back(trigram);
+        }
+    }
+}
+
+TrigramFilter TrigramFilter::Builder::finish() {
+    TrigramFilter filter;
+    unsigned log2_bits = MIN_FILTER_BITS;
+    while (log2_bits < MAX_FILTER_BITS && (1ull << log2_bits) < distinct.size() * 8) log2_bits++;
+    filter.shift = 32 - log2_bits;
+    filter.bits.assign((1ull << log2_bits) / 64, 0);
+    for (uint32_t trigram : distinct) {
+        uint32_t bit = trigram_hash(trigram) >> filter.shift;
+        filter.bits[bit >> 6] |= 1ull << (bit & 63);
+    }
+    clear();
+    return filter;
+}
+
+void TrigramFilter::Builder::clear() {
+    std::vector<uint64_t>& seen = seen_trigrams();
+    for (uint32_t trigram : distinct) {
+        seen[trigram >> 6] = 0;
+    }
+    distinct.clear();
+    trigram = 0;
+    primed = 0;
+}
+
+TrigramFilter TrigramFilter::build(const char* data, size_t size) {
+    TrigramFilter::Builder builder;
+    builder.add(data, size);
+    return builder.finish();
+}
+
+bool TrigramFilter::may_contain(const std::vector<uint32_t>& trigrams) const {
+    if (bits.empty()) return true;
+    for (uint32_t trigram : trigrams) {
+        uint32_t bit = trigram_hash(trigram) >> shift;
+        if (!(bits[bit >> 6] & (1ull << (bit & 63)))) return false;
+    }
+    return true;
+}
+
+// ContentIndex
+
+size_t ContentIndex::select(const std::string& username, std::vector<SearchFile>& files,
+                            const std::vector<uint32_t>& trigrams, bool complete) {
+    if (memory_budget == 0) return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    UserFilters& user = users[username];
+    user.last_used = ++use_clock;
+    uint64_t generation = ++user.generation;
+
+    size_t kept = 0, pruned = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        SearchFile& file = files[i];
+        auto it = user.entries.find(file.path);
+        if (it != user.entries.end()) {
+            Entry& entry = it->second;
+            entry.seen = generation;
+            if (entry.stamp == file.stamp) {
+                file.refresh = false;
+                if (entry.binary || !entry.filter.may_contain(trigrams)) {
+                    pruned++;
+                    continue;
+                }
+            }
+        }
+        if (kept != i) files[kept] = std::move(file);
+        kept++;
+    }
+    files.resize(kept);
+
+    if (complete) {
+        // Files that have gone
+        for (auto it = user.entries.begin(); it != user.entries.end();) {
+            if (it->second.seen == generation) {
+                ++it;
+                continue;
+            }
+            size_t bytes = entry_bytes(it->first, it->second);
+            user.bytes -= bytes;
+            total_bytes -= bytes;
+            it = user.entries.erase(it);
+        }
+    }
+    return pruned;
+}
+
+void ContentIndex::update(const std::string& username, const std::string& path, const FileStamp& stamp, bool binary,
+                          TrigramFilter filter) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto user_it = users.find(username);
+    if (user_it == users.end()) return;  // Evicted since the search began
+    UserFilters& user = user_it->second;
+
+    auto it = user.entries.find(path);
+    if (it != user.entries.end()) {
+        size_t bytes = entry_bytes(it->first, it->second);
+        user.bytes -= bytes;
+        total_bytes -= bytes;
+        user.entries.erase(it);
+    }
+
+    Entry entry;
+    entry.stamp = stamp;
+    entry.binary = binary;
+    entry.filter = std::move(filter);
+    entry.seen = user.generation;
+    size_t bytes = entry_bytes(path, entry);
+    evict_for(&user, bytes);
+    // Still too big: the file is read by every search instead
+    if (total_bytes + bytes > memory_budget) return;
+    user.entries.emplace(path, std::move(entry));
+    user.bytes += bytes;
+    total_bytes += bytes;
+}
+
+size_t ContentIndex::memory_used() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_bytes;
+}
+
+size_t ContentIndex::user_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return users.size();
+}
+
+size_t ContentIndex::entry_bytes(const std::string& path, const Entry& entry) {
+    // Key, entry and an estimate of the hash node around them
+    return path.capacity() + sizeof(Entry) + entry.filter.memory_used() + 32;
+}
+
+void ContentIndex::evict_for(const UserFilters* keep, size_t needed) {
+    while (total_bytes + needed > memory_budget) {
+        auto victim = users.end();
+        for (auto it = users.begin(); it != users.end(); ++it) {
+            if (&it->second != keep && (victim == users.end() || it->second.last_used < victim->second.last_used)) {
+                victim = it;
+            }
+        }
+        if (victim == users.end()) return;
+        total_bytes -= victim->second.bytes;
+        users.erase(victim);
+    }
+}
+
+// SearchJob
+
+SearchJob::SearchJob(std::string root, std::vector<SearchFile> files, std::shared_ptr<const SearchPattern> pattern,
+                     SearchOptions options, ContentIndex* index, std::string username, size_t pruned)
+    : root(std::move(root)), files(std::move(files)), pattern(std::move(pattern)), options(options), index(index),
+      username(std::move(username)), pruned(pruned), start_us(monotonic_us()) {}
+
+void SearchJob::start(WorkStealingPool& pool) {
+    size_t tasks = std::min(pool.size(), files.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = tasks;
+    }
+    for (size_t i = 0; i < tasks; i++) {
+        pool.submit([job = shared_from_this()] { job->run(); });
+    }
+}
+
+void SearchJob::cancel() {
+    cancelled = true;
+    std::lock_guard<std::mutex> lock(mutex);
+    waiter = nullptr;
+}
+
+bool SearchJob::take(std::string& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (finished) return false;
+    out += pending;
+    pending.clear();
+    if (running > 0) return true;
+
+    out += "{\"done\":true,\"filesSearched\":" + std::to_string(files_read.load()) +
+           ",\"filesSkipped\":" + std::to_string(pruned) +
+           ",\"matches\":" + std::to_string(std::min(matches.load(), options.max_matches)) +
+           ",\"truncated\":" + (truncated ? "true" : "false") +
+           ",\"elapsedMs\":" + std::to_string((monotonic_us() - start_us) / 1000) + "}\n";
+    finished = true;
+    return false;
+}
+
+bool SearchJob::wait(std::function<void()> resume) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pending.empty() || running == 0) return false;
+    waiter = std::move(resume);
+    return true;
+}
+
+void SearchJob::run() {
+    std::string buffer, out;
+    TrigramFilter::Builder trigrams;
+    while (!cancelled) {
+        size_t next = next_file.fetch_add(1);
+        if (next >= files.size()) break;
+        search_file(files[next], buffer, trigrams, out);
+        publish(out);
+    }
+    std::function<void()> resume;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // The reader waits for the summary only once the last task is done
+        if (--running == 0) {
+            resume = std::move(waiter);
+            waiter = nullptr;
+        }
+    }
+    if (resume) resume();
+}
+
+void SearchJob::publish(std::string& out) {
+    if (out.empty()) return;
+    std::function<void()> resume;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending += out;
+        resume = std::move(waiter);
+        waiter = nullptr;
+    }
+    out.clear();
+    if (resume) resume();
+}
+
+void SearchJob::search_file(const SearchFile& file, std::string& buffer, TrigramFilter::Builder& trigrams,
+                            std::string& out) {
+    int fd = open((root + "/" + file.path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return;
+    }
+    files_read++;
+
+    // Read in blocks rather than mapped: a mapping faults with SIGBUS if the
+    // file is truncated mid-scan. A block is searched up to its last whole
+    // line, less the lines that context after a hit needs; those and the
+    // context before the next hit carry over into the next block.
+    uint64_t size = (uint64_t)st.st_size;
+    uint64_t offset = 0;
+    size_t position = 0;                 // Next buffer byte to search from
+    size_t line_number = 1, counted = 0; // Line of buffer byte counted
+    size_t lead = 0;                     // Bytes of the buffer's first line dropped with earlier blocks
+    bool binary = false, at_end = false;
+    buffer.clear();
+    while (!at_end && !cancelled) {
+        size_t kept = buffer.size();
+        size_t want = (size_t)std::min<uint64_t>(READ_BLOCK, size - offset);
+        buffer.resize(kept + want);
+        size_t got = read_at(fd, &buffer[kept], want, offset);
+        buffer.resize(kept + got);
+        if (offset == 0) binary = memchr(buffer.data(), 0, std::min(buffer.size(), BINARY_PROBE)) != nullptr;
+        offset += got;
+        at_end = got < want || offset >= size;
+        if (binary) break;
+        const char* data = buffer.data();
+        if (file.refresh) trigrams.add(data + kept, got);
+
+        size_t complete = buffer.size();
+        bool whole_lines = !at_end && complete - position < MAX_LINE_BUFFER;
+        if (whole_lines) {
+            const void* newline = memrchr(data + position, '\n', complete - position);
+            if (!newline) continue;
+            complete = (const char*)newline - data + 1;
+        }
+        size_t search_end = complete;
+        for (size_t i = 0; whole_lines && i < options.context_lines && search_end > position; i++) {
+            search_end = line_start_of(data, position, search_end - 1);
+        }
+
+        size_t match_start, match_length;
+        while (!cancelled && position < search_end &&
+               pattern->find(data, search_end, position, match_start, match_length)) {
+            size_t line_start = line_start_of(data, position, match_start);
+            line_number += std::count(data + counted, data + line_start, '\n');
+            counted = line_start;
+            if (matches.fetch_add(1) >= options.max_matches) {
+                truncated = true;
+                cancelled = true;
+                break;
+            }
+            append_hit(out, file.path, data, complete, line_start, line_start == 0 ? lead : 0, line_number,
+                       match_start, match_length);
+            if (out.size() >= PUBLISH_BYTES) publish(out);
+
+            // One hit per line
+            position = std::min(line_end_of(data, search_end, match_start) + 1, search_end);
+        }
+        if (at_end) break;
+        position = search_end;
+
+        // Drop what is searched, keeping the lines before position that context may show
+        size_t drop = position;
+        for (size_t i = 0; whole_lines && i < options.context_lines && drop > 0; i++) {
+            drop = line_start_of(data, 0, drop - 1);
+        }
+        if (counted < drop) {
+            line_number += std::count(data + counted, data + drop, '\n');
+            counted = drop;
+        }
+        counted -= drop;
+        position -= drop;
+        size_t last_line = line_start_of(data, 0, drop);
+        lead = (last_line == 0 ? lead : 0) + drop - last_line;
+        buffer.erase(0, drop);
+    }
+    close(fd);
+
+    // A filter needs the whole file; one cut short by cancellation is not kept
+    if (file.refresh && (binary || (at_end && !cancelled))) {
+        FileStamp stamp{(uint64_t)st.st_size, (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec};
+        index->update(username, file.path, stamp, binary, binary ? TrigramFilter() : trigrams.finish());
+    }
+    trigrams.clear();
+}
+
+void SearchJob::append_hit(std::string& out, const std::string& path, const char* data, size_t size,
+                           size_t line_start, size_t line_lead, size_t line_number, size_t match_start,
+                           size_t match_length) {
+    size_t line_end = line_end_of(data, size, match_start);
+    // A long line is cut to a window around the match
+    size_t text_start = line_start;
+    if (line_end - line_start > MAX_LINE_TEXT && match_start - line_start > LINE_LEAD) {
+        text_start = char_boundary(data, match_start - LINE_LEAD, line_start);
+    }
+
+    out += "{\"path\":";
+    append_json_string(out, path);
+    out += ",\"line\":" + std::to_string(line_number) + ",\"column\":" + std::to_string(line_lead + match_start - line_start + 1) +
+           ",\"length\":" + std::to_string(match_length) + ",\"text\":";
+    append_line(out, data, text_start, line_end);
+    out += ",\"textColumn\":" + std::to_string(line_lead + text_start - line_start + 1);
+
+    if (options.context_lines > 0) {
+        std::vector<std::pair<size_t, size_t>> before;
+        for (size_t end = line_start; before.size() < options.context_lines && end > 0;) {
+            size_t start = line_start_of(data, 0, end - 1);
+            before.emplace_back(start, end - 1);
+            end = start;
+        }
+        out += ",\"before\":[";
+        for (size_t i = before.size(); i-- > 0;) {
+            append_line(out, data, before[i].first, before[i].second);
+            if (i != 0) out += ",";
+        }
+        out += "],\"after\":[";
+        size_t start = line_end + 1;
+        for (size_t i = 0; i < options.context_lines && start < size; i++) {
+            size_t end = line_end_of(data, size, start);
+            if (i != 0) out += ",";
+            append_line(out, data, start, end);
+            start = end + 1;
+        }
+        out += "]";
+    }
+    out += "}\n";
+}
@@ -0,0 +1,175 @@
+//crypto.cpp
+#include "../include/crypto.hpp"
+#include <algorithm>
+#include <cstring>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const size_t RANDOM_BLOCK_SIZE = 4096;
+const size_t SALT_SIZE = 16;
+const size_t DERIVED_KEY_SIZE = 32;
+
+struct RandomBuffer {
+    unsigned char bytes[RANDOM_BLOCK_SIZE];
+    size_t used = RANDOM_BLOCK_SIZE;   // Starts empty
+};
+
+thread_local RandomBuffer random_buffer;
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool from_hex(const std::string& hex, std::vector<unsigned char>& out) {
+    if (hex.size() % 2 != 0) return false;
+    out.resize(hex.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        int high = hex_value(hex[2 * i]);
+        int low = hex_value(hex[2 * i + 1]);
+        if (high < 0 || low < 0) return false;
+        out[i] = (unsigned char)(high * 16 + low);
+    }
+    return true;
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (;;) {
+        size_t end = text.find(separator, start);
+        fields.push_back(text.substr(start, end - start));
+        if (end == std::string::npos) return fields;
+        start = end + 1;
+    }
+}
+
+bool parse_uint(const std::string& text, uint64_t& value) {
+    if (text.empty() || text.size() > 19 || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    value = std::stoull(text);
+    return true;
+}
+
+bool pbkdf2(const std::string& password, const std::vector<unsigned char>& salt, uint64_t iterations,
+            unsigned char* out, size_t length) {
+    if (iterations == 0 || iterations > 0x7fffffff) return false;
+    return PKCS5_PBKDF2_HMAC(password.data(), (int)password.size(), salt.data(), (int)salt.size(),
+                             (int)iterations, EVP_sha256(), (int)length, out) == 1;
+}
+
+bool scrypt(const std::string& password, const std::vector<unsigned char>& salt, uint64_t log2_n, uint64_t r,
+            uint64_t p, unsigned char* out, size_t length) {
+    if (log2_n == 0 || log2_n > 24 || r == 0 || r > 64 || p == 0 || p > 64) return false;
+    uint64_t n = 1ULL << log2_n;
+    // Working memory is 128 * r * (N + p) bytes; leave headroom over OpenSSL's 32 MB default cap
+    uint64_t max_memory = 128 * r * (n + p) + 1024 * 1024;
+    return EVP_PBE_scrypt(password.data(), password.size(), salt.data(), salt.size(), n, r, p, max_memory,
+                          out, length) == 1;
+}
+
+// Constant-time equality of two hex digests of public length
+bool digests_equal(const std::string& computed, const std::string& expected) {
+    return computed.size() == expected.size() &&
+           CRYPTO_memcmp(computed.data(), expected.data(), computed.size()) == 0;
+}
+
+} // namespace
+
+void random_bytes(void* out, size_t length) {
+    unsigned char* dest = static_cast<unsigned char*>(out);
+    RandomBuffer& buffer = random_buffer;
+    while (length > 0) {
+        if (buffer.used == RANDOM_BLOCK_SIZE) {
+            if (RAND_bytes(buffer.bytes, RANDOM_BLOCK_SIZE) != 1) {
+                throw std::runtime_error("RAND_bytes failed");
+            }
+            buffer.used = 0;
+        }
+        size_t take = std::min(length, RANDOM_BLOCK_SIZE - buffer.used);
+        memcpy(dest, buffer.bytes + buffer.used, take);
+        // Handed-out bytes must not linger where a later caller could observe them
+        OPENSSL_cleanse(buffer.bytes + buffer.used, take);
+        buffer.used += take;
+        dest += take;
+        length -= take;
+    }
+}
+
+std::string to_hex(const unsigned char* data, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(length * 2, '0');
+    for (size_t i = 0; i < length; i++) {
+        hex[2 * i] = digits[data[i] >> 4];
+        hex[2 * i + 1] = digits[data[i] & 0xf];
+    }
+    return hex;
+}
+
+std::string hash_password(const std::string& password, const PasswordKdf& kdf) {
+    std::vector<unsigned char> salt(SALT_SIZE);
+    random_bytes(salt.data(), salt.size());
+    unsigned char key[DERIVED_KEY_SIZE];
+
+    if (kdf.algorithm == PasswordKdf::SCRYPT) {
+        if (!scrypt(password, salt, kdf.scrypt_log2_n, kdf.scrypt_r, kdf.scrypt_p, key, sizeof(key))) {
+            throw std::runtime_error("scrypt failed");
+        }
+        return "scrypt$" + std::to_string(kdf.scrypt_log2_n) + "$" + std::to_string(kdf.scrypt_r) + "$" +
+               std::to_string(kdf.scrypt_p) + "$" + to_hex(salt.data(), salt.size()) + "$" + to_hex(key, sizeof(key));
+    }
+
+    if (!pbkdf2(password, salt, kdf.pbkdf2_iterations, key, sizeof(key))) {
+        throw std::runtime_error("PBKDF2 failed");
+    }
+    return "pbkdf2-sha256$" + std::to_string(kdf.pbkdf2_iterations) + "$" + to_hex(salt.data(), salt.size()) + "$" +
+           to_hex(key, sizeof(key));
+}
+
+bool verify_password(const std::string& password, const std::string& stored) {
+    std::vector<std::string> fields = split(stored, '$');
+    std::vector<unsigned char> salt;
+    unsigned char key[DERIVED_KEY_SIZE];
+
+    if (fields.size() == 4 && fields[0] == "pbkdf2-sha256") {
+        uint64_t iterations;
+        if (!parse_uint(fields[1], iterations) || !from_hex(fields[2], salt)) return false;
+        if (fields[3].size() != 2 * sizeof(key)) return false;
+        if (!pbkdf2(password, salt, iterations, key, sizeof(key))) return false;
+        return digests_equal(to_hex(key, sizeof(key)), fields[3]);
+    }
+
+    if (fields.size() == 6 && fields[0] == "scrypt") {
+        uint64_t log2_n, r, p;
+        if (!parse_uint(fields[1], log2_n) || !parse_uint(fields[2], r) || !parse_uint(fields[3], p)) return false;
+        if (!from_hex(fields[4], salt) || fields[5].size() != 2 * sizeof(key)) return false;
+        if (!scrypt(password, salt, log2_n, r, p, key, sizeof(key))) return false;
+        return digests_equal(to_hex(key, sizeof(key)), fields[5]);
+    }
+
+    // Legacy format: hex salt, ':', SHA-256 of password + salt
+    size_t colon_pos = stored.find(':');
+    if (fields.size() == 1 && colon_pos != std::string::npos) {
+        std::string salted = password + stored.substr(0, colon_pos);
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        SHA256(reinterpret_cast<const unsigned char*>(salted.data()), salted.size(), digest);
+        return digests_equal(to_hex(digest, sizeof(digest)), stored.substr(colon_pos + 1));
+    }
+    return false;
+}
+
+bool needs_rehash(const std::string& stored, const PasswordKdf& kdf) {
+    std::vector<std::string> fields = split(stored, '$');
+    if (kdf.algorithm == PasswordKdf::SCRYPT) {
+        return fields.size() != 6 || fields[0] != "scrypt" || fields[1] != std::to_string(kdf.scrypt_log2_n) ||
+               fields[2] != std::to_string(kdf.scrypt_r) || fields[3] != std::to_string(kdf.scrypt_p);
+    }
+    return fields.size() != 4 || fields[0] != "pbkdf2-sha256" || fields[1] != std::to_string(kdf.pbkdf2_iterations);
+}
@@ -0,0 +1,261 @@
+//directory_listing.cpp
+#include "../include/directory_listing.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/stat.h>
+
+namespace {
+
+// An entry's place in the sort order: its sort key, then its name
+struct Position {
+    int64_t key = 0;
+    std::string_view name;
+};
+
+int64_t sort_key(const ListingEntry& entry, ListingSort sort) {
+    switch (sort) {
+    case ListingSort::SIZE: return (int64_t)entry.size;
+    case ListingSort::MODIFIED: return (int64_t)entry.last_modified;
+    case ListingSort::NAME: break;
+    }
+    return 0;
+}
+
+bool before(const Position& a, const Position& b, bool descending) {
+    if (a.key != b.key) return descending ? a.key > b.key : a.key < b.key;
+    return descending ? a.name > b.name : a.name < b.name;
+}
+
+char cursor_tag(ListingSort sort) {
+    return sort == ListingSort::SIZE ? 's' : sort == ListingSort::MODIFIED ? 'm' : 'n';
+}
+
+// Hex of "n:<name>", "s:<size>:<name>" or "m:<time>:<name>", so it needs
+// no escaping in JSON or a query string
+std::string make_cursor(const ListingEntry& entry, ListingSort sort) {
+    std::string cursor(1, cursor_tag(sort));
+    cursor += ':';
+    if (sort != ListingSort::NAME) {
+        cursor += std::to_string(sort_key(entry, sort));
+        cursor += ':';
+    }
+    cursor += entry.name;
+
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(cursor.size() * 2);
+    for (unsigned char c : cursor) {
+        hex += digits[c >> 4];
+        hex += digits[c & 15];
+    }
+    return hex;
+}
+
+bool parse_cursor(const std::string& hex, ListingSort sort, int64_t& key, std::string& name) {
+    if (hex.size() % 2 != 0) return false;
+    std::string cursor;
+    cursor.reserve(hex.size() / 2);
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        unsigned char byte;
+        auto parsed = std::from_chars(hex.data() + i, hex.data() + i + 2, byte, 16);
+        if (parsed.ec != std::errc() || parsed.ptr != hex.data() + i + 2) return false;
+        cursor += (char)byte;
+    }
+
+    if (cursor.size() < 2 || cursor[0] != cursor_tag(sort) || cursor[1] != ':') return false;
+    key = 0;
+    if (sort == ListingSort::NAME) {
+        name = cursor.substr(2);
+        return true;
+    }
+    size_t colon = cursor.find(':', 2);
+    if (colon == std::string::npos) return false;
+    auto parsed = std::from_chars(cursor.data() + 2, cursor.data() + colon, key);
+    if (parsed.ec != std::errc() || parsed.ptr != cursor.data() + colon) return false;
+    name = cursor.substr(colon + 1);
+    return true;
+}
+
+// Fill in the metadata; false if the entry vanished since readdir
+bool stat_entry(int dir_fd, ListingEntry& entry) {
+    struct stat st;
+    // A dangling symlink is still listed, as itself
+    if (fstatat(dir_fd, entry.name.c_str(), &st, 0) < 0 &&
+        fstatat(dir_fd, entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) < 0) {
+        return false;
+    }
+    entry.is_directory = S_ISDIR(st.st_mode);
+    entry.size = S_ISREG(st.st_mode) ? (uint64_t)st.st_size : 0;
+    entry.last_modified = st.st_mtim.tv_sec;
+    return true;
+}
+
+struct FieldName {
+    const char* name;
+    unsigned field;
+};
+
+const FieldName FIELD_NAMES[] = {
+    {"name", LISTING_NAME},
+    {"fullPath", LISTING_FULL_PATH},
+    {"path", LISTING_PATH},
+    {"size", LISTING_SIZE},
+    {"lastModified", LISTING_LAST_MODIFIED},
+    {"isDirectory", LISTING_IS_DIRECTORY},
+};
+
+} // namespace
+
+bool select_page(std::vector<ListingEntry>& entries, const ListingQuery& query, ListingPage& page) {
+    page.entries.clear();
+    page.next_cursor.clear();
+
+    if (!query.cursor.empty()) {
+        int64_t cursor_key;
+        std::string cursor_name;
+        if (!parse_cursor(query.cursor, query.sort, cursor_key, cursor_name)) {
+            errno = EINVAL;
+            return false;
+        }
+        Position after{cursor_key, cursor_name};
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [&](const ListingEntry& entry) {
+                                         return !before(after, {sort_key(entry, query.sort), entry.name},
+                                                        query.descending);
+                                     }),
+                      entries.end());
+    }
+
+    auto order = [&](const ListingEntry& a, const ListingEntry& b) {
+        return before({sort_key(a, query.sort), a.name}, {sort_key(b, query.sort), b.name}, query.descending);
+    };
+    if (query.limit != 0 && entries.size() > query.limit) {
+        std::partial_sort(entries.begin(), entries.begin() + query.limit, entries.end(), order);
+        entries.resize(query.limit);
+        page.next_cursor = make_cursor(entries.back(), query.sort);
+    } else {
+        std::sort(entries.begin(), entries.end(), order);
+    }
+    page.entries = std::move(entries);
+    return true;
+}
+
+bool list_directory(const std::string& path, const ListingQuery& query, ListingPage& page) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return false;
+    int dir_fd = dirfd(dir);
+
+    // By name, only the names are needed to choose the page; other orders stat everything
+    bool stat_all = query.sort != ListingSort::NAME;
+    std::vector<ListingEntry> entries;
+    while (dirent* d = readdir(dir)) {
+        if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+        ListingEntry entry;
+        entry.name = d->d_name;
+        if (stat_all && !stat_entry(dir_fd, entry)) continue;
+        entries.push_back(std::move(entry));
+    }
+
+    bool selected = select_page(entries, query, page);
+    if (selected && !stat_all) {
+        page.entries.erase(std::remove_if(page.entries.begin(), page.entries.end(),
+                                          [&](ListingEntry& entry) { return !stat_entry(dir_fd, entry); }),
+                           page.entries.end());
+    }
+    int saved_errno = errno;
+    closedir(dir);
+    errno = saved_errno;
+    return selected;
+}
+
+void append_json_string(std::string& out, std::string_view value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+bool parse_listing_sort(const std::string& value, ListingSort& sort, bool& descending) {
+    descending = !value.empty() && value[0] == '-';
+    std::string_view name(value);
+    if (descending) name.remove_prefix(1);
+    if (name == "name") sort = ListingSort::NAME;
+    else if (name == "size") sort = ListingSort::SIZE;
+    else if (name == "modified") sort = ListingSort::MODIFIED;
+    else return false;
+    return true;
+}
+
+bool parse_listing_fields(const std::string& value, unsigned& fields) {
+    fields = 0;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) end = value.size();
+        std::string_view name(value.data() + start, end - start);
+        bool known = false;
+        for (const FieldName& field : FIELD_NAMES) {
+            if (name == field.name) {
+                fields |= field.field;
+                known = true;
+            }
+        }
+        if (!known) return false;
+        start = end + 1;
+    }
+    return fields != 0;
+}
+
+void append_listing_entry(std::string& out, const ListingEntry& entry, const std::string& relative_dir,
+                          unsigned fields) {
+    std::string relative_path = relative_dir.empty() ? entry.name : relative_dir + "/" + entry.name;
+    bool first = true;
+    auto key = [&](const char* name) {
+        out += first ? "{\"" : ",\"";
+        out += name;
+        out += "\":";
+        first = false;
+    };
+
+    if (fields & LISTING_NAME) {
+        key("name");
+        append_json_string(out, entry.name);
+    }
+    if (fields & LISTING_FULL_PATH) {
+        key("fullPath");
+        append_json_string(out, relative_path);
+    }
+    if (fields & LISTING_SIZE) {
+        key("size");
+        out += std::to_string(entry.size);
+    }
+    if (fields & LISTING_LAST_MODIFIED) {
+        key("lastModified");
+        out += std::to_string((long long)entry.last_modified);
+    }
+    if (fields & LISTING_IS_DIRECTORY) {
+        key("isDirectory");
+        out += entry.is_directory ? "true" : "false";
+    }
+    if (fields & LISTING_PATH) {
+        key("path");
+        append_json_string(out, relative_path);
+    }
+    out += first ? "{}" : "}";
+}
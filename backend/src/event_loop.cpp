@@ -0,0 +1,796 @@
+//event_loop.cpp
+#include "../include/server.hpp"
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+
+const int MAX_EVENTS = 256;
+const size_t READ_CHUNK_SIZE = 16384;
+const size_t MAX_PIPELINE_BUFFER = 1 << 20;       // Read-ahead cap while a request is in flight
+const size_t MAX_REQUESTS_PER_CONNECTION = 1000;
+const int DRAIN_POLL_MS = 100;                    // Loop wakeup while waiting for connections to finish
+
+// Signals are forwarded through a pipe so the reactor handles them like any other event
+int signal_pipe[2] = {-1, -1};
+
+void forward_signal(int signal_number) {
+    int saved_errno = errno;
+    unsigned char byte = (unsigned char)signal_number;
+    ssize_t ignored = write(signal_pipe[1], &byte, 1);
+    (void)ignored;
+    errno = saved_errno;
+}
+
+bool install_signal_handlers() {
+    if (signal_pipe[0] < 0 && pipe2(signal_pipe, O_NONBLOCK | O_CLOEXEC) < 0) return false;
+    struct sigaction action = {};
+    action.sa_handler = forward_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    for (int signal_number : {SIGTERM, SIGINT, SIGUSR2}) {
+        if (sigaction(signal_number, &action, nullptr) < 0) return false;
+    }
+    return true;
+}
+
+// Listening sockets passed down by the process that re-executed us
+std::vector<int> inherited_listeners() {
+    std::vector<int> fds;
+    const char* value = getenv("WEBEDITOR_LISTEN_FDS");
+    if (!value) return fds;
+    std::string list = value;
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        int fd = atoi(list.substr(start, end - start).c_str());
+        if (fd > 2) fds.push_back(fd);
+        start = end + 1;
+    }
+    // Not for our own children
+    unsetenv("WEBEDITOR_LISTEN_FDS");
+    return fds;
+}
+
+// HTTP/1.1 defaults to persistent connections, HTTP/1.0 must opt in
+bool wants_keep_alive(const HttpRequest& request) {
+    std::string connection;
+    for (const auto& header : request.headers) {
+        if (strcasecmp(header.first.c_str(), "Connection") == 0) {
+            connection = header.second;
+            std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+            break;
+        }
+    }
+
+    if (request.version == "HTTP/1.1") {
+        return connection.find("close") == std::string::npos;
+    }
+    return connection.find("keep-alive") != std::string::npos;
+}
+
+// Per-IP accounting key: the raw address bytes, without the port
+std::string peer_key(const sockaddr_storage& address) {
+    if (address.ss_family == AF_INET6) {
+        const auto& ipv6 = reinterpret_cast<const sockaddr_in6&>(address);
+        return std::string((const char*)&ipv6.sin6_addr, sizeof(ipv6.sin6_addr));
+    }
+    const auto& ipv4 = reinterpret_cast<const sockaddr_in&>(address);
+    return std::string((const char*)&ipv4.sin_addr, sizeof(ipv4.sin_addr));
+}
+
+} // namespace
+
+// Global server instance
+static WebServer* g_server = nullptr;
+
+// Server lifecycle
+bool WebServer::start() {
+    if (!install_signal_handlers()) {
+        LOG_ERROR << "Failed to install signal handlers: " << strerror(errno);
+        return false;
+    }
+    signal_fd = signal_pipe[0];
+
+    // One event loop per acceptor; with more than one, SO_REUSEPORT lets the
+    // kernel spread incoming connections across their listeners
+    std::vector<int> inherited = inherited_listeners();
+    for (size_t i = 0; i < config.acceptors; i++) {
+        auto loop = std::make_unique<EventLoop>();
+        loop->index = i;
+        bool adopted = i < inherited.size() && adopt_listener(*loop, inherited[i]);
+        if (!adopted && !open_listener(*loop)) {
+            stop();
+            return false;
+        }
+
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop->epoll_fd < 0) {
+            LOG_ERROR << "Failed to create epoll instance";
+            stop();
+            return false;
+        }
+
+        epoll_event listen_event = {};
+        listen_event.events = EPOLLIN | EPOLLET;
+        listen_event.data.fd = loop->listen_fd;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->listen_fd, &listen_event) < 0) {
+            LOG_ERROR << "Failed to register listening socket";
+            stop();
+            return false;
+        }
+
+        loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epoll_event wake_event = {};
+        wake_event.events = EPOLLIN | EPOLLET;
+        wake_event.data.fd = loop->wake_fd;
+        if (loop->wake_fd < 0 || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &wake_event) < 0) {
+            LOG_ERROR << "Failed to create completion eventfd";
+            stop();
+            return false;
+        }
+        loops.push_back(std::move(loop));
+    }
+    for (size_t i = loops.size(); i < inherited.size(); i++) {
+        close(inherited[i]);
+    }
+
+    epoll_event signal_event = {};
+    signal_event.events = EPOLLIN | EPOLLET;
+    signal_event.data.fd = signal_fd;
+    if (epoll_ctl(loops[0]->epoll_fd, EPOLL_CTL_ADD, signal_fd, &signal_event) < 0) {
+        LOG_ERROR << "Failed to register signal pipe";
+        stop();
+        return false;
+    }
+
+    static_cache->start_watching();
+    workspace_index->start_watching();
+
+    LOG_INFO << "Server started on port " << config.port << " with " << loops.size() << " event loop(s) and "
+             << pool->size() << " worker threads" << (inherited.empty() ? "" : " on inherited listeners");
+
+    running = true;
+    for (size_t i = 1; i < loops.size(); i++) {
+        EventLoop* loop = loops[i].get();
+        loop->thread = std::thread([this, loop]() { run_loop(*loop); });
+    }
+    run_loop(*loops[0]);
+
+    // The other loops finish draining on their own
+    for (size_t i = 1; i < loops.size(); i++) {
+        if (loops[i]->thread.joinable()) loops[i]->thread.join();
+    }
+    return shutdown_mode.load() == Shutdown::RESTART;
+}
+
+bool WebServer::adopt_listener(EventLoop& loop, int fd) {
+    int accepting = 0;
+    socklen_t length = sizeof(accepting);
+    sockaddr_in address = {};
+    socklen_t address_length = sizeof(address);
+    bool usable = getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &length) == 0 && accepting &&
+                  getsockname(fd, (struct sockaddr*)&address, &address_length) == 0 &&
+                  address.sin_family == AF_INET && ntohs(address.sin_port) == config.port;
+    if (!usable) {
+        // Left over from a different configuration; bind afresh instead
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    loop.listen_fd = fd;
+    return true;
+}
+
+bool WebServer::open_listener(EventLoop& loop) {
+    loop.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (loop.listen_fd < 0) {
+        LOG_ERROR << "Failed to create socket";
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(loop.listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (config.acceptors > 1 && setsockopt(loop.listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        LOG_ERROR << "Failed to set SO_REUSEPORT: " << strerror(errno);
+        return false;
+    }
+    // Optional tuning: failure only costs the optimization
+    if (config.defer_accept_secs > 0 &&
+        setsockopt(loop.listen_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &config.defer_accept_secs, sizeof(int)) < 0) {
+        LOG_WARN << "TCP_DEFER_ACCEPT unavailable: " << strerror(errno);
+    }
+    if (config.fastopen_queue > 0 &&
+        setsockopt(loop.listen_fd, IPPROTO_TCP, TCP_FASTOPEN, &config.fastopen_queue, sizeof(int)) < 0) {
+        LOG_WARN << "TCP_FASTOPEN unavailable: " << strerror(errno);
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config.port);
+    address.sin_addr.s_addr = INADDR_ANY;
+    if (bind(loop.listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        LOG_ERROR << "Failed to bind socket";
+        return false;
+    }
+
+    if (listen(loop.listen_fd, config.backlog) < 0) {
+        LOG_ERROR << "Failed to listen";
+        return false;
+    }
+    return true;
+}
+
+void WebServer::run_loop(EventLoop& loop) {
+    if (config.pin_cpus) {
+        unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(loop.index % cpus, &cpu_set);
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (result != 0) {
+            LOG_WARN << "Failed to pin event loop " << loop.index << ": " << strerror(result);
+        }
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while (running) {
+        // Wake once per wheel tick only while some deadline is pending
+        int timeout = loop.timers.size() > 0 ? (int)loop.timers.tick_ms() : -1;
+        if (loop.draining) timeout = DRAIN_POLL_MS;
+        int ready = epoll_wait(loop.epoll_fd, events, MAX_EVENTS, timeout);
+        loop.now_ms = monotonic_ms();
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR << "epoll_wait failed: " << strerror(errno);
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            if (fd == loop.listen_fd) {
+                accept_connections(loop);
+                continue;
+            }
+            if (fd == loop.wake_fd) {
+                drain_completions(loop);
+                continue;
+            }
+            if (fd == signal_fd) {
+                handle_signals();
+                continue;
+            }
+
+            auto it = loop.connections.find(fd);
+            if (it == loop.connections.end()) continue;
+            Connection& conn = *it->second;
+
+            uint32_t flags = events[i].events;
+            bool keep = !(flags & EPOLLERR);
+            if (keep && (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) {
+                keep = handle_readable(loop, conn);
+            }
+            if (keep && conn.state == ConnectionState::WRITING) {
+                keep = handle_writable(loop, conn);
+            }
+            if (!keep) {
+                close_connection(loop, fd);
+            }
+        }
+
+        expire_connections(loop);
+
+        if (shutdown_mode.load(std::memory_order_acquire) != Shutdown::NONE) {
+            if (!loop.draining) begin_drain(loop);
+            if (loop.connections.empty() || loop.now_ms >= drain_deadline_ms.load()) break;
+        }
+    }
+}
+
+void WebServer::handle_signals() {
+    unsigned char received[16];
+    ssize_t count;
+    while ((count = read(signal_fd, received, sizeof(received))) > 0) {
+        for (ssize_t i = 0; i < count; i++) {
+            Shutdown requested = received[i] == SIGUSR2 ? Shutdown::RESTART : Shutdown::STOP;
+            if (shutdown_mode.load() != Shutdown::NONE) {
+                // A second stop signal gives up on whatever is still draining
+                if (requested == Shutdown::STOP) {
+                    LOG_INFO << "Stopping without waiting for open connections";
+                    drain_deadline_ms = 0;
+                    shutdown_mode = Shutdown::STOP;
+                }
+                continue;
+            }
+            LOG_INFO << (requested == Shutdown::RESTART ? "Warm restart requested" : "Shutting down")
+                     << ", draining connections";
+            drain_deadline_ms = monotonic_ms() + config.drain_timeout_ms;
+            shutdown_mode.store(requested, std::memory_order_release);
+        }
+    }
+
+    // Every loop notices the shutdown on its next pass
+    for (auto& loop : loops) {
+        uint64_t one = 1;
+        ssize_t ignored = write(loop->wake_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void WebServer::begin_drain(EventLoop& loop) {
+    loop.draining = true;
+    // Connections keep queueing on the socket; after a warm restart the next process accepts them
+    epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, loop.listen_fd, nullptr);
+
+    // Keep-alive connections between requests have nothing in flight
+    std::vector<int> idle;
+    for (const auto& pair : loop.connections) {
+        const Connection& conn = *pair.second;
+        if (conn.state == ConnectionState::READING && conn.in_buf.empty() && !conn.parser.reading_body()) {
+            idle.push_back(pair.first);
+        }
+    }
+    for (int fd : idle) {
+        close_connection(loop, fd);
+    }
+}
+
+std::vector<int> WebServer::release_listeners() {
+    std::vector<int> fds;
+    for (auto& loop : loops) {
+        if (loop->listen_fd < 0) continue;
+        fcntl(loop->listen_fd, F_SETFD, 0);
+        fds.push_back(loop->listen_fd);
+        loop->listen_fd = -1;
+    }
+    return fds;
+}
+
+void WebServer::accept_connections(EventLoop& loop) {
+    // Edge-triggered: drain the accept queue until it would block
+    while (true) {
+        sockaddr_storage peer_address;
+        socklen_t peer_length = sizeof(peer_address);
+        int client_fd = accept4(loop.listen_fd, (struct sockaddr*)&peer_address, &peer_length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR << "accept failed: " << strerror(errno);
+            }
+            return;
+        }
+
+        // The per-IP count is shared by all loops, so a client cannot multiply its cap across acceptors
+        std::string peer = peer_key(peer_address);
+        bool admitted = false;
+        connections_per_ip.upsert(peer, [&](size_t& open_from_peer) {
+            admitted = open_from_peer < config.connection_limits.max_connections_per_ip;
+            if (admitted) open_from_peer++;
+            return open_from_peer > 0;
+        });
+        if (!admitted) {
+            loop.connections_refused.fetch_add(1, std::memory_order_relaxed);
+            close(client_fd);
+            continue;
+        }
+
+        // Streamed responses go out as several small writes; Nagle would hold each
+        // one back until the client's delayed ACK of the previous, ~40 ms later
+        int one = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        epoll_event client_event = {};
+        client_event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        client_event.data.fd = client_fd;
+        if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event) < 0) {
+            release_peer(peer);
+            close(client_fd);
+            continue;
+        }
+
+        auto conn = std::make_unique<Connection>();
+        conn->fd = client_fd;
+        conn->id = loop.next_connection_id++;
+        conn->parser = HttpParser(config.http_limits);
+        conn->peer = std::move(peer);
+        conn->timer.owner = conn.get();
+        update_deadline(loop, *conn);
+        loop.connections[client_fd] = std::move(conn);
+        loop.connections_accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool WebServer::handle_readable(EventLoop& loop, Connection& conn) {
+    char buffer[READ_CHUNK_SIZE];
+    bool progressed = false;
+    bool parsed = false;
+    size_t received = 0;
+    HttpParser::Status status = HttpParser::Status::NEED_MORE;
+    while (!conn.peer_closed) {
+        // Pipelined bytes are buffered while a request is in flight, up to a cap;
+        // anything beyond it is picked up once the connection returns to READING
+        if (conn.state != ConnectionState::READING && conn.in_buf.size() >= MAX_PIPELINE_BUFFER) break;
+
+        ssize_t bytes_read = read(conn.fd, buffer, sizeof(buffer));
+        if (bytes_read > 0) {
+            conn.in_buf.append(buffer, bytes_read);
+            received += bytes_read;
+            progressed = true;
+            // A request is parsed as it arrives, so its size limits are enforced
+            // before a fast sender can grow the buffer past them
+            if (conn.state == ConnectionState::READING) {
+                status = parse_buffered(conn);
+                parsed = true;
+                if (status != HttpParser::Status::NEED_MORE) break;
+            }
+            continue;
+        }
+        if (bytes_read == 0) {
+            conn.peer_closed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        return false;
+    }
+    if (received > 0) loop.bytes_read.fetch_add(received, std::memory_order_relaxed);
+
+    // The rejection is already queued as the connection's response
+    if (status == HttpParser::Status::ERROR) return handle_writable(loop, conn);
+    if (conn.state != ConnectionState::READING) return true;
+
+    // Pipelined bytes buffered before this call have not been seen yet
+    if (!parsed) status = parse_buffered(conn);
+    if (status == HttpParser::Status::ERROR) return handle_writable(loop, conn);
+    if (status == HttpParser::Status::NEED_MORE) {
+        // Nothing more can arrive on a half-closed socket
+        if (conn.peer_closed) return false;
+
+        if (!conn.continue_sent && conn.parser.expects_continue()) {
+            static const char continue_line[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            conn.continue_sent = true;
+            // Best effort: the client sends the body anyway after a short wait
+            ssize_t ignored = send(conn.fd, continue_line, sizeof(continue_line) - 1, MSG_NOSIGNAL);
+            (void)ignored;
+        }
+        // Only received bytes move a deadline, so a silent peer cannot keep itself alive
+        if (progressed || !conn.timer.scheduled()) update_deadline(loop, conn);
+        return true;
+    }
+
+    process_request(loop, conn);
+    return true;
+}
+
+bool WebServer::handle_writable(EventLoop& loop, Connection& conn) {
+    size_t before = conn.writer.bytes_written();
+    ResponseWriter::Status status = conn.writer.write_to(conn.fd);
+    loop.bytes_written.fetch_add(conn.writer.bytes_written() - before, std::memory_order_relaxed);
+
+    // BLOCKED waits for the next EPOLLOUT edge, as long as the client keeps draining
+    if (status == ResponseWriter::Status::BLOCKED) {
+        if (conn.writer.bytes_written() != before || !conn.timer.scheduled()) update_deadline(loop, conn);
+        return true;
+    }
+    if (status == ResponseWriter::Status::ERROR) return false;
+    if (conn.writer.has_more()) {
+        produce_next_chunk(loop, conn);
+        return true;
+    }
+    finish_trace(conn);
+    if (conn.close_after_write || loop.draining) return false;
+
+    // Response fully sent; reuse the connection for the next (possibly pipelined) request
+    conn.writer = ResponseWriter();
+    conn.state = ConnectionState::READING;
+    loop.timers.cancel(conn.timer);
+    return handle_readable(loop, conn);
+}
+
+HttpParser::Status WebServer::parse_buffered(Connection& conn) {
+    uint64_t parse_start = monotonic_us();
+    HttpParser::Status status = conn.parser.parse(conn.in_buf);
+    if (status == HttpParser::Status::NEED_MORE && conn.parser.reading_body() && !conn.head_screened) {
+        // The route may refuse the request, or allow it a smaller body, before the body is buffered
+        conn.head_screened = true;
+        size_t max_body = 0;
+        HttpResponse refusal;
+        if (!screen_request_head(conn.parser.head(), max_body, refusal)) {
+            conn.parse_us += monotonic_us() - parse_start;
+            reject_request(conn, std::move(refusal));
+            return HttpParser::Status::ERROR;
+        }
+        if (max_body != 0) status = conn.parser.limit_body(max_body);
+    }
+    conn.parse_us += monotonic_us() - parse_start;
+    if (status == HttpParser::Status::ERROR) {
+        reject_request(conn, conn.parser.error_status(), conn.parser.error_reason());
+    } else if (status == HttpParser::Status::NEED_MORE) {
+        // Body bytes already copied into the request need not stay buffered
+        size_t released = conn.parser.release_consumed();
+        if (released > 0) conn.in_buf.erase(0, released);
+    }
+    return status;
+}
+
+void WebServer::process_request(EventLoop& loop, Connection& conn) {
+    HttpRequest request = conn.parser.take_request();
+    conn.in_buf.erase(0, conn.parser.consumed());
+    conn.parser.reset();
+    conn.continue_sent = false;
+    conn.head_screened = false;
+    conn.header_deadline = 0;
+    conn.state = ConnectionState::PROCESSING;
+    update_deadline(loop, conn);
+
+    RequestTrace trace;
+    trace.start_us = monotonic_us();
+    trace.add(RequestStage::PARSE, conn.parse_us);
+    conn.parse_us = 0;
+    requests_in_progress.fetch_add(1, std::memory_order_relaxed);
+
+    int fd = conn.fd;
+    uint64_t connection_id = conn.id;
+    bool last_allowed = ++conn.requests_served >= MAX_REQUESTS_PER_CONNECTION;
+    pool->submit([this, &loop, fd, connection_id, last_allowed, trace, request = std::move(request)]() mutable {
+        uint64_t handler_start = monotonic_us();
+        trace.add(RequestStage::QUEUE, handler_start - trace.start_us);
+        bool keep_alive = !last_allowed && wants_keep_alive(request);
+        bool chunked = request.version != "HTTP/1.0";
+        HttpResponse response = run_handler([&]() { return route_request(request, trace); });
+        trace.add(RequestStage::HANDLER, monotonic_us() - handler_start - trace.stage_us[(size_t)RequestStage::AUTH]);
+
+        // Password hashing continues on its own pool so a login storm cannot starve the editor routes
+        if (response.deferred) {
+            if (crypto_pool->pending() < (long)config.crypto_queue) {
+                uint64_t queued = monotonic_us();
+                crypto_pool->submit([this, &loop, fd, connection_id, keep_alive, chunked, trace, queued,
+                                     handler = std::move(response.deferred)]() mutable {
+                    uint64_t hashing_start = monotonic_us();
+                    trace.add(RequestStage::QUEUE, hashing_start - queued);
+                    HttpResponse deferred_response = run_handler(handler);
+                    trace.add(RequestStage::HANDLER, monotonic_us() - hashing_start);
+                    complete_request(loop, fd, connection_id, keep_alive, chunked, std::move(deferred_response),
+                                     trace);
+                });
+                return;
+            }
+            response = {503, "Service Unavailable", {{"Content-Type", "application/json"}, {"Retry-After", "1"}},
+                        "{\"success\": false, \"message\": \"Server busy, try again shortly\"}"};
+        }
+        complete_request(loop, fd, connection_id, keep_alive, chunked, std::move(response), trace);
+    });
+}
+
+void WebServer::complete_request(EventLoop& loop, int fd, uint64_t connection_id, bool keep_alive, bool chunked,
+                                 HttpResponse response, RequestTrace trace) {
+    // Without chunked encoding the end of a streamed body is marked by closing the connection
+    if (response.stream && !chunked) keep_alive = false;
+    if (shutdown_mode.load(std::memory_order_relaxed) != Shutdown::NONE) keep_alive = false;
+    response.headers["Connection"] = keep_alive ? "keep-alive" : "close";
+    trace.status = response.status_code;
+
+    uint64_t serialize_start = monotonic_us();
+    ResponseWriter writer(std::move(response), chunked);
+    trace.add(RequestStage::SERIALIZE, monotonic_us() - serialize_start);
+    requests_in_progress.fetch_sub(1, std::memory_order_relaxed);
+    post_completion(loop, {fd, connection_id, std::move(writer), keep_alive, trace});
+}
+
+void WebServer::produce_next_chunk(EventLoop& loop, Connection& conn) {
+    // The previous piece is fully sent; generate the next one off the loop thread
+    conn.state = ConnectionState::PROCESSING;
+    update_deadline(loop, conn);
+
+    int fd = conn.fd;
+    uint64_t connection_id = conn.id;
+    // A source that had nothing last time is parked until it has more,
+    // rather than polled from a worker; the writer keeps the producer
+    if (conn.writer.wait_for_more([this, &loop, fd, connection_id] {
+            post_completion(loop, {fd, connection_id, ResponseWriter(), false, {}, true});
+        })) {
+        return;
+    }
+
+    bool keep_alive = !conn.close_after_write;
+    bool chunked = conn.writer.is_chunked();
+    pool->submit([this, &loop, fd, connection_id, keep_alive, chunked, producer = conn.writer.take_producer(),
+                  wait = conn.writer.take_stream_wait()]() mutable {
+        std::string chunk;
+        bool more;
+        try {
+            more = producer(chunk);
+        } catch (const std::exception& e) {
+            // Headers are long gone; dropping the connection before the last chunk signals the failure
+            LOG_ERROR << "Stream producer failed: " << e.what();
+            post_completion(loop, {fd, connection_id, ResponseWriter(), false, {}});
+            return;
+        }
+        post_completion(loop, {fd, connection_id,
+                               ResponseWriter::chunk(std::move(chunk), more ? std::move(producer) : nullptr, chunked,
+                                                     std::move(wait)),
+                               keep_alive, {}});
+    });
+}
+
+void WebServer::post_completion(EventLoop& loop, Completion completion) {
+    {
+        std::lock_guard<std::mutex> lock(loop.completion_mutex);
+        loop.completions.push_back(std::move(completion));
+    }
+    uint64_t one = 1;
+    ssize_t ignored = write(loop.wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void WebServer::reject_request(Connection& conn, int status_code, const char* status_text) {
+    reject_request(conn, HttpResponse{status_code, status_text, {{"Content-Type", "text/plain"}}, status_text});
+}
+
+void WebServer::reject_request(Connection& conn, HttpResponse response) {
+    // Malformed, oversized or refused input: answer directly from the loop and drop the connection
+    response.headers["Connection"] = "close";
+    int status_code = response.status_code;
+    conn.in_buf.clear();
+    conn.writer = ResponseWriter(std::move(response));
+    conn.close_after_write = true;
+    conn.state = ConnectionState::WRITING;
+
+    conn.trace = RequestTrace();
+    conn.trace.start_us = conn.trace.send_start_us = monotonic_us();
+    conn.trace.route = {ROUTE_ID_INVALID, "other", "invalid"};
+    conn.trace.status = status_code;
+    conn.trace.add(RequestStage::PARSE, conn.parse_us);
+    conn.parse_us = 0;
+}
+
+void WebServer::finish_trace(Connection& conn) {
+    if (!conn.trace.active()) return;
+    uint64_t now = monotonic_us();
+    conn.trace.add(RequestStage::SEND, now - conn.trace.send_start_us);
+    metrics.record_request(conn.trace, now);
+    conn.trace = RequestTrace();
+}
+
+void WebServer::drain_completions(EventLoop& loop) {
+    uint64_t counter;
+    while (read(loop.wake_fd, &counter, sizeof(counter)) > 0) {}
+
+    std::vector<Completion> ready;
+    {
+        std::lock_guard<std::mutex> lock(loop.completion_mutex);
+        ready.swap(loop.completions);
+    }
+
+    for (Completion& completion : ready) {
+        auto it = loop.connections.find(completion.fd);
+        // The client may have gone away while its handler was running
+        if (it == loop.connections.end() || it->second->id != completion.connection_id) continue;
+
+        Connection& conn = *it->second;
+        if (completion.resume) {
+            // Only a stream still parked runs again; the writer holds its producer
+            if (conn.state == ConnectionState::PROCESSING && conn.writer.has_more()) produce_next_chunk(loop, conn);
+            continue;
+        }
+        if (completion.trace.active()) {
+            conn.trace = completion.trace;
+            conn.trace.send_start_us = monotonic_us();
+        }
+        conn.writer = std::move(completion.writer);
+        conn.close_after_write = !completion.keep_alive;
+        conn.state = ConnectionState::WRITING;
+        if (!handle_writable(loop, conn)) {
+            close_connection(loop, conn.fd);
+        }
+    }
+}
+
+void WebServer::update_deadline(EventLoop& loop, Connection& conn) {
+    const ConnectionLimits& limits = config.connection_limits;
+    switch (conn.state) {
+    case ConnectionState::PROCESSING:
+        // The handler's run time is not the client's fault
+        loop.timers.cancel(conn.timer);
+        break;
+    case ConnectionState::WRITING:
+        loop.timers.schedule(conn.timer, loop.now_ms + limits.write_timeout_ms);
+        break;
+    case ConnectionState::READING:
+        if (conn.parser.reading_body()) {
+            loop.timers.schedule(conn.timer, loop.now_ms + limits.body_timeout_ms);
+        } else if (conn.in_buf.empty()) {
+            uint32_t wait = conn.requests_served == 0 ? limits.header_timeout_ms : limits.idle_timeout_ms;
+            loop.timers.schedule(conn.timer, loop.now_ms + wait);
+        } else {
+            // Headers must complete by a fixed deadline however slowly they trickle in
+            if (conn.header_deadline == 0) conn.header_deadline = loop.now_ms + limits.header_timeout_ms;
+            loop.timers.schedule(conn.timer, conn.header_deadline);
+        }
+        break;
+    }
+}
+
+void WebServer::expire_connections(EventLoop& loop) {
+    std::vector<int> expired;
+    loop.timers.advance(loop.now_ms, [&](TimerNode& node) {
+        expired.push_back(static_cast<Connection*>(node.owner)->fd);
+    });
+
+    for (int fd : expired) {
+        auto it = loop.connections.find(fd);
+        if (it == loop.connections.end()) continue;
+        Connection& conn = *it->second;
+
+        // A partly received request gets a best-effort 408; idle and stalled writers are just dropped
+        if (conn.state == ConnectionState::READING && (!conn.in_buf.empty() || conn.parser.reading_body())) {
+            ResponseWriter timeout(HttpResponse{408, "Request Timeout",
+                                                {{"Content-Type", "text/plain"}, {"Connection", "close"}},
+                                                "Request Timeout"});
+            timeout.write_to(fd);
+        }
+        loop.connections_timed_out.fetch_add(1, std::memory_order_relaxed);
+        close_connection(loop, fd);
+    }
+}
+
+void WebServer::release_peer(const std::string& peer) {
+    connections_per_ip.upsert(peer, [](size_t& open_from_peer) {
+        return open_from_peer > 0 && --open_from_peer > 0;
+    });
+}
+
+void WebServer::close_connection(EventLoop& loop, int fd) {
+    auto it = loop.connections.find(fd);
+    if (it != loop.connections.end()) {
+        loop.timers.cancel(it->second->timer);
+        release_peer(it->second->peer);
+        loop.connections_closed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Closing the descriptor removes it from the epoll set
+    close(fd);
+    loop.connections.erase(fd);
+}
+
+// Global function
+void start_server(const ServerConfig& config, char** argv) {
+    logging::configure(config.log_level, config.log_format);
+    try {
+        g_server = new WebServer(config);
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Failed to start server: " << e.what();
+        exit(1);
+    }
+    bool restart = g_server->start();
+    std::vector<int> listeners;
+    if (restart) {
+        listeners = g_server->release_listeners();
+    }
+    // Teardown flushes the stores and writes the session snapshot the next process restores
+    delete g_server;
+    g_server = nullptr;
+    if (!restart) return;
+
+    std::string fds;
+    for (int fd : listeners) {
+        fds += (fds.empty() ? "" : ",") + std::to_string(fd);
+    }
+    setenv("WEBEDITOR_LISTEN_FDS", fds.c_str(), 1);
+    LOG_INFO << "Re-executing " << argv[0] << " for warm restart";
+    // argv[0] rather than /proc/self/exe, so a binary replaced on disk takes effect
+    // exec discards the rings, so write them out first
+    logging::flush();
+    execvp(argv[0], argv);
+    LOG_ERROR << "Warm restart failed: " << strerror(errno);
+    exit(1);
+}
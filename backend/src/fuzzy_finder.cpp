@@ -0,0 +1,279 @@
+//fuzzy_finder.cpp
+#include "../include/fuzzy_finder.hpp"
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+
+// Scores, as fzf assigns them
+const int SCORE_MATCH = 16;
+const int SCORE_GAP_START = -3;
+const int SCORE_GAP_EXTENSION = -1;
+const int BONUS_BOUNDARY = SCORE_MATCH / 2;
+const int BONUS_BOUNDARY_WHITE = BONUS_BOUNDARY + 2;
+const int BONUS_BOUNDARY_DELIMITER = BONUS_BOUNDARY + 1;
+const int BONUS_NON_WORD = SCORE_MATCH / 2;
+const int BONUS_CAMEL = BONUS_BOUNDARY + SCORE_GAP_EXTENSION;
+const int BONUS_CONSECUTIVE = -(SCORE_GAP_START + SCORE_GAP_EXTENSION);
+const int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+// Whole match within the last path segment
+const int BONUS_FILE_NAME = SCORE_MATCH;
+
+enum class CharClass { WHITE, NON_WORD, DELIMITER, LOWER, UPPER, NUMBER };
+
+CharClass char_class(char c) {
+    if (c >= 'a' && c <= 'z') return CharClass::LOWER;
+    if (c >= 'A' && c <= 'Z') return CharClass::UPPER;
+    if (c >= '0' && c <= '9') return CharClass::NUMBER;
+    if ((unsigned char)c >= 0x80) return CharClass::LOWER;  // Part of a UTF-8 sequence
+    if (c == '/') return CharClass::DELIMITER;
+    if (c == ' ' || c == '\t') return CharClass::WHITE;
+    return CharClass::NON_WORD;
+}
+
+bool is_word(CharClass c) {
+    return c == CharClass::LOWER || c == CharClass::UPPER || c == CharClass::NUMBER;
+}
+
+// Bonus for matching a character of class current that follows one of class previous
+int boundary_bonus(CharClass previous, CharClass current) {
+    if (is_word(current)) {
+        switch (previous) {
+        case CharClass::WHITE: return BONUS_BOUNDARY_WHITE;
+        case CharClass::DELIMITER: return BONUS_BOUNDARY_DELIMITER;
+        case CharClass::NON_WORD: return BONUS_BOUNDARY;
+        default: break;
+        }
+    }
+    if ((previous == CharClass::LOWER && current == CharClass::UPPER) ||
+        (previous != CharClass::NUMBER && current == CharClass::NUMBER)) {
+        return BONUS_CAMEL;
+    }
+    if (current == CharClass::NON_WORD || current == CharClass::DELIMITER) return BONUS_NON_WORD;
+    if (current == CharClass::WHITE) return BONUS_BOUNDARY_WHITE;
+    return 0;
+}
+
+// char_class() of every byte and boundary_bonus() of every pair, looked up while scoring
+struct ScoringTables {
+    CharClass classes[256];
+    int bonus[6][6];
+};
+
+const ScoringTables& scoring_tables() {
+    static const ScoringTables tables = [] {
+        ScoringTables built;
+        for (int c = 0; c < 256; c++) {
+            built.classes[c] = char_class((char)c);
+        }
+        for (int previous = 0; previous < 6; previous++) {
+            for (int current = 0; current < 6; current++) {
+                built.bonus[previous][current] = boundary_bonus((CharClass)previous, (CharClass)current);
+            }
+        }
+        return built;
+    }();
+    return tables;
+}
+
+inline char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c;
+}
+
+int char_bit(char c) {
+    c = lower(c);
+    if (c >= 'a' && c <= 'z') return c - 'a';
+    if (c >= '0' && c <= '9') return 26 + (c - '0');
+    return 36 + (unsigned char)c % 28;
+}
+
+// Better first: score, then the shorter path, then by path
+bool better(const PathList& list, const FuzzyMatch& a, const FuzzyMatch& b) {
+    if (a.score != b.score) return a.score > b.score;
+    std::string_view path_a = list.path(a.index), path_b = list.path(b.index);
+    if (path_a.size() != path_b.size()) return path_a.size() < path_b.size();
+    return path_a < path_b;
+}
+
+void walk(const std::string& root, const std::string& relative, PathList& list, std::vector<FileStamp>* stamps) {
+    DIR* dir = opendir(relative.empty() ? root.c_str() : (root + "/" + relative).c_str());
+    if (!dir) return;
+    int dir_fd = dirfd(dir);
+    while (dirent* d = readdir(dir)) {
+        if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+        bool real_directory = d->d_type == DT_DIR;
+        bool is_directory = real_directory;
+        struct stat st;
+        if (stamps || d->d_type == DT_LNK || d->d_type == DT_UNKNOWN) {
+            if (fstatat(dir_fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+            real_directory = S_ISDIR(st.st_mode);
+            // A dangling symlink is still listed, as itself
+            if (S_ISLNK(st.st_mode)) fstatat(dir_fd, d->d_name, &st, 0);
+            is_directory = S_ISDIR(st.st_mode);
+        }
+        std::string path = relative.empty() ? d->d_name : relative + "/" + d->d_name;
+        list.add(path, is_directory);
+        if (stamps) {
+            stamps->push_back({S_ISREG(st.st_mode) ? (uint64_t)st.st_size : 0,
+                               (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec});
+        }
+        if (real_directory) walk(root, path, list, stamps);
+    }
+    closedir(dir);
+}
+
+// Score query as a subsequence of text, given lowered, its lowercase copy,
+// in the manner of fzf's first algorithm: the leftmost match, narrowed from
+// its end to the shortest window, earns points per character with bonuses
+// for matching at word, path segment and camelCase boundaries and for runs,
+// and penalties for gaps. Matches inside the file name score above ones
+// spread over directories. query must be lowercase. False if it does not match.
+bool score_match(std::string_view query, std::string_view lowered, std::string_view text, int& score,
+                 std::vector<uint32_t>* positions) {
+    if (query.empty()) return false;
+
+    // Leftmost match of the whole query...
+    const char* first = (const char*)memchr(lowered.data(), query[0], lowered.size());
+    if (!first) return false;
+    size_t matched = 1, end = first - lowered.data() + 1;
+    for (size_t i = end; matched < query.size() && i < lowered.size(); i++) {
+        if (lowered[i] == query[matched]) {
+            matched++;
+            end = i + 1;
+        }
+    }
+    if (matched < query.size()) return false;
+
+    // ...then walked back from its end to the shortest window holding it
+    size_t start = end;
+    for (size_t remaining = query.size(); remaining > 0;) {
+        start--;
+        if (lowered[start] == query[remaining - 1]) remaining--;
+    }
+
+    score = 0;
+    if (positions) positions->clear();
+    const ScoringTables& tables = scoring_tables();
+    int consecutive = 0, first_bonus = 0;
+    bool in_gap = false;
+    size_t next = 0;
+    for (size_t i = start; i < end; i++) {
+        if (next < query.size() && lowered[i] == query[next]) {
+            CharClass previous = i > 0 ? tables.classes[(unsigned char)text[i - 1]] : CharClass::DELIMITER;
+            CharClass current = tables.classes[(unsigned char)text[i]];
+            int bonus = tables.bonus[(int)previous][(int)current];
+            if (consecutive == 0) {
+                first_bonus = bonus;
+            } else {
+                // A run keeps the bonus of the boundary that started it
+                if (bonus >= BONUS_BOUNDARY && bonus > first_bonus) first_bonus = bonus;
+                bonus = std::max({bonus, first_bonus, BONUS_CONSECUTIVE});
+            }
+            score += SCORE_MATCH + (next == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus);
+            if (positions) positions->push_back((uint32_t)i);
+            consecutive++;
+            in_gap = false;
+            next++;
+        } else {
+            score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+            in_gap = true;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+    }
+
+    if (!memchr(lowered.data() + start, '/', lowered.size() - start)) score += BONUS_FILE_NAME;
+    return true;
+}
+
+} // namespace
+
+void PathList::add(std::string_view path, bool is_directory) {
+    paths.append(path);
+    for (char c : path) {
+        lowered += lower(c);
+    }
+    offsets.push_back((uint32_t)paths.size());
+    masks.push_back(fuzzy_char_mask(path));
+    directories.push_back(is_directory ? 1 : 0);
+}
+
+void PathList::clear() {
+    paths.clear();
+    lowered.clear();
+    offsets.assign(1, 0);
+    masks.clear();
+    directories.clear();
+}
+
+size_t PathList::memory_used() const {
+    return paths.capacity() + lowered.capacity() + offsets.capacity() * sizeof(uint32_t) + masks.capacity() * sizeof(uint64_t) +
+           directories.capacity();
+}
+
+uint64_t fuzzy_char_mask(std::string_view text) {
+    uint64_t mask = 0;
+    for (char c : text) {
+        mask |= 1ull << char_bit(c);
+    }
+    return mask;
+}
+
+size_t fuzzy_find(const PathList& list, std::string_view query, size_t limit, std::vector<FuzzyMatch>& matches) {
+    matches.clear();
+    std::string needle;
+    for (char c : query) {
+        if (c != ' ' && c != '\t') needle += lower(c);
+    }
+    if (needle.empty() || limit == 0) return 0;
+    uint64_t required = fuzzy_char_mask(needle);
+
+    // matches is kept as a heap ordered by better(), which puts the worst kept match on top
+    auto heap_order = [&](const FuzzyMatch& a, const FuzzyMatch& b) { return better(list, a, b); };
+    size_t total = 0;
+    FuzzyMatch candidate{0, 0, {}};
+    const uint64_t* masks = list.masks_data();
+    for (size_t base = 0; base < list.size(); base += 64) {
+        // Branch-free mask test of 64 paths into a bit set; only the survivors are read and scored
+        size_t count = std::min<size_t>(64, list.size() - base);
+        uint64_t hits = 0;
+        for (size_t j = 0; j < count; j++) {
+            hits |= (uint64_t)((masks[base + j] & required) == required) << j;
+        }
+        while (hits) {
+            candidate.index = (uint32_t)(base + __builtin_ctzll(hits));
+            hits &= hits - 1;
+            if (!score_match(needle, list.lowered_path(candidate.index), list.path(candidate.index), candidate.score,
+                             nullptr)) {
+                continue;
+            }
+            total++;
+            if (matches.size() < limit) {
+                matches.push_back(candidate);
+                std::push_heap(matches.begin(), matches.end(), heap_order);
+            } else if (better(list, candidate, matches.front())) {
+                std::pop_heap(matches.begin(), matches.end(), heap_order);
+                matches.back() = candidate;
+                std::push_heap(matches.begin(), matches.end(), heap_order);
+            }
+        }
+    }
+
+    std::sort_heap(matches.begin(), matches.end(), heap_order);
+    for (FuzzyMatch& match : matches) {
+        score_match(needle, list.lowered_path(match.index), list.path(match.index), match.score, &match.positions);
+    }
+    return total;
+}
+
+bool list_paths(const std::string& root, PathList& list, std::vector<FileStamp>* stamps) {
+    list.clear();
+    if (stamps) stamps->clear();
+    struct stat st;
+    if (stat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+    walk(root, "", list, stamps);
+    return true;
+}
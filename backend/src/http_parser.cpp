@@ -0,0 +1,334 @@
+//http_parser.cpp
+#include "../include/http_parser.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const size_t MAX_CHUNK_LINE = 1024;
+// Most a declared Content-Length reserves before any body byte arrives
+const size_t MAX_BODY_RESERVE = 64 * 1024;
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string_view trim(std::string_view str) {
+    size_t start = 0;
+    while (start < str.size() && (str[start] == ' ' || str[start] == '\t')) start++;
+    size_t end = str.size();
+    while (end > start && (str[end - 1] == ' ' || str[end - 1] == '\t')) end--;
+    return str.substr(start, end - start);
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+} // namespace
+
+std::string percent_decode(std::string_view str) {
+    std::string result;
+    result.reserve(str.size());
+    for (size_t i = 0; i < str.size(); i++) {
+        char c = str[i];
+        if (c == '%' && i + 2 < str.size()) {
+            int high = hex_value(str[i + 1]);
+            int low = hex_value(str[i + 2]);
+            if (high >= 0 && low >= 0) {
+                result += (char)(high * 16 + low);
+                i += 2;
+                continue;
+            }
+        }
+        result += (c == '+') ? ' ' : c;
+    }
+    return result;
+}
+
+std::string_view cookie_value(std::string_view header, std::string_view name) {
+    // cookie-string = cookie-pair *( ";" SP cookie-pair ), tolerating extra whitespace
+    size_t pos = 0;
+    while (pos < header.size()) {
+        while (pos < header.size() && (header[pos] == ' ' || header[pos] == '\t')) pos++;
+        size_t end = header.find(';', pos);
+        if (end == std::string_view::npos) end = header.size();
+
+        std::string_view pair = header.substr(pos, end - pos);
+        if (pair.size() > name.size() && pair[name.size()] == '=' && pair.compare(0, name.size(), name) == 0) {
+            std::string_view value = pair.substr(name.size() + 1);
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+            if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+                value = value.substr(1, value.size() - 2);
+            }
+            return value;
+        }
+        pos = end + 1;
+    }
+    return {};
+}
+
+HttpParser::HttpParser(const HttpLimits& limits) : limits(limits) {
+    reset();
+}
+
+void HttpParser::reset() {
+    state = State::REQUEST_LINE;
+    request = HttpRequest();
+    pos = 0;
+    scan = 0;
+    header_count = 0;
+    body_remaining = 0;
+    body_limit = limits.max_body_size;
+    error_code = 0;
+    error_text = "";
+}
+
+HttpRequest HttpParser::take_request() {
+    return std::move(request);
+}
+
+bool HttpParser::expects_continue() const {
+    if (state != State::BODY && state != State::CHUNK_SIZE) return false;
+    auto it = request.headers.find("Expect");
+    return it != request.headers.end() && iequals(it->second, "100-continue");
+}
+
+bool HttpParser::reading_body() const {
+    return state == State::BODY || state == State::CHUNK_SIZE || state == State::CHUNK_DATA ||
+           state == State::CHUNK_DATA_END || state == State::CHUNK_TRAILERS;
+}
+
+HttpParser::Status HttpParser::limit_body(size_t max_body) {
+    if (state == State::ERROR) return Status::ERROR;
+    body_limit = std::min(body_limit, max_body);
+    // A Content-Length is known in full; chunked bodies are checked chunk by chunk
+    size_t declared = request.body.size();
+    if (state == State::BODY || state == State::CHUNK_DATA) declared += body_remaining;
+    if (declared > body_limit) return fail(413, "Payload Too Large");
+    return state == State::COMPLETE ? Status::COMPLETE : Status::NEED_MORE;
+}
+
+size_t HttpParser::release_consumed() {
+    if (state == State::REQUEST_LINE || state == State::HEADERS ||
+        state == State::COMPLETE || state == State::ERROR) {
+        return 0;
+    }
+    size_t released = pos;
+    pos = 0;
+    scan = 0;
+    return released;
+}
+
+HttpParser::Status HttpParser::fail(int code, const char* reason) {
+    state = State::ERROR;
+    error_code = code;
+    error_text = reason;
+    return Status::ERROR;
+}
+
+// Extract the next LF-terminated line (CR stripped) without rescanning bytes seen before
+bool HttpParser::next_line(std::string_view data, std::string_view& line) {
+    size_t from = std::max(scan, pos);
+    const void* newline = from < data.size() ? memchr(data.data() + from, '\n', data.size() - from) : nullptr;
+    if (!newline) {
+        scan = data.size();
+        return false;
+    }
+
+    size_t end = (const char*)newline - data.data();
+    line = data.substr(pos, end - pos);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    pos = end + 1;
+    scan = pos;
+    return true;
+}
+
+HttpParser::Status HttpParser::parse(std::string_view data) {
+    std::string_view line;
+    while (true) {
+        switch (state) {
+        case State::REQUEST_LINE:
+            if (!next_line(data, line)) {
+                if (data.size() > limits.max_header_size) return fail(414, "URI Too Long");
+                return Status::NEED_MORE;
+            }
+            if (line.empty()) continue; // Tolerate stray CRLF between pipelined requests
+            if (parse_request_line(line) == Status::ERROR) return Status::ERROR;
+            state = State::HEADERS;
+            break;
+
+        case State::HEADERS:
+            if (!next_line(data, line)) {
+                if (data.size() > limits.max_header_size) return fail(431, "Request Header Fields Too Large");
+                return Status::NEED_MORE;
+            }
+            if (pos > limits.max_header_size) return fail(431, "Request Header Fields Too Large");
+            if (line.empty()) {
+                if (finish_headers() == Status::ERROR) return Status::ERROR;
+            } else if (parse_header_line(line) == Status::ERROR) {
+                return Status::ERROR;
+            }
+            break;
+
+        case State::BODY:
+        case State::CHUNK_DATA: {
+            size_t take = std::min(data.size() - pos, body_remaining);
+            request.body.append(data.data() + pos, take);
+            pos += take;
+            body_remaining -= take;
+            if (body_remaining > 0) return Status::NEED_MORE;
+            state = (state == State::BODY) ? State::COMPLETE : State::CHUNK_DATA_END;
+            break;
+        }
+
+        case State::CHUNK_SIZE: {
+            if (!next_line(data, line)) {
+                if (data.size() - pos > MAX_CHUNK_LINE) return fail(400, "Bad Request");
+                return Status::NEED_MORE;
+            }
+            size_t size = 0;
+            size_t digits = 0;
+            for (; digits < line.size(); digits++) {
+                int value = hex_value(line[digits]);
+                if (value < 0) break;
+                if (size > (body_limit >> 4)) return fail(413, "Payload Too Large");
+                size = size * 16 + value;
+            }
+            if (digits == 0) return fail(400, "Bad Request");
+            // Only whitespace and chunk extensions may follow the size; reading
+            // "5zz" as 5 would frame the body differently from a stricter proxy
+            std::string_view rest = trim(line.substr(digits));
+            if (!rest.empty() && rest[0] != ';') return fail(400, "Bad Request");
+            if (size == 0) {
+                state = State::CHUNK_TRAILERS;
+                break;
+            }
+            if (request.body.size() + size > body_limit) return fail(413, "Payload Too Large");
+            body_remaining = size;
+            state = State::CHUNK_DATA;
+            break;
+        }
+
+        case State::CHUNK_DATA_END:
+            if (!next_line(data, line)) return Status::NEED_MORE;
+            if (!line.empty()) return fail(400, "Bad Request");
+            state = State::CHUNK_SIZE;
+            break;
+
+        case State::CHUNK_TRAILERS:
+            if (!next_line(data, line)) {
+                if (data.size() - pos > limits.max_header_size) return fail(431, "Request Header Fields Too Large");
+                return Status::NEED_MORE;
+            }
+            // Trailer fields are accepted but not merged into the headers
+            if (line.empty()) state = State::COMPLETE;
+            else if (++header_count > limits.max_header_count) return fail(431, "Request Header Fields Too Large");
+            break;
+
+        case State::COMPLETE:
+            return Status::COMPLETE;
+
+        case State::ERROR:
+            return Status::ERROR;
+        }
+    }
+}
+
+HttpParser::Status HttpParser::parse_request_line(std::string_view line) {
+    size_t first_space = line.find(' ');
+    size_t last_space = line.rfind(' ');
+    if (first_space == std::string_view::npos || first_space == 0 || last_space == first_space) {
+        return fail(400, "Bad Request");
+    }
+
+    std::string_view method = line.substr(0, first_space);
+    std::string_view target = trim(line.substr(first_space + 1, last_space - first_space - 1));
+    std::string_view version = line.substr(last_space + 1);
+    if (target.empty()) return fail(400, "Bad Request");
+    if (version.substr(0, 7) != "HTTP/1.") return fail(505, "HTTP Version Not Supported");
+
+    request.method.assign(method);
+    request.version.assign(version);
+    parse_target(target);
+    return Status::NEED_MORE;
+}
+
+void HttpParser::parse_target(std::string_view target) {
+    size_t query_pos = target.find('?');
+    request.path.assign(target.substr(0, query_pos));
+    if (query_pos == std::string_view::npos) return;
+
+    std::string_view query = target.substr(query_pos + 1);
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view param = query.substr(0, amp);
+        size_t equal_pos = param.find('=');
+        if (equal_pos != std::string_view::npos) {
+            request.query_params[percent_decode(param.substr(0, equal_pos))] = percent_decode(param.substr(equal_pos + 1));
+        }
+        if (amp == std::string_view::npos) break;
+        query.remove_prefix(amp + 1);
+    }
+}
+
+HttpParser::Status HttpParser::parse_header_line(std::string_view line) {
+    // Obsolete line folding is rejected (RFC 9112 section 5.2)
+    if (line[0] == ' ' || line[0] == '\t') return fail(400, "Bad Request");
+    if (++header_count > limits.max_header_count) return fail(431, "Request Header Fields Too Large");
+
+    size_t colon_pos = line.find(':');
+    if (colon_pos == std::string_view::npos || colon_pos == 0) return fail(400, "Bad Request");
+
+    std::string_view name = line.substr(0, colon_pos);
+    if (name.back() == ' ' || name.back() == '\t') return fail(400, "Bad Request");
+
+    std::string value(trim(line.substr(colon_pos + 1)));
+    auto existing = request.headers.find(std::string(name));
+    if (existing != request.headers.end()) {
+        // Repeated framing headers let a proxy and this server disagree on
+        // where the body ends; only an identical Content-Length is harmless
+        if (iequals(name, "Transfer-Encoding") || (iequals(name, "Content-Length") && existing->second != value)) {
+            return fail(400, "Bad Request");
+        }
+    }
+    request.headers[std::string(name)] = std::move(value);
+    return Status::NEED_MORE;
+}
+
+HttpParser::Status HttpParser::finish_headers() {
+    auto te_it = request.headers.find("Transfer-Encoding");
+    if (te_it != request.headers.end()) {
+        // Both framings at once is a smuggling attempt, which RFC 9112
+        // section 6.1 allows rejecting outright. Only plain chunked is
+        // supported: a list such as "gzip, chunked" would need decoding.
+        if (request.headers.count("Content-Length")) return fail(400, "Bad Request");
+        if (!iequals(te_it->second, "chunked")) return fail(501, "Not Implemented");
+        state = State::CHUNK_SIZE;
+        return Status::NEED_MORE;
+    }
+
+    auto cl_it = request.headers.find("Content-Length");
+    if (cl_it == request.headers.end()) {
+        state = State::COMPLETE;
+        return Status::NEED_MORE;
+    }
+
+    const std::string& value = cl_it->second;
+    if (value.empty() || value.size() > 19 ||
+        !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        return fail(400, "Bad Request");
+    }
+    size_t length = std::stoull(value);
+    if (length > body_limit) return fail(413, "Payload Too Large");
+
+    body_remaining = length;
+    // The header alone is not trusted with a large allocation; the body
+    // grows as its bytes arrive
+    request.body.reserve(std::min(length, MAX_BODY_RESERVE));
+    state = (length == 0) ? State::COMPLETE : State::BODY;
+    return Status::NEED_MORE;
+}
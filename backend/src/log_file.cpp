@@ -0,0 +1,107 @@
+//log_file.cpp
+#include "../include/log_file.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace log_file {
+
+std::string begin_record() {
+    return std::string(RECORD_HEADER_SIZE, '\0');
+}
+
+void finish_record(std::string& record) {
+    uint32_t length = (uint32_t)(record.size() - RECORD_HEADER_SIZE);
+    uint32_t crc = (uint32_t)crc32(0, reinterpret_cast<const Bytef*>(record.data()) + RECORD_HEADER_SIZE, length);
+    memcpy(&record[0], &length, 4);
+    memcpy(&record[4], &crc, 4);
+}
+
+void put_u8(std::string& out, uint8_t value) {
+    out += (char)value;
+}
+
+void put_u32(std::string& out, uint32_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_i64(std::string& out, int64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_string(std::string& out, const std::string& value) {
+    put_u32(out, (uint32_t)value.size());
+    out += value;
+}
+
+bool Reader::read_bytes(void* out, size_t length) {
+    if (length > size - position) return false;
+    memcpy(out, data + position, length);
+    position += length;
+    return true;
+}
+
+bool Reader::read_string(std::string& out) {
+    uint32_t length;
+    if (!read_u32(length) || length > size - position) return false;
+    out.assign(data + position, length);
+    position += length;
+    return true;
+}
+
+bool read_record(int fd, uint64_t offset, std::string& payload, uint32_t& length) {
+    uint32_t record_header[2];
+    if (!read_all(fd, reinterpret_cast<char*>(record_header), sizeof(record_header), offset)) return false;
+    uint32_t payload_length = record_header[0];
+    if (payload_length == 0 || payload_length > MAX_RECORD_SIZE) return false;
+
+    payload.resize(payload_length);
+    if (!read_all(fd, &payload[0], payload_length, offset + RECORD_HEADER_SIZE)) return false;
+    if ((uint32_t)crc32(0, reinterpret_cast<const Bytef*>(payload.data()), payload_length) != record_header[1]) {
+        return false;
+    }
+    length = RECORD_HEADER_SIZE + payload_length;
+    return true;
+}
+
+bool write_all(int fd, const char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool read_all(int fd, char* data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t got = pread(fd, data, length, (off_t)offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        length -= got;
+        offset += got;
+    }
+    return true;
+}
+
+uint64_t file_size(int fd) {
+    struct stat info;
+    return fstat(fd, &info) == 0 ? (uint64_t)info.st_size : 0;
+}
+
+void sync_directory(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+} // namespace log_file
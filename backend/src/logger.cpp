@@ -0,0 +1,416 @@
+//logger.cpp
+#include "../include/logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace logging {
+std::atomic<int> runtime_level{(int)LogLevel::INFO};
+}
+
+namespace {
+
+const size_t RING_CAPACITY = 1 << 18;    // Per thread; a power of two
+const size_t RECORD_ALIGN = 32;          // At least a header, so one always fits before the wrap
+const int FLUSH_INTERVAL_MS = 20;
+
+// Ring layout: RecordHeader, message, fields as [u16 key length][key]
+// [u16 value length][value], padded to RECORD_ALIGN. A header with
+// level PADDING fills the gap left before the wrap point.
+const uint8_t PADDING = 0xff;
+
+struct RecordHeader {
+    uint32_t size;            // Whole record including padding
+    uint8_t level;
+    uint8_t reserved;
+    uint16_t field_count;
+    uint32_t message_length;
+    uint32_t fields_length;
+    int64_t timestamp_us;
+};
+static_assert(sizeof(RecordHeader) <= RECORD_ALIGN, "padding header must fit in any gap");
+
+struct Ring {
+    alignas(64) std::atomic<uint64_t> head{0};  // Written by the owning thread
+    alignas(64) std::atomic<uint64_t> tail{0};  // Written by the flusher
+    std::atomic<bool> abandoned{false};         // Owning thread has exited
+    unsigned thread_number = 0;
+    std::unique_ptr<char[]> data{new char[RING_CAPACITY]};
+};
+
+struct Entry {
+    int64_t timestamp_us;
+    unsigned thread_number;
+    uint8_t level;
+    uint16_t field_count;
+    std::string message;
+    std::string fields;
+};
+
+class Logger {
+public:
+    Logger() : flusher([this] { run(); }) {}
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        flusher.join();
+        drain();
+    }
+
+    std::shared_ptr<Ring> register_ring() {
+        auto ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(mutex);
+        ring->thread_number = ++thread_count;
+        rings.push_back(ring);
+        return ring;
+    }
+
+    void push(Ring& ring, LogLevel level, const char* data, uint32_t message_length, uint32_t length,
+              uint32_t field_count) {
+        size_t total = (sizeof(RecordHeader) + length + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        uint64_t tail = ring.tail.load(std::memory_order_acquire);
+        size_t offset = head & (RING_CAPACITY - 1);
+        size_t contiguous = RING_CAPACITY - offset;
+        size_t needed = total + (contiguous < total ? contiguous : 0);
+        if (head + needed - tail > RING_CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            wake.notify_one();
+            return;
+        }
+
+        if (contiguous < total) {
+            RecordHeader padding = {};
+            padding.size = (uint32_t)contiguous;
+            padding.level = PADDING;
+            memcpy(ring.data.get() + offset, &padding, sizeof(padding));
+            head += contiguous;
+            offset = 0;
+        }
+
+        RecordHeader header = {};
+        header.size = (uint32_t)total;
+        header.level = (uint8_t)level;
+        header.field_count = (uint16_t)field_count;
+        header.message_length = message_length;
+        header.fields_length = length - message_length;
+        header.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::system_clock::now().time_since_epoch()).count();
+        memcpy(ring.data.get() + offset, &header, sizeof(header));
+        memcpy(ring.data.get() + offset + sizeof(header), data, length);
+        ring.head.store(head + total, std::memory_order_release);
+
+        // Don't wait for the next tick when the ring is filling up
+        if (head + total - tail > RING_CAPACITY / 2) wake.notify_one();
+    }
+
+    void configure(LogFormat new_format) {
+        std::lock_guard<std::mutex> lock(mutex);
+        format = new_format;
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t ticket = ++flush_requested;
+        wake.notify_all();
+        flushed.wait(lock, [&] { return flush_completed >= ticket || stopping; });
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+            uint64_t ticket = flush_requested;
+            lock.unlock();
+            drain();
+            lock.lock();
+            flush_completed = ticket;
+            flushed.notify_all();
+        }
+    }
+
+    // Take everything the rings hold and write it out, oldest first
+    void drain() {
+        std::vector<std::shared_ptr<Ring>> snapshot;
+        LogFormat current_format;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            snapshot = rings;
+            current_format = format;
+        }
+
+        std::vector<Entry> entries;
+        for (const auto& ring : snapshot) {
+            bool abandoned = ring->abandoned.load(std::memory_order_acquire);
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            while (tail < head) {
+                const char* record = ring->data.get() + (tail & (RING_CAPACITY - 1));
+                RecordHeader header;
+                memcpy(&header, record, sizeof(header));
+                if (header.level != PADDING) {
+                    const char* body = record + sizeof(header);
+                    entries.push_back({header.timestamp_us, ring->thread_number, header.level, header.field_count,
+                                       std::string(body, header.message_length),
+                                       std::string(body + header.message_length, header.fields_length)});
+                }
+                tail += header.size;
+            }
+            ring->tail.store(tail, std::memory_order_release);
+            if (abandoned) {
+                std::lock_guard<std::mutex> lock(mutex);
+                rings.erase(std::remove(rings.begin(), rings.end(), ring), rings.end());
+            }
+        }
+
+        uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::system_clock::now().time_since_epoch()).count();
+            entries.push_back({now_us, 0, (uint8_t)LogLevel::WARN, 0,
+                               "Log buffer full, dropped " + std::to_string(lost) + " messages", ""});
+        }
+        if (entries.empty()) return;
+
+        // Each ring is in order already; merge them into one timeline
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry& a, const Entry& b) { return a.timestamp_us < b.timestamp_us; });
+        std::string out;
+        for (const auto& entry : entries) {
+            format_entry(out, entry, current_format);
+        }
+        write_out(out);
+    }
+
+    static void format_entry(std::string& out, const Entry& entry, LogFormat format) {
+        static const char* const LEVEL_NAMES[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+        const char* level_name = entry.level < 4 ? LEVEL_NAMES[entry.level] : "INFO";
+
+        char time_buffer[40];
+        time_t seconds = (time_t)(entry.timestamp_us / 1000000);
+        tm utc;
+        gmtime_r(&seconds, &utc);
+        size_t time_length = strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+        snprintf(time_buffer + time_length, sizeof(time_buffer) - time_length, ".%06dZ",
+                 (int)(entry.timestamp_us % 1000000));
+
+        if (format == LogFormat::JSON) {
+            out += "{\"ts\":\"";
+            out += time_buffer;
+            out += "\",\"level\":\"";
+            out += level_name;
+            out += "\",\"thread\":";
+            out += std::to_string(entry.thread_number);
+            out += ",\"msg\":";
+            append_json_string(out, entry.message);
+            for_each_field(entry, [&](std::string_view key, std::string_view value) {
+                out += ',';
+                append_json_string(out, key);
+                out += ':';
+                append_json_string(out, value);
+            });
+            out += "}\n";
+        } else {
+            out += time_buffer;
+            out += ' ';
+            out += level_name;
+            out.append(6 - strlen(level_name), ' ');
+            out += "[t";
+            out += std::to_string(entry.thread_number);
+            out += "] ";
+            out += entry.message;
+            for_each_field(entry, [&](std::string_view key, std::string_view value) {
+                out += ' ';
+                out += key;
+                out += '=';
+                out += value;
+            });
+            out += '\n';
+        }
+    }
+
+    template <typename F>
+    static void for_each_field(const Entry& entry, F&& fn) {
+        const char* data = entry.fields.data();
+        size_t size = entry.fields.size();
+        size_t position = 0;
+        for (uint16_t i = 0; i < entry.field_count; i++) {
+            std::string_view parts[2];
+            for (auto& part : parts) {
+                uint16_t part_length;
+                if (size - position < sizeof(part_length)) return;
+                memcpy(&part_length, data + position, sizeof(part_length));
+                position += sizeof(part_length);
+                if (size - position < part_length) return;
+                part = std::string_view(data + position, part_length);
+                position += part_length;
+            }
+            fn(parts[0], parts[1]);
+        }
+    }
+
+    static void append_json_string(std::string& out, std::string_view value) {
+        out += '"';
+        for (unsigned char c : value) {
+            switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    out += escape;
+                } else {
+                    out += (char)c;
+                }
+            }
+        }
+        out += '"';
+    }
+
+    static void write_out(const std::string& out) {
+        size_t written = 0;
+        while (written < out.size()) {
+            ssize_t result = ::write(STDOUT_FILENO, out.data() + written, out.size() - written);
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            written += (size_t)result;
+        }
+    }
+
+    std::mutex mutex;  // Guards rings, format and the flush counters
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<std::shared_ptr<Ring>> rings;
+    unsigned thread_count = 0;
+    LogFormat format = LogFormat::TEXT;
+    uint64_t flush_requested = 0;
+    uint64_t flush_completed = 0;
+    bool stopping = false;
+    std::atomic<uint64_t> dropped{0};
+    std::thread flusher;  // Last, so it starts after everything it uses
+};
+
+Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+// Registers the thread's ring on first use and hands it back to the
+// flusher, which frees it once drained, when the thread exits
+struct ThreadRing {
+    std::shared_ptr<Ring> ring = logger().register_ring();
+    ~ThreadRing() { ring->abandoned.store(true, std::memory_order_release); }
+};
+
+Ring& thread_ring() {
+    thread_local ThreadRing holder;
+    return *holder.ring;
+}
+
+} // namespace
+
+namespace logging {
+
+void configure(LogLevel level, LogFormat format) {
+    runtime_level.store((int)level, std::memory_order_relaxed);
+    logger().configure(format);
+}
+
+void flush() {
+    logger().flush();
+}
+
+bool parse_level(const std::string& name, LogLevel& level) {
+    if (name == "debug") level = LogLevel::DEBUG;
+    else if (name == "info") level = LogLevel::INFO;
+    else if (name == "warn") level = LogLevel::WARN;
+    else if (name == "error") level = LogLevel::ERROR;
+    else return false;
+    return true;
+}
+
+bool parse_format(const std::string& name, LogFormat& format) {
+    if (name == "text") format = LogFormat::TEXT;
+    else if (name == "json") format = LogFormat::JSON;
+    else return false;
+    return true;
+}
+
+} // namespace logging
+
+LogLine::~LogLine() {
+    Logger& instance = logger();
+    instance.push(thread_ring(), level, buffer, in_fields ? message_length : length, length, field_count);
+}
+
+void LogLine::append(const char* data, size_t count) {
+    // Fields follow the message in the buffer; later text has nowhere to go
+    if (in_fields) return;
+    append_raw(data, count);
+}
+
+void LogLine::append_raw(const char* data, size_t count) {
+    size_t room = MAX_LINE - length;
+    if (count > room) count = room;
+    memcpy(buffer + length, data, count);
+    length += (uint32_t)count;
+}
+
+void LogLine::append_signed(long long value) {
+    char digits[24];
+    int count = snprintf(digits, sizeof(digits), "%lld", value);
+    append(digits, (size_t)count);
+}
+
+void LogLine::append_unsigned(unsigned long long value) {
+    char digits[24];
+    int count = snprintf(digits, sizeof(digits), "%llu", value);
+    append(digits, (size_t)count);
+}
+
+LogLine& LogLine::operator<<(double value) {
+    char digits[32];
+    int count = snprintf(digits, sizeof(digits), "%g", value);
+    append(digits, (size_t)count);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const LogField& field) {
+    // A field is stored whole or not at all, so the flusher can parse it
+    size_t key_length = std::min<size_t>(field.key.size(), 0xffff);
+    size_t value_length = std::min<size_t>(field.value.size(), 0xffff);
+    size_t needed = 2 * sizeof(uint16_t) + key_length + value_length;
+    if (needed > MAX_LINE - length) return *this;
+    if (!in_fields) {
+        message_length = length;
+        in_fields = true;
+    }
+    uint16_t part_length = (uint16_t)key_length;
+    append_raw(reinterpret_cast<const char*>(&part_length), sizeof(part_length));
+    append_raw(field.key.data(), key_length);
+    part_length = (uint16_t)value_length;
+    append_raw(reinterpret_cast<const char*>(&part_length), sizeof(part_length));
+    append_raw(field.value.data(), value_length);
+    field_count++;
+    return *this;
+}
@@ -1,6 +1,15 @@
 #include "../include/server.hpp"
+#include <iostream>
 
-int main() {
-  start_server(8080);
+int main(int argc, char** argv) {
+  ServerConfig config;
+  std::string error;
+  if (!parse_server_config(argc, argv, config, error)) {
+    if (!error.empty()) std::cerr << error << "\n\n";
+    std::cerr << server_config_usage(argv[0]);
+    return error.empty() ? 0 : 1;
+  }
+
+  start_server(config, argv);
   return 0; 
 }
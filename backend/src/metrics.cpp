@@ -0,0 +1,230 @@
+//metrics.cpp
+#include "../include/metrics.hpp"
+#include <cstdio>
+
+namespace {
+
+// Exported histogram buckets, in microseconds, with their le labels
+const uint64_t EXPORT_BOUNDS_US[] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+                                     100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000};
+const char* const EXPORT_BOUND_LABELS[] = {"0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005",
+                                           "0.01", "0.025", "0.05", "0.1", "0.25", "0.5",
+                                           "1", "2.5", "5", "10"};
+
+const char* const STAGE_NAMES[] = {"parse", "queue", "auth", "handler", "serialize", "send"};
+const char* const OPERATION_NAMES[] = {"create_version", "terminal_command", "password_check", "content_search"};
+
+void append_label_value(std::string& out, std::string_view value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+// Buckets, sum and count of one histogram series; labels is the
+// comma-terminated label list shared by its lines
+void render_histogram(std::string& out, const char* name, const std::string& labels,
+                      const LatencyHistogram& histogram) {
+    char number[64];
+    for (size_t i = 0; i < sizeof(EXPORT_BOUNDS_US) / sizeof(EXPORT_BOUNDS_US[0]); i++) {
+        snprintf(number, sizeof(number), "%llu", (unsigned long long)histogram.count_at_or_below(EXPORT_BOUNDS_US[i]));
+        out += name;
+        out += "_bucket{" + labels + "le=\"" + EXPORT_BOUND_LABELS[i] + "\"} " + number + "\n";
+    }
+    uint64_t count = histogram.count();
+    snprintf(number, sizeof(number), "%llu", (unsigned long long)count);
+    out += name;
+    out += "_bucket{" + labels + "le=\"+Inf\"} " + number + "\n";
+
+    std::string plain_labels = labels.empty() ? "" : "{" + labels.substr(0, labels.size() - 1) + "}";
+    snprintf(number, sizeof(number), "%.6f", histogram.sum() / 1e6);
+    out += name;
+    out += "_sum" + plain_labels + " " + number + "\n";
+    snprintf(number, sizeof(number), "%llu", (unsigned long long)count);
+    out += name;
+    out += "_count" + plain_labels + " " + number + "\n";
+}
+
+void render_header(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+} // namespace
+
+// LatencyHistogram
+
+size_t LatencyHistogram::bucket_of(uint64_t micros) {
+    if (micros >= (1ull << MAX_VALUE_BITS)) micros = (1ull << MAX_VALUE_BITS) - 1;
+    if (micros < SUB_BUCKETS) return (size_t)micros;
+    int top_bit = 63 - __builtin_clzll(micros);
+    int group = top_bit - SUB_BUCKET_BITS + 1;
+    uint64_t index = (micros >> (top_bit - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+    return (size_t)group * SUB_BUCKETS + (size_t)index;
+}
+
+uint64_t LatencyHistogram::lowest_in(size_t bucket) {
+    size_t group = bucket / SUB_BUCKETS;
+    uint64_t index = bucket % SUB_BUCKETS;
+    if (group == 0) return index;
+    return (SUB_BUCKETS + index) << (group - 1);
+}
+
+void LatencyHistogram::record(uint64_t micros) {
+    counts[bucket_of(micros)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(micros, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count_at_or_below(uint64_t micros) const {
+    uint64_t result = 0;
+    for (size_t bucket = 0; bucket < BUCKETS && lowest_in(bucket) <= micros; bucket++) {
+        result += counts[bucket].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+uint64_t LatencyHistogram::value_at_percentile(double percentile) const {
+    uint64_t recorded = count();
+    if (recorded == 0) return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)recorded + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > recorded) rank = recorded;
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKETS; bucket++) {
+        seen += counts[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) return bucket + 1 < BUCKETS ? lowest_in(bucket + 1) - 1 : lowest_in(bucket);
+    }
+    return lowest_in(BUCKETS - 1);
+}
+
+// Metrics
+
+struct Metrics::RouteSeries {
+    RouteLabel label;
+    LatencyHistogram stages[(size_t)RequestStage::COUNT];
+    std::atomic<LatencyHistogram*> statuses[STATUS_SLOTS] = {};
+
+    ~RouteSeries() {
+        for (auto& status : statuses) delete status.load();
+    }
+};
+
+Metrics::Metrics() : routes(new std::atomic<RouteSeries*>[MAX_ROUTES]()) {}
+
+Metrics::~Metrics() {
+    for (uint32_t i = 0; i < MAX_ROUTES; i++) delete routes[i].load();
+}
+
+Metrics::RouteSeries& Metrics::route_series(const RouteLabel& route) {
+    std::atomic<RouteSeries*>& slot = routes[route.id < MAX_ROUTES ? route.id : MAX_ROUTES - 1];
+    RouteSeries* series = slot.load(std::memory_order_acquire);
+    if (series) return *series;
+
+    // First request on this route: racing creators agree through the CAS
+    RouteSeries* created = new RouteSeries();
+    created->label = route;
+    if (slot.compare_exchange_strong(series, created, std::memory_order_acq_rel)) return *created;
+    delete created;
+    return *series;
+}
+
+LatencyHistogram& Metrics::status_histogram(RouteSeries& series, int status) {
+    int index = status - MIN_STATUS;
+    if (index < 0 || index >= STATUS_SLOTS) index = STATUS_SLOTS - 1;
+    std::atomic<LatencyHistogram*>& slot = series.statuses[index];
+    LatencyHistogram* histogram = slot.load(std::memory_order_acquire);
+    if (histogram) return *histogram;
+
+    LatencyHistogram* created = new LatencyHistogram();
+    if (slot.compare_exchange_strong(histogram, created, std::memory_order_acq_rel)) return *created;
+    delete created;
+    return *histogram;
+}
+
+void Metrics::record_request(const RequestTrace& trace, uint64_t now_us) {
+    RouteSeries& series = route_series(trace.route);
+    status_histogram(series, trace.status).record(now_us - trace.start_us);
+    for (size_t stage = 0; stage < (size_t)RequestStage::COUNT; stage++) {
+        if (trace.stages_seen & (1u << stage)) series.stages[stage].record(trace.stage_us[stage]);
+    }
+}
+
+void Metrics::record_operation(Operation operation, uint64_t micros) {
+    operations[(size_t)operation].record(micros);
+}
+
+std::string Metrics::render(const std::string& extra) const {
+    std::string out;
+    out.reserve(64 * 1024);
+
+    const char* request_name = "webeditor_request_duration_seconds";
+    render_header(out, request_name, "histogram", "Time from a parsed request to the last byte of its response");
+    for (uint32_t i = 0; i < MAX_ROUTES; i++) {
+        const RouteSeries* series = routes[i].load(std::memory_order_acquire);
+        if (!series) continue;
+        for (int index = 0; index < STATUS_SLOTS; index++) {
+            const LatencyHistogram* histogram = series->statuses[index].load(std::memory_order_acquire);
+            if (!histogram) continue;
+            std::string labels = "method=";
+            append_label_value(labels, series->label.method);
+            labels += ",route=";
+            append_label_value(labels, series->label.pattern);
+            labels += ",status=\"" + std::to_string(MIN_STATUS + index) + "\",";
+            render_histogram(out, request_name, labels, *histogram);
+        }
+    }
+
+    const char* stage_name = "webeditor_request_stage_seconds";
+    render_header(out, stage_name, "histogram", "Time requests spend in each stage of handling");
+    for (uint32_t i = 0; i < MAX_ROUTES; i++) {
+        const RouteSeries* series = routes[i].load(std::memory_order_acquire);
+        if (!series) continue;
+        for (size_t stage = 0; stage < (size_t)RequestStage::COUNT; stage++) {
+            if (series->stages[stage].count() == 0) continue;
+            std::string labels = "method=";
+            append_label_value(labels, series->label.method);
+            labels += ",route=";
+            append_label_value(labels, series->label.pattern);
+            labels += ",stage=\"";
+            labels += STAGE_NAMES[stage];
+            labels += "\",";
+            render_histogram(out, stage_name, labels, series->stages[stage]);
+        }
+    }
+
+    const char* operation_name = "webeditor_operation_duration_seconds";
+    render_header(out, operation_name, "histogram", "Duration of version commits, terminal commands, password checks and content searches");
+    for (size_t operation = 0; operation < (size_t)Operation::COUNT; operation++) {
+        std::string labels = "operation=\"";
+        labels += OPERATION_NAMES[operation];
+        labels += "\",";
+        render_histogram(out, operation_name, labels, operations[operation]);
+    }
+
+    out += extra;
+    return out;
+}
+
+void Metrics::render_value(std::string& out, const char* name, const char* type, const char* help, double value) {
+    render_header(out, name, type, help);
+    char number[64];
+    snprintf(number, sizeof(number), "%.17g", value);
+    out += name;
+    out += ' ';
+    out += number;
+    out += '\n';
+}
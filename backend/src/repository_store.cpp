@@ -0,0 +1,384 @@
+//repository_store.cpp
+#include "../include/repository_store.hpp"
+#include "../include/log_file.hpp"
+#include "../include/logger.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace log_file;
+
+namespace {
+
+// A repository log is LOG_MAGIC followed by log_file records. Each record
+// payload is RECORD_VERSION and then a run of operations, the first record
+// starting with OP_CREATE.
+const char LOG_MAGIC[8] = {'W', 'E', 'R', 'E', 'P', 'O', 'L', '1'};
+const uint64_t LOG_HEADER_SIZE = sizeof(LOG_MAGIC);
+const uint8_t RECORD_VERSION = 1;
+const size_t REWRITE_MIN_RECORDS = 64;         // Shorter logs are never rewritten
+const size_t SNAPSHOT_RECORD_BYTES = 256 * 1024;
+
+enum Op : uint8_t {
+    OP_CREATE = 1,           // key, name, path
+    OP_VERSION = 2,          // Version fields
+    OP_BRANCH = 3,           // branch, version id
+    OP_HEAD = 4,             // version id
+    OP_CURRENT_BRANCH = 5,   // branch
+};
+
+uint64_t hash_key(const std::string& key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+void put_version(std::string& out, const Version& version) {
+    put_u8(out, OP_VERSION);
+    put_string(out, version.id);
+    put_string(out, version.message);
+    put_string(out, version.author);
+    put_i64(out, version.timestamp);
+    put_string(out, version.parent_id);
+    put_u32(out, (uint32_t)version.file_hashes.size());
+    for (const auto& pair : version.file_hashes) {
+        put_string(out, pair.first);
+        put_string(out, pair.second);
+    }
+    put_u32(out, (uint32_t)version.changed_files.size());
+    for (const auto& file : version.changed_files) {
+        put_string(out, file);
+    }
+}
+
+bool read_version(Reader& reader, Version& version) {
+    int64_t timestamp;
+    uint32_t count;
+    if (!reader.read_string(version.id) || !reader.read_string(version.message) ||
+        !reader.read_string(version.author) || !reader.read_i64(timestamp) ||
+        !reader.read_string(version.parent_id) || !reader.read_u32(count)) {
+        return false;
+    }
+    version.timestamp = (time_t)timestamp;
+    for (uint32_t i = 0; i < count; i++) {
+        std::string file, hash;
+        if (!reader.read_string(file) || !reader.read_string(hash)) return false;
+        version.file_hashes[file] = hash;
+    }
+    if (!reader.read_u32(count)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        std::string file;
+        if (!reader.read_string(file)) return false;
+        version.changed_files.push_back(std::move(file));
+    }
+    return true;
+}
+
+std::string encode_record(const std::string& ops) {
+    std::string record = begin_record();
+    put_u8(record, RECORD_VERSION);
+    record += ops;
+    finish_record(record);
+    return record;
+}
+
+} // namespace
+
+void RepositoryChange::add_version(const Version& version) {
+    put_version(ops, version);
+}
+
+void RepositoryChange::set_branch(const std::string& branch, const std::string& version_id) {
+    put_u8(ops, OP_BRANCH);
+    put_string(ops, branch);
+    put_string(ops, version_id);
+}
+
+void RepositoryChange::set_head(const std::string& version_id) {
+    put_u8(ops, OP_HEAD);
+    put_string(ops, version_id);
+}
+
+void RepositoryChange::set_current_branch(const std::string& branch) {
+    put_u8(ops, OP_CURRENT_BRANCH);
+    put_string(ops, branch);
+}
+
+RepositoryStore::RepositoryStore(const std::string& data_dir)
+    : data_dir(data_dir), repositories_dir(data_dir + "/repositories") {
+}
+
+bool RepositoryStore::open(std::string& error) {
+    bool fresh = access(repositories_dir.c_str(), F_OK) != 0;
+    if (fresh && mkdir(repositories_dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        error = "Cannot create " + repositories_dir + ": " + strerror(errno);
+        return false;
+    }
+
+    std::string legacy_path = data_dir + "/repositories.txt";
+    if (fresh && access(legacy_path.c_str(), F_OK) == 0 && !import_legacy(legacy_path)) {
+        error = "Cannot import " + legacy_path;
+        return false;
+    }
+    return true;
+}
+
+bool RepositoryStore::contains(const std::string& key) {
+    return load(key);
+}
+
+bool RepositoryStore::create(const std::string& key, const Repository& repository) {
+    if (load(key)) return false;
+
+    bool created = false;
+    cache.upsert(key, [&](Repository& entry) {
+        if (!entry.name.empty()) return true; // Lost a race with another create
+        // load() also fails on a log that is corrupt or belongs to a key with
+        // the same hash; that history must survive, so never overwrite it
+        // Returning false also drops the placeholder entry, so a failed
+        // create leaves no repository behind
+        if (!rewrite(key, repository, log_path(key), false)) {
+            if (errno == EEXIST) {
+                LOG_ERROR << "Cannot create repository " << key << ": " << log_path(key)
+                          << " exists but could not be loaded";
+            } else {
+                LOG_ERROR << "Cannot create repository log for " << key << ": " << strerror(errno);
+            }
+            return false;
+        }
+        entry = repository;
+        created = true;
+        return true;
+    });
+    return created;
+}
+
+std::string RepositoryStore::log_path(const std::string& key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.log", (unsigned long long)hash_key(key));
+    return repositories_dir + name;
+}
+
+bool RepositoryStore::load(const std::string& key) {
+    if (cache.contains(key)) return true;
+
+    std::lock_guard<std::mutex> lock(load_mutex);
+    if (cache.contains(key)) return true;
+
+    std::string path = log_path(key);
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    Repository repository;
+    size_t records = 0;
+    bool loaded = replay(fd, key, repository, records);
+    close(fd);
+    if (!loaded) return false;
+
+    // Every version and branch needs its own operation; the rest only moved heads
+    size_t live = repository.versions.size() + repository.branches.size() + 1;
+    if (records > REWRITE_MIN_RECORDS && records > 2 * live && !rewrite(key, repository, path)) {
+        LOG_ERROR << "Failed to rewrite repository log " << path << ": " << strerror(errno);
+    }
+
+    cache.insert(key, std::move(repository));
+    return true;
+}
+
+bool RepositoryStore::replay(int fd, const std::string& key, Repository& repository, size_t& records) {
+    std::string path = log_path(key);
+    char magic[sizeof(LOG_MAGIC)];
+    if (!read_all(fd, magic, sizeof(magic), 0) || memcmp(magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) {
+        LOG_ERROR << path << " is not a repository log";
+        return false;
+    }
+
+    uint64_t size = file_size(fd);
+    uint64_t offset = LOG_HEADER_SIZE;
+    std::string payload;
+    uint32_t length;
+    while (offset < size && read_record(fd, offset, payload, length)) {
+        std::string logged_key;
+        if ((uint8_t)payload[0] != RECORD_VERSION ||
+            !apply(payload.data() + 1, payload.size() - 1, repository, records == 0 ? &logged_key : nullptr)) {
+            break;
+        }
+        if (records == 0 && logged_key != key) {
+            // Two keys whose names hash alike; the first one keeps the log
+            LOG_ERROR << path << " belongs to repository " << logged_key << ", not " << key;
+            return false;
+        }
+        offset += length;
+        records++;
+    }
+    if (records == 0) {
+        LOG_ERROR << path << " has no valid records";
+        return false;
+    }
+    // Anything after the last whole record is a write cut short by a crash
+    if (offset < size) {
+        LOG_WARN << "Discarding " << (size - offset) << " bytes of incomplete repository log " << path;
+        if (ftruncate(fd, (off_t)offset) != 0) return false;
+        fdatasync(fd);
+    }
+    return true;
+}
+
+bool RepositoryStore::rewrite(const std::string& key, const Repository& repository, const std::string& path,
+                              bool replace) {
+    // Metadata first, then the versions in records of bounded size
+    RepositoryChange head;
+    put_u8(head.ops, OP_CREATE);
+    put_string(head.ops, key);
+    put_string(head.ops, repository.name);
+    put_string(head.ops, repository.path);
+    for (const auto& pair : repository.branches) {
+        head.set_branch(pair.first, pair.second);
+    }
+    head.set_current_branch(repository.current_branch);
+    head.set_head(repository.head_version);
+
+    std::string buffer(LOG_MAGIC, sizeof(LOG_MAGIC));
+    buffer += encode_record(head.ops);
+    std::string ops;
+    for (const auto& pair : repository.versions) {
+        put_version(ops, pair.second);
+        if (ops.size() >= SNAPSHOT_RECORD_BYTES) {
+            buffer += encode_record(ops);
+            ops.clear();
+        }
+    }
+    if (!ops.empty()) {
+        buffer += encode_record(ops);
+    }
+
+    // Built aside and renamed into place, so a crash leaves the old log or
+    // the new one. A new log is linked instead, which fails if one exists.
+    std::string temp_path = path + ".tmp";
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    bool ok = write_all(fd, buffer.data(), buffer.size(), 0) && fdatasync(fd) == 0;
+    close(fd);
+    if (ok && !replace) {
+        ok = link(temp_path.c_str(), path.c_str()) == 0;
+        int saved = errno;
+        unlink(temp_path.c_str());
+        errno = saved;
+        if (!ok) return false;
+    } else if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        int saved = errno;
+        unlink(temp_path.c_str());
+        errno = saved;
+        return false;
+    }
+    sync_directory(repositories_dir);
+    return true;
+}
+
+int RepositoryStore::append(const std::string& key, const RepositoryChange& change) {
+    std::string record = encode_record(change.ops);
+    if (record.size() - RECORD_HEADER_SIZE > MAX_RECORD_SIZE) {
+        throw std::runtime_error("Repository change too large for " + key);
+    }
+
+    int fd = ::open(log_path(key).c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open repository log for " + key + ": " + strerror(errno));
+    }
+    uint64_t end = file_size(fd);
+    if (!write_all(fd, record.data(), record.size(), end)) {
+        int write_error = errno;
+        // Later records must not land behind a partial one
+        if (ftruncate(fd, (off_t)end) != 0) {
+            LOG_ERROR << "Cannot trim repository log for " << key << ": " << strerror(errno);
+        }
+        close(fd);
+        throw std::runtime_error("Cannot append to repository log for " + key + ": " + strerror(write_error));
+    }
+    return fd;
+}
+
+void RepositoryStore::sync(int fd) {
+    int result = fdatasync(fd);
+    int sync_error = errno;
+    close(fd);
+    if (result != 0) {
+        throw std::runtime_error(std::string("Cannot sync repository log: ") + strerror(sync_error));
+    }
+}
+
+bool RepositoryStore::apply(const char* ops, size_t size, Repository& repository, std::string* key) {
+    Reader reader(ops, size);
+    while (!reader.at_end()) {
+        uint8_t op;
+        std::string first, second;
+        if (!reader.read_u8(op)) return false;
+        switch (op) {
+        case OP_CREATE:
+            if (!key || !reader.read_string(*key) || !reader.read_string(repository.name) ||
+                !reader.read_string(repository.path)) {
+                return false;
+            }
+            break;
+        case OP_VERSION: {
+            Version version;
+            if (!read_version(reader, version)) return false;
+            std::string id = version.id;
+            repository.versions[id] = std::move(version);
+            break;
+        }
+        case OP_BRANCH:
+            if (!reader.read_string(first) || !reader.read_string(second)) return false;
+            repository.branches[first] = second;
+            break;
+        case OP_HEAD:
+            if (!reader.read_string(repository.head_version)) return false;
+            break;
+        case OP_CURRENT_BRANCH:
+            if (!reader.read_string(repository.current_branch)) return false;
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RepositoryStore::import_legacy(const std::string& path) {
+    LOG_INFO << "Importing repositories from: " << path;
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    std::string line;
+    size_t imported = 0;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+
+        std::istringstream line_stream(line);
+        std::string repo_key, head_version;
+        Repository repository;
+        if (!std::getline(line_stream, repo_key, '|') || !std::getline(line_stream, repository.name, '|') ||
+            !std::getline(line_stream, repository.path, '|') ||
+            !std::getline(line_stream, repository.current_branch, '|') ||
+            !std::getline(line_stream, head_version, '|')) {
+            continue;
+        }
+        // repositories.txt never held versions or branches; keep what it had
+        if (repository.name.empty()) repository.name = repository.path.empty() ? "root" : repository.path;
+        repository.head_version = head_version;
+        if (!head_version.empty()) repository.branches[repository.current_branch] = head_version;
+        if (create(repo_key, repository)) imported++;
+    }
+    file.close();
+    rename(path.c_str(), (path + ".imported").c_str());
+    LOG_INFO << "Imported " << imported << " repositories";
+    return true;
+}
@@ -0,0 +1,162 @@
+//response_writer.cpp
+#include "../include/response_writer.hpp"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace {
+
+char* append(char* out, const std::string& str) {
+    memcpy(out, str.data(), str.size());
+    return out + str.size();
+}
+
+char* append(char* out, const char* str, size_t length) {
+    memcpy(out, str, length);
+    return out + length;
+}
+
+} // namespace
+
+ResponseWriter::ResponseWriter(HttpResponse&& response, bool chunked) {
+    // 1xx, 204 and 304 responses never carry a body
+    bool bodyless = response.status_code < 200 || response.status_code == 204 || response.status_code == 304;
+    bool streamed = !bodyless && response.stream;
+    const char* framing = nullptr;
+    size_t framing_size = 0;
+    if (streamed && chunked) {
+        framing = "Transfer-Encoding: chunked\r\n";
+        framing_size = 28;
+    } else if (!bodyless && !streamed) {
+        framing = "Content-Length: ";
+        framing_size = 16;
+    }
+
+    char status[16];
+    char* status_end = std::to_chars(status, status + sizeof(status), response.status_code).ptr;
+    char length[24];
+    char* length_end = std::to_chars(length, length + sizeof(length), response.content_length()).ptr;
+
+    // Size the head exactly so it is written in one pass
+    head_size = 9 + (status_end - status) + 1 + response.status_text.size() + 2;
+    for (const auto& header : response.headers) {
+        head_size += header.first.size() + 2 + header.second.size() + 2;
+    }
+    head_size += framing_size + 2;
+    if (framing && !streamed) {
+        head_size += (length_end - length) + 2;
+    }
+
+    char* out = inline_head;
+    if (head_size > INLINE_HEAD_SIZE) {
+        heap_head.resize(head_size);
+        out = &heap_head[0];
+    }
+
+    out = append(out, "HTTP/1.1 ", 9);
+    out = append(out, status, status_end - status);
+    *out++ = ' ';
+    out = append(out, response.status_text);
+    out = append(out, "\r\n", 2);
+    for (const auto& header : response.headers) {
+        out = append(out, header.first);
+        out = append(out, ": ", 2);
+        out = append(out, header.second);
+        out = append(out, "\r\n", 2);
+    }
+    if (framing) {
+        out = append(out, framing, framing_size);
+    }
+    if (framing && !streamed) {
+        out = append(out, length, length_end - length);
+        out = append(out, "\r\n", 2);
+    }
+    append(out, "\r\n", 2);
+
+    if (streamed) {
+        producer = std::move(response.stream);
+        stream_wait = std::move(response.stream_wait);
+        this->chunked = chunked;
+    } else if (!bodyless) {
+        body = std::move(response.body);
+        shared_body = std::move(response.shared_body);
+        file_body = std::move(response.file_body);
+    }
+}
+
+ResponseWriter ResponseWriter::chunk(std::string data, BodyProducer next, bool chunked, StreamWait wait) {
+    ResponseWriter writer;
+    writer.producer = std::move(next);
+    if (writer.producer) writer.stream_wait = std::move(wait);
+    writer.chunked = chunked;
+    writer.body = std::move(data);
+    if (!chunked) return writer;
+
+    // An empty piece must not be framed: a zero-size chunk ends the body
+    if (!writer.body.empty()) {
+        char* out = std::to_chars(writer.inline_head, writer.inline_head + 16, writer.body.size(), 16).ptr;
+        out = append(out, "\r\n", 2);
+        writer.head_size = out - writer.inline_head;
+        writer.tail_size = append(writer.tail, "\r\n", 2) - writer.tail;
+    }
+    if (!writer.producer) {
+        writer.tail_size = append(writer.tail + writer.tail_size, "0\r\n\r\n", 5) - writer.tail;
+    }
+    return writer;
+}
+
+size_t ResponseWriter::total_size() const {
+    return head_size + body_data().size() + tail_size + (file_body ? file_body->length : 0);
+}
+
+ResponseWriter::Status ResponseWriter::write_to(int fd) {
+    const std::string& payload = body_data();
+    size_t in_memory = head_size + payload.size() + tail_size;
+
+    while (written < in_memory) {
+        iovec iov[3];
+        int count = 0;
+        if (written < head_size) {
+            iov[count++] = {(void*)(head_data() + written), head_size - written};
+        }
+        size_t body_offset = written > head_size ? written - head_size : 0;
+        if (body_offset < payload.size()) {
+            iov[count++] = {(void*)(payload.data() + body_offset), payload.size() - body_offset};
+        }
+        size_t tail_offset = written > head_size + payload.size() ? written - head_size - payload.size() : 0;
+        if (tail_offset < tail_size) {
+            iov[count++] = {(void*)(tail + tail_offset), tail_size - tail_offset};
+        }
+
+        // sendmsg rather than writev so a vanished peer cannot raise SIGPIPE
+        msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (sent > 0) {
+            written += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return Status::BLOCKED;
+        return Status::ERROR;
+    }
+
+    while (file_body && written - in_memory < file_body->length) {
+        size_t file_sent = written - in_memory;
+        off_t offset = file_body->offset + file_sent;
+        ssize_t sent = sendfile(fd, file_body->fd, &offset, file_body->length - file_sent);
+        if (sent > 0) {
+            written += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return Status::BLOCKED;
+        return Status::ERROR; // sendfile() returning 0 means the file shrank underneath us
+    }
+
+    return Status::DONE;
+}
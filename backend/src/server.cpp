@@ -1,8 +1,6 @@
 //server.cpp 
 #include "../include/server.hpp"
-#include <iostream>
 #include <filesystem>
-#include <regex>
 #include <iomanip>
 #include <sstream>
 #include <sys/wait.h>
@@ -13,124 +11,223 @@
 #include <cstdlib>
 #include <cstring>
 #include <signal.h>
+#include <fcntl.h>
 #include <algorithm>
+#include <openssl/evp.h>
 
 namespace fs = std::filesystem;
 
-// Global server instance
-static WebServer* g_server = nullptr;
+// Split a comma-separated header value into trimmed items
+static std::vector<std::string> split_header_list(const std::string& value) {
+    std::vector<std::string> items;
+    std::istringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// If-None-Match uses weak comparison: W/ prefixes are ignored
+static bool etag_matches(const std::string& if_none_match, const std::string& etag) {
+    auto opaque = [](const std::string& tag) { return tag.rfind("W/", 0) == 0 ? tag.substr(2) : tag; };
+    for (const auto& candidate : split_header_list(if_none_match)) {
+        if (candidate == "*" || opaque(candidate) == opaque(etag)) return true;
+    }
+    return false;
+}
+
+// A single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range of a
+// size-byte file. False when the header is to be ignored: another unit,
+// several ranges or bad syntax all get the whole file. Otherwise
+// satisfiable says whether the range overlaps the file.
+static bool parse_byte_range(const std::string& header, uint64_t size, uint64_t& offset, uint64_t& length,
+                             bool& satisfiable) {
+    if (header.rfind("bytes=", 0) != 0) return false;
+    std::string spec = header.substr(6);
+    spec.erase(0, spec.find_first_not_of(" \t"));
+    spec.erase(spec.find_last_not_of(" \t") + 1);
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos || spec.find(',') != std::string::npos) return false;
+    
+    auto number = [](const std::string& text, uint64_t& value) {
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+        errno = 0;
+        value = strtoull(text.c_str(), nullptr, 10);
+        return errno == 0;
+    };
+    std::string first_text = spec.substr(0, dash), last_text = spec.substr(dash + 1);
+    uint64_t first, last;
+    if (first_text.empty()) {
+        // Suffix: the final last_text bytes
+        if (!number(last_text, last)) return false;
+        satisfiable = last > 0 && size > 0;
+        offset = size - std::min(last, size);
+        length = size - offset;
+        return true;
+    }
+    if (!number(first_text, first)) return false;
+    if (last_text.empty()) {
+        last = UINT64_MAX;
+    } else if (!number(last_text, last) || last < first) {
+        return false;
+    }
+    satisfiable = first < size;
+    offset = first;
+    length = satisfiable ? std::min(last, size - 1) - first + 1 : 0;
+    return true;
+}
+
+// True if Accept-Encoding lists the coding (or *) without q=0
+static bool accepts_encoding(const std::string& accept_encoding, const std::string& coding) {
+    for (const auto& item : split_header_list(accept_encoding)) {
+        size_t semicolon = item.find(';');
+        std::string name = item.substr(0, semicolon);
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (strcasecmp(name.c_str(), coding.c_str()) != 0 && name != "*") continue;
+        
+        if (semicolon == std::string::npos) return true;
+        size_t q_pos = item.find("q=", semicolon);
+        return q_pos == std::string::npos || std::strtod(item.c_str() + q_pos + 2, nullptr) > 0;
+    }
+    return false;
+}
+
+// A query parameter's value, or null when the request has none
+static const std::string* query_param(const HttpRequest& request, const char* name) {
+    auto it = request.query_params.find(name);
+    return it != request.query_params.end() ? &it->second : nullptr;
+}
+
+// Strip leading and trailing slashes from a path within the workspace;
+// false if a ".." component would climb out of it
+static bool normalize_relative_path(std::string& path) {
+    path.erase(0, path.find_first_not_of('/'));
+    path.erase(path.find_last_not_of('/') + 1);
+    return ("/" + path + "/").find("/../") == std::string::npos;
+}
+
+// A decimal count of at least min, clamped to max; false if text is not one
+static bool parse_limit(const std::string& text, size_t& value, size_t max, size_t min = 1) {
+    char* end;
+    unsigned long long parsed = strtoull(text.c_str(), &end, 10);
+    if (text.empty() || !isdigit((unsigned char)text[0]) || *end != '\0' || parsed < min) return false;
+    value = std::min<unsigned long long>(parsed, max);
+    return true;
+}
+
+// Raw bytes read per streamed chunk; url-encoding can triple them
+static const size_t STREAM_BLOCK_SIZE = 32 * 1024;
+// Directory entries serialized per streamed chunk
+static const size_t STREAM_BATCH_ENTRIES = 256;
+
+// Largest page of a directory listing
+static const size_t MAX_LISTING_PAGE = 10000;
+
+// Results of /api/find, by default and at most
+static const size_t DEFAULT_FIND_RESULTS = 20;
+static const size_t MAX_FIND_RESULTS = 200;
+
+// Matching lines of /api/search, by default and at most, and context lines around each
+static const size_t DEFAULT_SEARCH_MATCHES = 1000;
+static const size_t MAX_SEARCH_MATCHES = 10000;
+static const size_t MAX_SEARCH_CONTEXT = 5;
 
 // Constructor
-WebServer::WebServer(uint16_t port) : port(port), server_fd(-1) {
-    data_dir = "data";
+WebServer::WebServer(const ServerConfig& config)
+    : config(config),
+      users(config.data_dir),
+      sessions(config.max_sessions, config.session_timeout_ms,
+               [this](const SessionToken& token) { session_directories.erase(token.to_hex()); }),
+      repositories(config.data_dir),
+      static_cache(std::make_unique<StaticFileCache>(config.frontend_dir, config.static_cache_max_file)),
+      workspace_index(std::make_unique<WorkspaceIndex>(config.data_dir + "/users", config.workspace_index_budget)),
+      content_index(std::make_unique<ContentIndex>(config.search_index_budget)),
+      search_pool(std::make_unique<WorkStealingPool>(config.search_threads > 0 ? config.search_threads
+                                                                               : std::thread::hardware_concurrency())),
+      crypto_pool(std::make_unique<WorkStealingPool>(config.crypto_threads)),
+      pool(std::make_unique<WorkStealingPool>(config.worker_threads > 0 ? config.worker_threads
+                                                                         : std::thread::hardware_concurrency())) {
+    data_dir = config.data_dir;
     if (!fs::exists(data_dir)) {
         fs::create_directories(data_dir);
     }
-    load_users();
-    load_repositories();
+    std::string error;
+    if (!users.open(error) || !repositories.open(error)) {
+        throw std::runtime_error(error);
+    }
+    restore_sessions();
+    static_cache->load();
 }
 
 // Destructor
 WebServer::~WebServer() {
     stop();
-    save_users();
-}
-
-// Password hashing
-std::string WebServer::hash_password(const std::string& password) {
-    std::string salt = generate_salt();
-    std::string salted = password + salt;
-    
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, salted.c_str(), salted.length());
-    SHA256_Final(hash, &sha256);
-    
-    std::stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    // Handlers still running post to the loops' eventfds, which must outlive the pools
+    pool.reset();
+    crypto_pool.reset();
+    search_pool.reset();
+    for (auto& loop : loops) {
+        for (int* fd : {&loop->wake_fd, &loop->epoll_fd, &loop->listen_fd}) {
+            if (*fd >= 0) {
+                close(*fd);
+                *fd = -1;
+            }
+        }
     }
-    
-    return salt + ":" + ss.str();
+    save_sessions();
 }
 
-// Generate random salt
-std::string WebServer::generate_salt() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
-    
-    std::string salt;
-    for (int i = 0; i < 16; i++) {
-        salt += (char)dis(gen);
+void WebServer::stop() {
+    // Wake every loop so it notices running is false, then wait for the other threads.
+    // Loop descriptors stay open for handlers still in flight; the destructor closes them.
+    running = false;
+    for (auto& loop : loops) {
+        uint64_t one = 1;
+        if (loop->wake_fd >= 0) {
+            ssize_t ignored = write(loop->wake_fd, &one, sizeof(one));
+            (void)ignored;
+        }
     }
-    
-    std::stringstream ss;
-    for (char c : salt) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)(unsigned char)c;
+    for (auto& loop : loops) {
+        if (loop->thread.joinable() && loop->thread.get_id() != std::this_thread::get_id()) {
+            loop->thread.join();
+        }
     }
-    return ss.str();
-}
 
-// Verify password
-bool WebServer::verify_password(const std::string& password, const std::string& hash) {
-    size_t colon_pos = hash.find(':');
-    if (colon_pos == std::string::npos) return false;
-    
-    std::string salt = hash.substr(0, colon_pos);
-    std::string stored_hash = hash.substr(colon_pos + 1);
-    
-    std::string salted = password + salt;
-    unsigned char computed_hash[SHA256_DIGEST_LENGTH];
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-    SHA256_Update(&sha256, salted.c_str(), salted.length());
-    SHA256_Final(computed_hash, &sha256);
-    
-    std::stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)computed_hash[i];
+    for (auto& loop : loops) {
+        for (auto& pair : loop->connections) {
+            close(pair.first);
+        }
+        loop->connections.clear();
     }
-    
-    return stored_hash == ss.str();
 }
 
-// Generate session token
-std::string WebServer::generate_session_token() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
+// Password checking; runs on the crypto pool
+bool WebServer::check_credentials(const std::string& username, const std::string& password) {
+    OperationTimer timer(metrics, Operation::PASSWORD_CHECK);
+    // Unknown users are checked against a placeholder so they take as long as known ones
+    static const std::string placeholder_hash = hash_password("", config.password_kdf);
     
-    std::string token;
-    for (int i = 0; i < 32; i++) {
-        token += (char)dis(gen);
+    std::string password_hash;
+    bool found = users.read(username, [&](const User& user) { password_hash = user.password_hash; });
+    if (!verify_password(password, found ? password_hash : placeholder_hash) || !found) {
+        return false;
     }
     
-    std::stringstream ss;
-    for (char c : token) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)(unsigned char)c;
+    if (needs_rehash(password_hash, config.password_kdf)) {
+        std::string upgraded = hash_password(password, config.password_kdf);
+        users.update(username, [&](User& user) { user.password_hash = upgraded; });
+        LOG_INFO << "Upgraded password hash for: " << username;
     }
-    return ss.str();
+    return true;
 }
 
 // URL encoding/decoding
 std::string WebServer::url_decode(const std::string& str) {
-    std::string result;
-    for (size_t i = 0; i < str.length(); i++) {
-        if (str[i] == '%' && i + 2 < str.length()) {
-            int value;
-            std::istringstream iss(str.substr(i + 1, 2));
-            iss >> std::hex >> value;
-            result += (char)value;
-            i += 2;
-        } else if (str[i] == '+') {
-            result += ' ';
-        } else {
-            result += str[i];
-        }
-    }
-    return result;
+    return percent_decode(str);
 }
 
 std::string WebServer::url_encode(const std::string& str) {
@@ -150,13 +247,7 @@ std::string WebServer::url_encode(const std::string& str) {
 
 // MIME type detection
 std::string WebServer::get_mime_type(const std::string& filename) {
-    std::string ext = fs::path(filename).extension().string();
-    if (ext == ".html") return "text/html";
-    if (ext == ".css") return "text/css";
-    if (ext == ".js") return "application/javascript";
-    if (ext == ".json") return "application/json";
-    if (ext == ".txt") return "text/plain";
-    return "text/plain";
+    return mime_type_for(filename);
 }
 
 // File operations
@@ -194,39 +285,55 @@ bool WebServer::delete_user_filesystem(const std::string& username) {
     return true;
 }
 
-std::vector<FileInfo> WebServer::list_user_files(const std::string& username, const std::string& path) {
-    std::vector<FileInfo> files;
+// List from the workspace index, or from the disk where it cannot answer.
+// False with errno EINVAL for a cursor that does not match the sort.
+bool WebServer::list_workspace(const std::string& username, const std::string& relative_dir,
+                               const ListingQuery& query, ListingPage& page) {
+    switch (workspace_index->list(username, relative_dir, query, page)) {
+    case WorkspaceIndex::Result::FOUND:
+        return true;
+    case WorkspaceIndex::Result::NOT_FOUND:
+        page = ListingPage();
+        errno = ENOENT;
+        return false;
+    case WorkspaceIndex::Result::BAD_CURSOR:
+        errno = EINVAL;
+        return false;
+    case WorkspaceIndex::Result::UNAVAILABLE:
+        break;
+    }
     std::string user_dir = data_dir + "/users/" + username;
-    std::string target_dir = user_dir;
-    
-    if (!path.empty()) {
-        target_dir += "/" + path;
+    return list_directory(relative_dir.empty() ? user_dir : user_dir + "/" + relative_dir, query, page);
+}
+
+bool WebServer::workspace_entry_exists(const std::string& username, const std::string& relative_path) {
+    ListingEntry entry;
+    switch (workspace_index->find(username, relative_path, entry)) {
+    case WorkspaceIndex::Result::FOUND:
+        return true;
+    case WorkspaceIndex::Result::NOT_FOUND:
+        return false;
+    case WorkspaceIndex::Result::BAD_CURSOR:
+    case WorkspaceIndex::Result::UNAVAILABLE:
+        break;
     }
+    return fs::exists(data_dir + "/users/" + username + "/" + relative_path);
+}
+
+std::vector<FileInfo> WebServer::list_user_files(const std::string& username, const std::string& path) {
+    std::vector<FileInfo> files;
+    ListingPage listing;
+    if (!list_workspace(username, path, ListingQuery(), listing)) return files;
     
-    if (!fs::exists(target_dir)) return files;
-    
-    for (const auto& entry : fs::directory_iterator(target_dir)) {
+    for (ListingEntry& entry : listing.entries) {
         FileInfo file;
-        file.name = entry.path().filename().string();
-        
-        // Calculate relative path from user directory
-        std::string relative_path = fs::relative(entry.path(), user_dir).string();
-        file.path = relative_path;
-        
-        file.last_modified = fs::last_write_time(entry.path()).time_since_epoch().count();
-        file.is_directory = entry.is_directory();
-        
-        if (entry.is_regular_file()) {
-            file.content = read_file_content(entry.path().string());
-            file.size = fs::file_size(entry.path());
-        } else if (entry.is_directory()) {
-            file.size = 0;
-            file.content = "";
-        }
-        
-        files.push_back(file);
+        file.path = path.empty() ? entry.name : path + "/" + entry.name;
+        file.name = std::move(entry.name);
+        file.last_modified = entry.last_modified;
+        file.size = entry.size;
+        file.is_directory = entry.is_directory;
+        files.push_back(std::move(file));
     }
-    
     return files;
 }
 
@@ -234,138 +341,153 @@ std::vector<FileInfo> WebServer::list_user_files(const std::string& username, co
 std::string WebServer::extract_session_token(const HttpRequest& request) {
     auto it = request.headers.find("Cookie");
     if (it == request.headers.end()) {
-        std::cout << "No Cookie header found in request" << std::endl;
         return "";
     }
-    
-    std::string cookies = it->second;
-    std::cout << "Cookie header: " << cookies << std::endl;
-    
-    std::regex token_regex("session=([^;]+)");
-    std::smatch match;
-    
-    if (std::regex_search(cookies, match, token_regex)) {
-        std::string token = match[1].str();
-        std::cout << "Extracted session token: " << token << std::endl;
-        return token;
-    }
-    
-    std::cout << "No session token found in cookies" << std::endl;
-    return "";
+    return std::string(cookie_value(it->second, "session"));
 }
 
-bool WebServer::is_session_valid(const std::string& token) {
-    std::cout << "Validating session token: " << token << std::endl;
-    
-    auto it = sessions.find(token);
-    if (it == sessions.end()) {
-        std::cout << "Session token not found in sessions map" << std::endl;
-        return false;
+const std::string* WebServer::session_username(const std::string& token) {
+    SessionToken parsed;
+    if (!SessionToken::parse(token, parsed)) {
+        return nullptr;
     }
-    
-    time_t now = time(nullptr);
-    if (now - it->second.last_activity > 3600) { // 1 hour timeout
-        std::cout << "Session token expired" << std::endl;
-        sessions.erase(it);
+    return sessions.validate(parsed);
+}
+
+bool WebServer::start_session(const std::string& username, std::string& token) {
+    SessionToken created;
+    if (!sessions.create(username, created)) {
+        LOG_WARN << "Session table full, refusing login for: " << username;
         return false;
     }
-    
-    std::cout << "Session token is valid for user: " << it->second.username << std::endl;
+    token = created.to_hex();
+    users.update(username, [&](User& user) {
+        user.session_token = token;
+        user.last_activity = time(nullptr);
+    });
     return true;
 }
 
-void WebServer::update_session_activity(const std::string& token) {
-    auto it = sessions.find(token);
-    if (it != sessions.end()) {
-        it->second.last_activity = time(nullptr);
+void WebServer::restore_sessions() {
+    std::string path = data_dir + "/sessions.snapshot";
+    std::vector<SessionSnapshotEntry> entries;
+    std::string error;
+    if (!read_session_snapshot(path, entries, error)) {
+        LOG_WARN << "Ignoring session snapshot: " << error;
     }
-}
 
-// HTTP parsing
-HttpRequest WebServer::parse_http_request(const std::string& request) {
-    HttpRequest req;
-    std::istringstream stream(request);
-    std::string line;
-    
-    // Parse first line
-    if (std::getline(stream, line)) {
-        std::istringstream line_stream(line);
-        line_stream >> req.method >> req.path;
-    }
-    
-    // Parse headers
-    while (std::getline(stream, line) && line != "\r" && line != "") {
-        size_t colon_pos = line.find(':');
-        if (colon_pos != std::string::npos) {
-            std::string key = line.substr(0, colon_pos);
-            std::string value = line.substr(colon_pos + 1);
-            // Remove leading space and \r
-            if (!value.empty() && value[0] == ' ') value = value.substr(1);
-            if (!value.empty() && value.back() == '\r') value.pop_back();
-            req.headers[key] = value;
+    size_t restored = 0;
+    for (const auto& entry : entries) {
+        if (!users.contains(entry.session.username) || !sessions.restore(entry.session)) continue;
+        if (!entry.directory.empty()) {
+            session_directories.assign(entry.session.token.to_hex(), entry.directory);
         }
+        restored++;
     }
-    
-    // Parse body - read the entire remaining content as the body without adding newlines
-    std::string body;
-    std::string body_line;
-    while (std::getline(stream, body_line)) {
-        if (!body.empty()) body += "\n";
-        body += body_line;
+    // Used once: replaying it after a later crash would revive sessions that have ended since
+    unlink(path.c_str());
+    if (!entries.empty()) {
+        LOG_INFO << "Restored " << restored << " of " << entries.size() << " sessions";
     }
-    // Remove the trailing newline that was added
-    if (!body.empty() && body.back() == '\n') {
-        body.pop_back();
+}
+
+void WebServer::save_sessions() {
+    std::vector<SessionSnapshotEntry> entries;
+    for (auto& session : sessions.save()) {
+        SessionSnapshotEntry entry;
+        entry.session = std::move(session);
+        session_directories.find(entry.session.token.to_hex(), entry.directory);
+        entries.push_back(std::move(entry));
     }
-    req.body = body;
-    
-    // Parse query parameters
-    size_t query_pos = req.path.find('?');
-    if (query_pos != std::string::npos) {
-        std::string query_string = req.path.substr(query_pos + 1);
-        req.path = req.path.substr(0, query_pos);
-        
-        std::istringstream query_stream(query_string);
-        std::string param;
-        while (std::getline(query_stream, param, '&')) {
-            size_t equal_pos = param.find('=');
-            if (equal_pos != std::string::npos) {
-                std::string key = url_decode(param.substr(0, equal_pos));
-                std::string value = url_decode(param.substr(equal_pos + 1));
-                req.query_params[key] = value;
-            }
-        }
+    if (entries.empty()) return;
+
+    std::string error;
+    if (!write_session_snapshot(data_dir + "/sessions.snapshot", entries, error)) {
+        LOG_ERROR << "Failed to save sessions: " << error;
+        return;
     }
-    
-    return req;
+    LOG_INFO << "Saved " << entries.size() << " sessions";
 }
 
-std::string WebServer::build_http_response(const HttpResponse& response) {
-    std::ostringstream oss;
-    oss << "HTTP/1.1 " << response.status_code << " " << response.status_text << "\r\n";
-    
-    for (const auto& header : response.headers) {
-        oss << header.first << ": " << header.second << "\r\n";
+static HttpResponse invalid_session_response() {
+    return {401, "Unauthorized", {{"Content-Type", "application/json"}},
+            "{\"success\": false, \"message\": \"Invalid session\"}"};
+}
+
+static HttpResponse body_too_large_response() {
+    return {413, "Payload Too Large", {{"Content-Type", "application/json"}},
+            "{\"success\": false, \"message\": \"Request body too large\"}"};
+}
+
+// Auth middleware for ROUTE_AUTH routes: validates the session once so handlers can trust request.username
+bool WebServer::authenticate(HttpRequest& request) {
+    std::string token = extract_session_token(request);
+    const std::string* username = session_username(token);
+    if (!username) {
+        return false;
     }
-    
-    oss << "Content-Length: " << response.body.length() << "\r\n";
-    oss << "\r\n";
-    oss << response.body;
-    
-    return oss.str();
+    request.username = *username;
+    request.session_token = std::move(token);
+    return true;
+}
+
+// HTTP parsing
+HttpRequest WebServer::parse_http_request(const std::string& request) {
+    // One-shot parse of a fully buffered request; the event loop drives HttpParser incrementally
+    HttpParser parser(config.http_limits);
+    parser.parse(request);
+    return parser.take_request();
 }
 
 // Route handlers
-HttpResponse WebServer::handle_static_file(const std::string& path) {
-    std::string file_path = "frontend" + path;
-    if (path == "/") file_path = "frontend/index.html";
-    
-    if (!fs::exists(file_path)) {
+HttpResponse WebServer::handle_static_file(const HttpRequest& request) {
+    // Only files present in the cache snapshot are servable, which also rules out path traversal
+    std::shared_ptr<const StaticAsset> asset = static_cache->find(request.path);
+    if (!asset) {
         return {404, "Not Found", {{"Content-Type", "text/plain"}}, "File not found"};
     }
     
-    std::string content = read_file_content(file_path);
-    return {200, "OK", {{"Content-Type", get_mime_type(file_path)}}, content};
+    HttpResponse response{200, "OK", {{"Content-Type", asset->mime_type},
+                                      {"ETag", asset->etag},
+                                      {"Last-Modified", asset->last_modified},
+                                      {"Cache-Control", "no-cache"},
+                                      {"Vary", "Accept-Encoding"}}, ""};
+    
+    // Pick the representation first: each coding has its own tag
+    auto ae_it = request.headers.find("Accept-Encoding");
+    std::string accept_encoding = (ae_it != request.headers.end()) ? ae_it->second : "";
+    if (asset->brotli && accepts_encoding(accept_encoding, "br")) {
+        response.headers["Content-Encoding"] = "br";
+        response.headers["ETag"] = asset->brotli_etag;
+        response.shared_body = asset->brotli;
+    } else if (asset->gzip && accepts_encoding(accept_encoding, "gzip")) {
+        response.headers["Content-Encoding"] = "gzip";
+        response.headers["ETag"] = asset->gzip_etag;
+        response.shared_body = asset->gzip;
+    } else {
+        response.shared_body = asset->identity;
+    }
+    
+    // Revalidation: the browser already has this exact representation
+    auto inm_it = request.headers.find("If-None-Match");
+    if (inm_it != request.headers.end() && etag_matches(inm_it->second, response.headers["ETag"])) {
+        response.status_code = 304;
+        response.status_text = "Not Modified";
+        response.shared_body = nullptr;
+        return response;
+    }
+    
+    if (!asset->identity) {
+        // Too large to cache: stream straight from disk with sendfile()
+        int fd = open(asset->file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return {404, "Not Found", {{"Content-Type", "text/plain"}}, "File not found"};
+        }
+        struct stat st;
+        fstat(fd, &st);
+        response.file_body = std::make_shared<FileBody>(fd, 0, st.st_size);
+    }
+    return response;
 }
 
 HttpResponse WebServer::handle_login(const HttpRequest& request) {
@@ -387,27 +509,21 @@ HttpResponse WebServer::handle_login(const HttpRequest& request) {
     std::string username = form_data["username"];
     std::string password = form_data["password"];
     
-    auto it = users.find(username);
-    if (it == users.end() || !verify_password(password, it->second.password_hash)) {
+    if (!check_credentials(username, password)) {
         return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Invalid credentials\"}"};
     }
     
     // Create session
-    Session session;
-    session.token = generate_session_token();
-    session.username = username;
-    session.created = time(nullptr);
-    session.last_activity = time(nullptr);
-    session.current_directory = get_user_home_directory(username);
-    
-    sessions[session.token] = session;
-    it->second.session_token = session.token;
-    it->second.last_activity = time(nullptr);
+    std::string token;
+    if (!start_session(username, token)) {
+        return {503, "Service Unavailable", {{"Content-Type", "application/json"}}, 
+                "{\"success\": false, \"message\": \"Too many active sessions\"}"};
+    }
     
     HttpResponse response{200, "OK", {{"Content-Type", "application/json"}}, 
                          "{\"success\": true, \"message\": \"Login successful\"}"};
-    response.headers["Set-Cookie"] = "session=" + session.token + "; Path=/; HttpOnly";
+    response.headers["Set-Cookie"] = "session=" + token + "; Path=/; HttpOnly";
     
     return response;
 }
@@ -431,12 +547,12 @@ HttpResponse WebServer::handle_register(const HttpRequest& request) {
     std::string username = form_data["username"];
     std::string password = form_data["password"];
     
-    std::cout << "Registration attempt for username: " << username << std::endl;
-    std::cout << "Current users count: " << users.size() << std::endl;
+    LOG_DEBUG << "Registration attempt for username: " << username;
+    LOG_DEBUG << "Current users count: " << users.size();
     
     // Check if username already exists
-    if (users.find(username) != users.end()) {
-        std::cout << "Username already exists: " << username << std::endl;
+    if (users.contains(username)) {
+        LOG_DEBUG << "Username already exists: " << username;
         return {409, "Conflict", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Username already exists\"}"};
     }
@@ -444,32 +560,34 @@ HttpResponse WebServer::handle_register(const HttpRequest& request) {
     // Create new user
     User user;
     user.username = username;
-    user.password_hash = hash_password(password);
+    user.password_hash = hash_password(password, config.password_kdf);
     user.filesystem_path = create_user_filesystem(username);
     user.last_activity = time(nullptr);
     
-    users[username] = user;
+    // Insert-if-absent closes the race between concurrent registrations
+    if (!users.insert(user)) {
+        LOG_DEBUG << "Username already exists: " << username;
+        return {409, "Conflict", {{"Content-Type", "application/json"}}, 
+                "{\"success\": false, \"message\": \"Username already exists\"}"};
+    }
     
     // Create system user for terminal access
     if (!create_system_user(username)) {
-        std::cout << "Warning: Failed to create system user for: " << username << std::endl;
+        LOG_WARN << "Failed to create system user for: " << username;
         // Don't fail registration, just log warning
     }
     
-    std::cout << "User created successfully: " << username << std::endl;
-    std::cout << "Total users after creation: " << users.size() << std::endl;
-    
-    // Save users immediately after registration
-    save_users();
+    LOG_INFO << "User created successfully: " << username;
+    LOG_DEBUG << "Total users after creation: " << users.size();
     
     return {200, "OK", {{"Content-Type", "application/json"}}, 
             "{\"success\": true, \"message\": \"Registration successful\"}"};
 }
 
 HttpResponse WebServer::handle_logout(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!token.empty()) {
-        sessions.erase(token);
+    SessionToken token;
+    if (SessionToken::parse(extract_session_token(request), token)) {
+        sessions.remove(token);
     }
     
     HttpResponse response{200, "OK", {{"Content-Type", "application/json"}}, 
@@ -480,59 +598,304 @@ HttpResponse WebServer::handle_logout(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_get_files(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
+    auto param = [&](const char* name) { return query_param(request, name); };
     
     // Get the requested path from query parameters
-    auto path_it = request.query_params.find("path");
-    std::string requested_path = (path_it != request.query_params.end()) ? path_it->second : "";
+    std::string requested_path = param("path") ? *param("path") : "";
+    if (!normalize_relative_path(requested_path)) {
+        return {400, "Bad Request", {{"Content-Type", "application/json"}},
+                "{\"success\": false, \"message\": \"Invalid path\"}"};
+    }
+    
+    ListingQuery query;
+    unsigned fields = LISTING_ALL_FIELDS;
+    bool valid = true;
+    if (const std::string* sort = param("sort")) valid = parse_listing_sort(*sort, query.sort, query.descending);
+    if (const std::string* selected = param("fields")) valid = valid && parse_listing_fields(*selected, fields);
+    if (const std::string* limit = param("limit")) valid = valid && parse_limit(*limit, query.limit, MAX_LISTING_PAGE);
+    if (const std::string* cursor = param("cursor")) query.cursor = *cursor;
+    const std::string* all_files = param("allFiles");
+    if (all_files) valid = valid && (*all_files == "true" || *all_files == "false");
+    if (!valid) {
+        return {400, "Bad Request", {{"Content-Type", "application/json"}},
+                "{\"success\": false, \"message\": \"Invalid sort, fields, limit or allFiles\"}"};
+    }
+    
+    LOG_DEBUG << "Listing files for user " << username << " in path '" << requested_path << "'";
+    
+    // The requested page, then on the first page the top level again as
+    // allFiles for search. Both are metadata only and streamed a batch of
+    // entries at a time.
+    struct Listing {
+        ListingPage files;
+        ListingPage top_level;
+        const std::vector<ListingEntry>* all_files = nullptr;  // Null when there is no allFiles section
+        std::string relative_dir;
+        unsigned fields;
+        int section = 0;                // 0: not started, 1: files, 2: allFiles
+        size_t next = 0;
+    };
+    auto listing = std::make_shared<Listing>();
+    listing->relative_dir = requested_path;
+    listing->fields = fields;
+    
+    // A directory that does not exist lists as empty
+    if (!list_workspace(username, requested_path, query, listing->files) && errno == EINVAL) {
+        return {400, "Bad Request", {{"Content-Type", "application/json"}},
+                "{\"success\": false, \"message\": \"Invalid cursor\"}"};
+    }
+    if (query.cursor.empty() && !(all_files && *all_files == "false")) {
+        if (requested_path.empty() && query.limit == 0) {
+            listing->all_files = &listing->files.entries;
+        } else {
+            list_workspace(username, "", ListingQuery(), listing->top_level);
+            listing->all_files = &listing->top_level.entries;
+        }
+    }
     
-    std::vector<FileInfo> files = list_user_files(username, requested_path);
-    std::vector<FileInfo> all_files = list_user_files(username, ""); // All files for search
+    HttpResponse response{200, "OK", {{"Content-Type", "application/json"}}, ""};
+    response.stream = [listing](std::string& chunk) {
+        if (listing->section == 0) {
+            chunk += "{\"success\": true, \"files\": [";
+            listing->section = 1;
+        }
+        
+        bool top_level = listing->section == 2;
+        const std::vector<ListingEntry>& entries = top_level ? *listing->all_files : listing->files.entries;
+        std::string relative_dir = top_level ? "" : listing->relative_dir;
+        size_t end = std::min(entries.size(), listing->next + STREAM_BATCH_ENTRIES);
+        for (; listing->next < end; listing->next++) {
+            if (listing->next != 0) chunk += ",";
+            append_listing_entry(chunk, entries[listing->next], relative_dir, listing->fields);
+        }
+        if (listing->next < entries.size()) return true;
+        
+        chunk += "]";
+        if (top_level) {
+            chunk += "}";
+            return false;
+        }
+        if (!listing->files.next_cursor.empty()) {
+            chunk += ", \"nextCursor\": \"" + listing->files.next_cursor + "\"";
+        }
+        if (!listing->all_files) {
+            chunk += "}";
+            return false;
+        }
+        chunk += ", \"allFiles\": [";
+        listing->section = 2;
+        listing->next = 0;
+        return true;
+    };
+    return response;
+}
+
+// Quick-open: fuzzy match q against every path in the workspace
+HttpResponse WebServer::handle_find(const HttpRequest& request) {
+    const std::string& username = request.username;
+    const std::string* q = query_param(request, "q");
+    std::string query = q ? *q : "";
     
-    std::cout << "Listing files for user " << username << " in path '" << requested_path << "': " << files.size() << " items found" << std::endl;
+    size_t limit = DEFAULT_FIND_RESULTS;
+    const std::string* limit_text = query_param(request, "limit");
+    if (limit_text && !parse_limit(*limit_text, limit, MAX_FIND_RESULTS)) {
+        return {400, "Bad Request", {{"Content-Type", "application/json"}},
+                "{\"success\": false, \"message\": \"Invalid limit\"}"};
+    }
+    
+    std::shared_ptr<const PathList> paths;
+    if (workspace_index->paths(username, paths) != WorkspaceIndex::Result::FOUND) {
+        auto walked = std::make_shared<PathList>();
+        list_paths(data_dir + "/users/" + username, *walked);
+        paths = std::move(walked);
+    }
+    std::vector<FuzzyMatch> matches;
+    size_t total = fuzzy_find(*paths, query, limit, matches);
+    
+    std::string body = "{\"success\": true, \"total\": " + std::to_string(total) + ", \"results\": [";
+    for (size_t i = 0; i < matches.size(); i++) {
+        const FuzzyMatch& match = matches[i];
+        std::string_view path = paths->path(match.index);
+        size_t slash = path.rfind('/');
+        body += i == 0 ? "{\"path\":" : ",{\"path\":";
+        append_json_string(body, path);
+        body += ",\"name\":";
+        append_json_string(body, slash == std::string_view::npos ? path : path.substr(slash + 1));
+        body += ",\"isDirectory\":";
+        body += paths->is_directory(match.index) ? "true" : "false";
+        body += ",\"score\":" + std::to_string(match.score) + ",\"positions\":[";
+        for (size_t j = 0; j < match.positions.size(); j++) {
+            if (j != 0) body += ",";
+            body += std::to_string(match.positions[j]);
+        }
+        body += "]}";
+    }
+    body += "]}";
+    return {200, "OK", {{"Content-Type", "application/json"}}, body};
+}
+
+// Grep the workspace, streaming one JSON object per matching line and a summary last
+HttpResponse WebServer::handle_search(const HttpRequest& request) {
+    const std::string& username = request.username;
+    auto param = [&](const char* name) { return query_param(request, name); };
+    auto bad_request = [](const std::string& message) {
+        std::string body = "{\"success\": false, \"message\": ";
+        append_json_string(body, message);
+        body += "}";
+        return HttpResponse{400, "Bad Request", {{"Content-Type", "application/json"}}, body};
+    };
+    auto flag = [&](const char* name, bool& value) {
+        const std::string* text = param(name);
+        if (!text) return true;
+        value = *text == "true";
+        return *text == "true" || *text == "false";
+    };
+    auto number = [&](const char* name, size_t& value, size_t min, size_t max) {
+        const std::string* text = param(name);
+        return !text || parse_limit(*text, value, max, min);
+    };
+
+    bool regex = false, ignore_case = false;
+    SearchOptions options;
+    options.max_matches = DEFAULT_SEARCH_MATCHES;
+    if (!flag("regex", regex) || !flag("ignoreCase", ignore_case) ||
+        !number("limit", options.max_matches, 1, MAX_SEARCH_MATCHES) ||
+        !number("context", options.context_lines, 0, MAX_SEARCH_CONTEXT)) {
+        return bad_request("Invalid regex, ignoreCase, limit or context");
+    }
+    std::string prefix = param("path") ? *param("path") : "";
+    if (!normalize_relative_path(prefix)) {
+        return bad_request("Invalid path");
+    }
+
+    auto pattern = std::make_shared<SearchPattern>();
+    std::string error;
+    if (!pattern->compile(param("q") ? *param("q") : "", regex, ignore_case, error)) {
+        return bad_request(error);
+    }
+
+    std::string root = data_dir + "/users/" + username;
+    std::shared_ptr<const PathList> paths;
+    std::vector<FileStamp> stamps;
+    if (workspace_index->paths(username, paths, stamps) != WorkspaceIndex::Result::FOUND) {
+        auto walked = std::make_shared<PathList>();
+        stamps.clear();
+        list_paths(root, *walked, &stamps);
+        paths = std::move(walked);
+    }
+    std::vector<SearchFile> files;
+    for (size_t i = 0; i < paths->size(); i++) {
+        std::string_view path = paths->path(i);
+        if (paths->is_directory(i)) continue;
+        if (!prefix.empty() && (path.compare(0, prefix.size(), prefix) != 0 ||
+                                (path.size() > prefix.size() && path[prefix.size()] != '/'))) {
+            continue;
+        }
+        files.push_back({std::string(path), stamps[i]});
+    }
+    size_t pruned = content_index->select(username, files, pattern->trigrams(), prefix.empty());
+
+    LOG_DEBUG << "Searching " << files.size() << " files for user " << username << ", " << pruned << " ruled out";
+    auto job = std::make_shared<SearchJob>(root, std::move(files), pattern, options, content_index.get(), username,
+                                           pruned);
+    job->start(*search_pool);
+
+    // Cancels the search when the stream ends, including on disconnect
+    struct Search {
+        std::shared_ptr<SearchJob> job;
+        Metrics& metrics;
+        uint64_t start_us = monotonic_us();
+
+        Search(std::shared_ptr<SearchJob> job, Metrics& metrics) : job(std::move(job)), metrics(metrics) {}
+        ~Search() { job->cancel(); }
+    };
+    auto search = std::make_shared<Search>(job, metrics);
+    HttpResponse response{200, "OK", {{"Content-Type", "application/x-ndjson"}}, ""};
+    response.stream = [search](std::string& chunk) {
+        if (search->job->take(chunk)) return true;
+        search->metrics.record_operation(Operation::CONTENT_SEARCH, monotonic_us() - search->start_us);
+        return false;
+    };
+    // While the search has nothing new the stream is parked, not polled from a worker
+    response.stream_wait = [search](std::function<void()> resume) { return search->job->wait(std::move(resume)); };
+    return response;
+}
+
+// File bytes as they are on disk, sent with sendfile(), with single byte ranges
+HttpResponse WebServer::handle_get_raw_file(const HttpRequest& request) {
+    const std::string& username = request.username;
+    const std::string* name = query_param(request, "filename");
+    std::string filename = name ? *name : "";
     
-    std::ostringstream json;
-    json << "{\"success\": true, \"files\": [";
-    for (size_t i = 0; i < files.size(); i++) {
-        if (i > 0) json << ",";
-        json << "{\"name\":\"" << files[i].name << "\","
-             << "\"fullPath\":\"" << files[i].path << "\","
-             << "\"size\":" << files[i].size << ","
-             << "\"lastModified\":" << files[i].last_modified << ","
-             << "\"isDirectory\":" << (files[i].is_directory ? "true" : "false") << ","
-             << "\"path\":\"" << files[i].path << "\"}";
-    }
-    json << "], \"allFiles\": [";
-    for (size_t i = 0; i < all_files.size(); i++) {
-        if (i > 0) json << ",";
-        json << "{\"name\":\"" << all_files[i].name << "\","
-             << "\"fullPath\":\"" << all_files[i].path << "\","
-             << "\"size\":" << all_files[i].size << ","
-             << "\"lastModified\":" << all_files[i].last_modified << ","
-             << "\"isDirectory\":" << (all_files[i].is_directory ? "true" : "false") << ","
-             << "\"path\":\"" << all_files[i].path << "\"}";
+    if (!normalize_relative_path(filename)) {
+        return {400, "Bad Request", {{"Content-Type", "application/json"}},
+                "{\"success\": false, \"message\": \"Invalid filename\"}"};
+    }
+    if (filename.empty()) {
+        return {400, "Bad Request", {{"Content-Type", "application/json"}},
+                "{\"success\": false, \"message\": \"Filename required\"}"};
     }
-    json << "]}";
     
-    return {200, "OK", {{"Content-Type", "application/json"}}, json.str()};
+    int fd = open((data_dir + "/users/" + username + "/" + filename).c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        return {404, "Not Found", {{"Content-Type", "application/json"}},
+                "{\"success\": false, \"message\": \"File not found\"}"};
+    }
+    auto file = std::make_shared<FileBody>(fd, 0, st.st_size);
+    
+    // Validators from metadata, as for uncached static files
+    std::string etag = weak_etag(st);
+    std::string last_modified = http_date(st.st_mtime);
+    // Unknown types are not guessed as text: they download as opaque bytes
+    HttpResponse response{200, "OK", {{"Content-Type", mime_type_for(filename, "application/octet-stream")},
+                                      {"ETag", etag},
+                                      {"Last-Modified", last_modified},
+                                      {"Accept-Ranges", "bytes"},
+                                      {"Cache-Control", "no-cache"},
+                                      // User content on our origin: never sniffed or run as a page
+                                      {"X-Content-Type-Options", "nosniff"},
+                                      {"Content-Security-Policy", "sandbox"}}, ""};
+    
+    auto inm_it = request.headers.find("If-None-Match");
+    if (inm_it != request.headers.end() && etag_matches(inm_it->second, etag)) {
+        response.status_code = 304;
+        response.status_text = "Not Modified";
+        return response;
+    }
+    
+    // If-Range needs a strong validator, so only the date form can match
+    auto range_it = request.headers.find("Range");
+    auto if_range_it = request.headers.find("If-Range");
+    uint64_t offset = 0, length = 0;
+    bool satisfiable = false;
+    if (range_it != request.headers.end() &&
+        (if_range_it == request.headers.end() || if_range_it->second == last_modified) &&
+        parse_byte_range(range_it->second, st.st_size, offset, length, satisfiable)) {
+        if (!satisfiable) {
+            response.status_code = 416;
+            response.status_text = "Range Not Satisfiable";
+            response.headers["Content-Range"] = "bytes */" + std::to_string(st.st_size);
+            return response;
+        }
+        response.status_code = 206;
+        response.status_text = "Partial Content";
+        response.headers["Content-Range"] = "bytes " + std::to_string(offset) + "-" +
+                                            std::to_string(offset + length - 1) + "/" + std::to_string(st.st_size);
+        file->offset = offset;
+        file->length = length;
+    }
+    response.file_body = std::move(file);
+    return response;
 }
 
 HttpResponse WebServer::handle_get_file(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     auto it = request.query_params.find("filename");
     std::string filename = (it != request.query_params.end()) ? it->second : "";
     
@@ -542,27 +905,54 @@ HttpResponse WebServer::handle_get_file(const HttpRequest& request) {
     }
     
     std::string file_path = data_dir + "/users/" + username + "/" + filename;
-    if (!fs::exists(file_path)) {
+    if (!workspace_entry_exists(username, filename)) {
         return {404, "Not Found", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"File not found\"}"};
     }
     
-    std::string content = read_file_content(file_path);
-    std::ostringstream json;
-    json << "{\"success\": true, \"content\":\"" << url_encode(content) << "\"}";
-    
-    return {200, "OK", {{"Content-Type", "application/json"}}, json.str()};
+    HttpResponse response{200, "OK", {{"Content-Type", "application/json"}}, ""};
+    response.stream = stream_encoded_file(file_path, "{\"success\": true, \"content\":\"", "\"}", false);
+    return response;
+}
+
+// Stream prefix, the url-encoded file contents and suffix, one block per chunk
+BodyProducer WebServer::stream_encoded_file(const std::string& file_path, std::string prefix, std::string suffix,
+                                            bool remove_when_done) {
+    struct EncodedFile {
+        std::string path;
+        std::ifstream file;
+        std::string prefix;
+        std::string suffix;
+        bool remove_when_done;
+        
+        ~EncodedFile() {
+            // Also runs when the client disconnects mid-stream
+            if (remove_when_done) std::remove(path.c_str());
+        }
+    };
+    auto state = std::make_shared<EncodedFile>();
+    state->path = file_path;
+    state->file.open(file_path, std::ios::binary);
+    state->prefix = std::move(prefix);
+    state->suffix = std::move(suffix);
+    state->remove_when_done = remove_when_done;
+    
+    return [this, state](std::string& chunk) {
+        chunk.swap(state->prefix);
+        
+        std::string block(STREAM_BLOCK_SIZE, '\0');
+        state->file.read(&block[0], block.size());
+        block.resize(state->file.gcount());
+        chunk += url_encode(block);
+        if (state->file) return true;
+        
+        chunk += state->suffix;
+        return false;
+    };
 }
 
 HttpResponse WebServer::handle_save_file(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     std::string body = request.body;
     std::map<std::string, std::string> form_data;
@@ -598,19 +988,11 @@ HttpResponse WebServer::handle_save_file(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_create_file(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        std::cout << "Create file: Invalid session token" << std::endl;
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
-    std::cout << "Create file request from user: " << username << std::endl;
+    const std::string& username = request.username;
+    LOG_DEBUG << "Create file request from user: " << username;
     
     std::string body = request.body;
-    std::cout << "Request body: " << body << std::endl;
+    LOG_DEBUG << "Request body: " << body;
     
     std::map<std::string, std::string> form_data;
     
@@ -623,7 +1005,7 @@ HttpResponse WebServer::handle_create_file(const HttpRequest& request) {
             std::string key = url_decode(param.substr(0, equal_pos));
             std::string value = url_decode(param.substr(equal_pos + 1));
             form_data[key] = value;
-            std::cout << "Parsed form data: " << key << " = " << value << std::endl;
+            LOG_DEBUG << "Parsed form data: " << key << " = " << value;
         }
     }
     
@@ -631,7 +1013,7 @@ HttpResponse WebServer::handle_create_file(const HttpRequest& request) {
     std::string path = form_data["path"];
     
     if (filename.empty()) {
-        std::cout << "Create file: No filename provided" << std::endl;
+        LOG_DEBUG << "Create file: No filename provided";
         return {400, "Bad Request", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Filename required\"}"};
     }
@@ -643,40 +1025,33 @@ HttpResponse WebServer::handle_create_file(const HttpRequest& request) {
     }
     
     std::string file_path = target_dir + "/" + filename;
-    std::cout << "Creating file: " << file_path << std::endl;
+    LOG_DEBUG << "Creating file: " << file_path;
     
     // Ensure target directory exists
     if (!fs::exists(target_dir)) {
-        std::cout << "Creating target directory: " << target_dir << std::endl;
+        LOG_DEBUG << "Creating target directory: " << target_dir;
         fs::create_directories(target_dir);
     }
     
-    if (fs::exists(file_path)) {
-        std::cout << "File already exists: " << file_path << std::endl;
+    if (workspace_entry_exists(username, path.empty() ? filename : path + "/" + filename)) {
+        LOG_DEBUG << "File already exists: " << file_path;
         return {409, "Conflict", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"File already exists\"}"};
     }
     
     if (write_file_content(file_path, "")) {
-        std::cout << "File created successfully: " << file_path << std::endl;
+        LOG_DEBUG << "File created successfully: " << file_path;
         return {200, "OK", {{"Content-Type", "application/json"}}, 
                 "{\"success\": true, \"message\": \"File created successfully\"}"};
     } else {
-        std::cout << "Failed to create file: " << file_path << std::endl;
+        LOG_WARN << "Failed to create file: " << file_path;
         return {500, "Internal Server Error", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Failed to create file\"}"};
     }
 }
 
 HttpResponse WebServer::handle_delete_file(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     auto it = request.query_params.find("filename");
     std::string filename = (it != request.query_params.end()) ? it->second : "";
     
@@ -686,7 +1061,7 @@ HttpResponse WebServer::handle_delete_file(const HttpRequest& request) {
     }
     
     std::string file_path = data_dir + "/users/" + username + "/" + filename;
-    if (!fs::exists(file_path)) {
+    if (!workspace_entry_exists(username, filename)) {
         return {404, "Not Found", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"File not found\"}"};
     }
@@ -700,242 +1075,176 @@ HttpResponse WebServer::handle_delete_file(const HttpRequest& request) {
     }
 }
 
-HttpResponse WebServer::handle_index() {
-    return handle_static_file("/");
-}
+HttpResponse WebServer::handle_index(const HttpRequest& request) {
+    return handle_static_file(request);
+}
+
+HttpResponse WebServer::handle_metrics(const HttpRequest&) {
+    uint64_t bytes_read = 0, bytes_written = 0, accepted = 0, closed = 0, refused = 0, timed_out = 0;
+    for (const auto& loop : loops) {
+        bytes_read += loop->bytes_read.load(std::memory_order_relaxed);
+        bytes_written += loop->bytes_written.load(std::memory_order_relaxed);
+        accepted += loop->connections_accepted.load(std::memory_order_relaxed);
+        closed += loop->connections_closed.load(std::memory_order_relaxed);
+        refused += loop->connections_refused.load(std::memory_order_relaxed);
+        timed_out += loop->connections_timed_out.load(std::memory_order_relaxed);
+    }
+
+    std::string extra;
+    Metrics::render_value(extra, "webeditor_received_bytes_total", "counter", "Request bytes read from clients", bytes_read);
+    Metrics::render_value(extra, "webeditor_sent_bytes_total", "counter", "Response bytes written to clients", bytes_written);
+    Metrics::render_value(extra, "webeditor_connections_accepted_total", "counter", "Connections accepted", accepted);
+    Metrics::render_value(extra, "webeditor_connections_refused_total", "counter",
+                          "Connections closed on accept for exceeding the per-IP cap", refused);
+    Metrics::render_value(extra, "webeditor_connections_timed_out_total", "counter",
+                          "Connections closed by a header, body, idle or write deadline", timed_out);
+    Metrics::render_value(extra, "webeditor_connections_open", "gauge", "Connections currently open",
+                          accepted >= closed ? accepted - closed : 0);
+    Metrics::render_value(extra, "webeditor_requests_in_progress", "gauge", "Requests queued for or running in a handler",
+                          requests_in_progress.load(std::memory_order_relaxed));
+    Metrics::render_value(extra, "webeditor_worker_queue_depth", "gauge", "Tasks waiting for a request worker",
+                          pool->pending());
+    Metrics::render_value(extra, "webeditor_crypto_queue_depth", "gauge", "Tasks waiting for a password hashing worker",
+                          crypto_pool->pending());
+    Metrics::render_value(extra, "webeditor_sessions_active", "gauge", "Live login sessions", sessions.size());
+    Metrics::render_value(extra, "webeditor_users", "gauge", "Registered users", users.size());
+    Metrics::render_value(extra, "webeditor_workspace_index_bytes", "gauge", "Memory held by indexed workspace trees",
+                          workspace_index->memory_used());
+    Metrics::render_value(extra, "webeditor_workspace_index_users", "gauge", "Workspaces currently indexed",
+                          workspace_index->user_count());
+    Metrics::render_value(extra, "webeditor_search_index_bytes", "gauge", "Memory held by content search filters",
+                          content_index->memory_used());
+    Metrics::render_value(extra, "webeditor_search_index_users", "gauge", "Workspaces with content search filters",
+                          content_index->user_count());
+
+    return {200, "OK", {{"Content-Type", "text/plain; version=0.0.4; charset=utf-8"}, {"Cache-Control", "no-store"}},
+            metrics.render(extra)};
+}
+
+// Request routing
+const Route<WebServer::RouteHandler>* WebServer::find_route(const HttpRequest& request, uint32_t& route_id,
+                                                            std::map<std::string, std::string>* params) {
+    static constexpr Route<RouteHandler> route_list[] = {
+        {"GET",    "/",                      &WebServer::handle_index,            ROUTE_PUBLIC, 0},
+        {"POST",   "/api/login",             &WebServer::handle_login,            ROUTE_CRYPTO, 64 * 1024},
+        {"POST",   "/api/register",          &WebServer::handle_register,         ROUTE_CRYPTO, 64 * 1024},
+        {"POST",   "/api/auth",              &WebServer::handle_auth,             ROUTE_CRYPTO, 64 * 1024},
+        {"POST",   "/api/validate-session",  &WebServer::handle_validate_session, ROUTE_PUBLIC, 64 * 1024},
+        {"POST",   "/api/logout",            &WebServer::handle_logout,           ROUTE_PUBLIC, 0},
+        {"GET",    "/api/files",             &WebServer::handle_get_files,        ROUTE_AUTH,   0},
+        {"GET",    "/api/file",              &WebServer::handle_get_file,         ROUTE_AUTH,   0},
+        {"GET",    "/api/raw",               &WebServer::handle_get_raw_file,     ROUTE_AUTH,   0},
+        {"GET",    "/api/find",              &WebServer::handle_find,             ROUTE_AUTH,   0},
+        {"GET",    "/api/search",            &WebServer::handle_search,           ROUTE_AUTH,   0},
+        {"POST",   "/api/save",              &WebServer::handle_save_file,        ROUTE_AUTH,   0},
+        {"POST",   "/api/create",            &WebServer::handle_create_file,      ROUTE_AUTH,   64 * 1024},
+        {"POST",   "/api/create-dir",        &WebServer::handle_create_directory, ROUTE_AUTH,   64 * 1024},
+        {"POST",   "/api/upload",            &WebServer::handle_upload_file,      ROUTE_AUTH,   0},
+        {"DELETE", "/api/delete",            &WebServer::handle_delete_file,      ROUTE_AUTH,   0},
+        {"POST",   "/api/init-repo",         &WebServer::handle_init_repo,        ROUTE_AUTH,   64 * 1024},
+        {"POST",   "/api/commit",            &WebServer::handle_commit,           ROUTE_AUTH,   64 * 1024},
+        {"GET",    "/api/history",           &WebServer::handle_get_history,      ROUTE_AUTH,   0},
+        {"POST",   "/api/checkout",          &WebServer::handle_checkout,         ROUTE_AUTH,   64 * 1024},
+        {"POST",   "/api/create-branch",     &WebServer::handle_create_branch,    ROUTE_AUTH,   64 * 1024},
+        {"POST",   "/api/switch-branch",     &WebServer::handle_switch_branch,    ROUTE_AUTH,   64 * 1024},
+        {"POST",   "/api/save-api-key",      &WebServer::handle_save_api_key,     ROUTE_AUTH,   64 * 1024},
+        {"GET",    "/api/get-api-key",       &WebServer::handle_get_api_key,      ROUTE_AUTH,   0},
+        {"POST",   "/api/terminal/execute",  &WebServer::handle_terminal_execute, ROUTE_AUTH,   64 * 1024},
+        {"GET",    "/api/metrics",           &WebServer::handle_metrics,          ROUTE_METRICS, 0},
+    };
+    static constexpr auto routes = make_route_table(route_list);
+    static_assert(ROUTE_ID_FIRST + routes.size() <= Metrics::MAX_ROUTES, "raise Metrics::MAX_ROUTES");
 
-// User data persistence
-void WebServer::load_users() {
-    std::string users_file = data_dir + "/users.txt";
-    std::cout << "Loading users from: " << users_file << std::endl;
-    
-    std::ifstream file(users_file);
-    if (!file.is_open()) {
-        std::cout << "No users file found, starting with empty user list" << std::endl;
-        return;
-    }
-    
-    std::string line;
-    int user_count = 0;
-    int line_number = 0;
-    
-    while (std::getline(file, line)) {
-        line_number++;
-        if (line.empty()) continue;
-        
-        try {
-            std::istringstream line_stream(line);
-            User user;
-            
-            if (!std::getline(line_stream, user.username, '|')) {
-                std::cout << "Warning: Invalid user data at line " << line_number << std::endl;
-                continue;
-            }
-            
-            if (!std::getline(line_stream, user.password_hash, '|')) {
-                std::cout << "Warning: Invalid password hash at line " << line_number << std::endl;
-                continue;
-            }
-            
-            if (!std::getline(line_stream, user.filesystem_path, '|')) {
-                std::cout << "Warning: Invalid filesystem path at line " << line_number << std::endl;
-                continue;
-            }
-            
-            std::string last_activity_str;
-            if (!std::getline(line_stream, last_activity_str, '|')) {
-                std::cout << "Warning: Invalid last activity at line " << line_number << std::endl;
-                continue;
-            }
-            
-            try {
-                user.last_activity = std::stol(last_activity_str);
-            } catch (const std::exception& e) {
-                std::cout << "Warning: Invalid timestamp at line " << line_number << ", using current time" << std::endl;
-                user.last_activity = time(nullptr);
-            }
-            
-            // Load API key fields (optional, for backward compatibility)
-            if (std::getline(line_stream, user.api_key, '|')) {
-                if (std::getline(line_stream, user.api_provider, '|')) {
-                    if (std::getline(line_stream, user.api_model, '|')) {
-                        // All API key fields present
-                    } else {
-                        user.api_model = "gpt-3.5-turbo"; // Default
-                    }
-                } else {
-                    user.api_provider = "openai"; // Default
-                    user.api_model = "gpt-3.5-turbo"; // Default
-                }
-            } else {
-                user.api_key = ""; // Default
-                user.api_provider = "openai"; // Default
-                user.api_model = "gpt-3.5-turbo"; // Default
-            }
-            
-            users[user.username] = user;
-            user_count++;
-            std::cout << "Loaded user: " << user.username << std::endl;
-        } catch (const std::exception& e) {
-            std::cout << "Error parsing user data at line " << line_number << ": " << e.what() << std::endl;
-        }
-    }
-    std::cout << "Loaded " << user_count << " users successfully" << std::endl;
+    const Route<RouteHandler>* route = routes.match(request.method, request.path, params);
+    if (route) route_id = ROUTE_ID_FIRST + (uint32_t)routes.index_of(route);
+    return route;
 }
 
-void WebServer::save_users() {
-    std::string users_file = data_dir + "/users.txt";
-    std::cout << "Saving users to: " << users_file << std::endl;
-    
-    // Ensure the data directory exists
-    if (!fs::exists(data_dir)) {
-        std::cout << "Creating data directory: " << data_dir << std::endl;
-        fs::create_directories(data_dir);
-    }
-    
-    std::ofstream file(users_file);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open users file for writing: " << users_file << std::endl;
-        return;
-    }
-    
-    int user_count = 0;
-    for (const auto& pair : users) {
-        const User& user = pair.second;
-        file << user.username << "|" << user.password_hash << "|" 
-             << user.filesystem_path << "|" << user.last_activity << "|"
-             << user.api_key << "|" << user.api_provider << "|" << user.api_model << "\n";
-        user_count++;
-        std::cout << "Saved user: " << user.username << std::endl;
-    }
-    std::cout << "Saved " << user_count << " users successfully" << std::endl;
-    file.close();
+bool WebServer::requires_session(const Route<RouteHandler>& route) const {
+    // User, session and traffic counts are not for anonymous clients unless a scraper needs them
+    return (route.flags & ROUTE_AUTH) || ((route.flags & ROUTE_METRICS) && !config.metrics_public);
 }
 
-// Server lifecycle
-void WebServer::start() {
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd < 0) {
-        std::cerr << "Failed to create socket" << std::endl;
-        return;
+HttpResponse WebServer::route_request(HttpRequest& request, RequestTrace& trace) {
+    uint32_t route_id = 0;
+    const Route<RouteHandler>* route = find_route(request, route_id, &request.path_params);
+    if (!route) {
+        if (request.method == "GET") {
+            trace.route = {ROUTE_ID_STATIC, "GET", "static"};
+            return handle_static_file(request);
+        }
+        trace.route = {ROUTE_ID_UNMATCHED, "other", "unmatched"};
+        return {404, "Not Found", {{"Content-Type", "text/plain"}}, "Not Found"};
     }
+    trace.route = {route_id, route->method, route->pattern};
     
-    int opt = 1;
-    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    
-    sockaddr_in address = {AF_INET, htons(port), INADDR_ANY};
-    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
-        std::cerr << "Failed to bind socket" << std::endl;
-        return;
+    // Middleware, in RouteFlags order, then the route's body limit. A body
+    // that arrives in pieces was already screened by screen_request_head().
+    if (requires_session(*route)) {
+        uint64_t auth_start = monotonic_us();
+        bool authenticated = authenticate(request);
+        trace.add(RequestStage::AUTH, monotonic_us() - auth_start);
+        if (!authenticated) return invalid_session_response();
     }
-    
-    if (listen(server_fd, 10) < 0) {
-        std::cerr << "Failed to listen" << std::endl;
-        return;
+    if (route->max_body != 0 && request.body.size() > route->max_body) return body_too_large_response();
+    if (route->flags & ROUTE_CRYPTO) {
+        HttpResponse response;
+        response.deferred = [this, handler = route->handler, request = std::move(request)]() {
+            return (this->*handler)(request);
+        };
+        return response;
     }
     
-    std::cout << "Server started on port " << port << std::endl;
-    
-    while (true) {
-        int client_fd = accept(server_fd, nullptr, nullptr);
-        if (client_fd < 0) continue;
-        
-        char buffer[4096] = {0};
-        ssize_t bytes_read = read(client_fd, buffer, sizeof(buffer) - 1);
-        if (bytes_read <= 0) {
-            close(client_fd);
-            continue;
-        }
-        
-        std::string request_str(buffer, bytes_read);
-        HttpRequest request = parse_http_request(request_str);
-        
-        HttpResponse response;
-        
-        // Route handling
-        if (request.path == "/" && request.method == "GET") {
-            response = handle_index();
-        } else if (request.path == "/api/login" && request.method == "POST") {
-            response = handle_login(request);
-        } else if (request.path == "/api/register" && request.method == "POST") {
-            response = handle_register(request);
-        } else if (request.path == "/api/auth" && request.method == "POST") {
-            response = handle_auth(request);
-        } else if (request.path == "/api/validate-session" && request.method == "POST") {
-            response = handle_validate_session(request);
-        } else if (request.path == "/api/logout" && request.method == "POST") {
-            response = handle_logout(request);
-        } else if (request.path == "/api/files" && request.method == "GET") {
-            response = handle_get_files(request);
-        } else if (request.path == "/api/file" && request.method == "GET") {
-            response = handle_get_file(request);
-        } else if (request.path == "/api/save" && request.method == "POST") {
-            response = handle_save_file(request);
-        } else if (request.path == "/api/create" && request.method == "POST") {
-            response = handle_create_file(request);
-        } else if (request.path == "/api/create-dir" && request.method == "POST") {
-            response = handle_create_directory(request);
-        } else if (request.path == "/api/upload" && request.method == "POST") {
-            response = handle_upload_file(request);
-        } else if (request.path == "/api/delete" && request.method == "DELETE") {
-            response = handle_delete_file(request);
-        } else if (request.path == "/api/init-repo" && request.method == "POST") {
-            response = handle_init_repo(request);
-        } else if (request.path == "/api/commit" && request.method == "POST") {
-            response = handle_commit(request);
-        } else if (request.path == "/api/history" && request.method == "GET") {
-            response = handle_get_history(request);
-        } else if (request.path == "/api/checkout" && request.method == "POST") {
-            response = handle_checkout(request);
-        } else if (request.path == "/api/create-branch" && request.method == "POST") {
-            response = handle_create_branch(request);
-        } else if (request.path == "/api/switch-branch" && request.method == "POST") {
-            response = handle_switch_branch(request);
-        } else if (request.path == "/api/save-api-key" && request.method == "POST") {
-            response = handle_save_api_key(request);
-        } else if (request.path == "/api/get-api-key" && request.method == "GET") {
-            response = handle_get_api_key(request);
-        } else if (request.path == "/api/terminal/execute" && request.method == "POST") {
-            response = handle_terminal_execute(request);
-        } else if (request.method == "GET") {
-            response = handle_static_file(request.path);
-        } else {
-            response = {404, "Not Found", {{"Content-Type", "text/plain"}}, "Not Found"};
-        }
-        
-        std::string response_str = build_http_response(response);
-        send(client_fd, response_str.c_str(), response_str.length(), 0);
-        close(client_fd);
+    return (this->*route->handler)(request);
+}
+
+bool WebServer::screen_request_head(const HttpRequest& head, size_t& max_body, HttpResponse& refusal) {
+    uint32_t route_id = 0;
+    const Route<RouteHandler>* route = find_route(head, route_id, nullptr);
+    if (!route) return true;
+    if (requires_session(*route) && !session_username(extract_session_token(head))) {
+        refusal = invalid_session_response();
+        return false;
     }
+    if (route->max_body != 0) max_body = route->max_body;
+    return true;
 }
 
-void WebServer::stop() {
-    if (server_fd >= 0) {
-        close(server_fd);
-        server_fd = -1;
+HttpResponse WebServer::run_handler(const std::function<HttpResponse()>& handler) {
+    try {
+        return handler();
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Handler failed: " << e.what();
+        return {500, "Internal Server Error", {{"Content-Type", "text/plain"}}, "Internal Server Error"};
     }
 }
 
-// Global function
-void start_server(uint16_t port) {
-    g_server = new WebServer(port);
-    g_server->start();
+// In-process entry point: the event loop's worker path minus the socket and the pools
+HttpResponse WebServer::dispatch(HttpRequest request) {
+    RequestTrace trace;
+    trace.start_us = monotonic_us();
+    requests_in_progress.fetch_add(1, std::memory_order_relaxed);
+
+    HttpResponse response = run_handler([&]() { return route_request(request, trace); });
+    if (response.deferred) {
+        std::function<HttpResponse()> handler = std::move(response.deferred);
+        response = run_handler(handler);
+    }
+    uint64_t now = monotonic_us();
+    trace.add(RequestStage::HANDLER, now - trace.start_us - trace.stage_us[(size_t)RequestStage::AUTH]);
+    trace.status = response.status_code;
+
+    requests_in_progress.fetch_sub(1, std::memory_order_relaxed);
+    metrics.record_request(trace, now);
+    return response;
 }
 
 HttpResponse WebServer::handle_create_directory(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        std::cout << "Create directory: Invalid session token" << std::endl;
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
-    std::cout << "Create directory request from user: " << username << std::endl;
+    const std::string& username = request.username;
+    LOG_DEBUG << "Create directory request from user: " << username;
     
     std::string body = request.body;
-    std::cout << "Request body: " << body << std::endl;
+    LOG_DEBUG << "Request body: " << body;
     
     std::map<std::string, std::string> form_data;
     
@@ -948,7 +1257,7 @@ HttpResponse WebServer::handle_create_directory(const HttpRequest& request) {
             std::string key = url_decode(param.substr(0, equal_pos));
             std::string value = url_decode(param.substr(equal_pos + 1));
             form_data[key] = value;
-            std::cout << "Parsed form data: " << key << " = " << value << std::endl;
+            LOG_DEBUG << "Parsed form data: " << key << " = " << value;
         }
     }
     
@@ -956,7 +1265,7 @@ HttpResponse WebServer::handle_create_directory(const HttpRequest& request) {
     std::string path = form_data["path"];
     
     if (dirname.empty()) {
-        std::cout << "Create directory: No directory name provided" << std::endl;
+        LOG_DEBUG << "Create directory: No directory name provided";
         return {400, "Bad Request", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Directory name required\"}"};
     }
@@ -968,26 +1277,26 @@ HttpResponse WebServer::handle_create_directory(const HttpRequest& request) {
     }
     
     std::string dir_path = target_dir + "/" + dirname;
-    std::cout << "Creating directory: " << dir_path << std::endl;
+    LOG_DEBUG << "Creating directory: " << dir_path;
     
     // Ensure target directory exists
     if (!fs::exists(target_dir)) {
-        std::cout << "Creating target directory: " << target_dir << std::endl;
+        LOG_DEBUG << "Creating target directory: " << target_dir;
         fs::create_directories(target_dir);
     }
     
     if (fs::exists(dir_path)) {
-        std::cout << "Directory already exists: " << dir_path << std::endl;
+        LOG_DEBUG << "Directory already exists: " << dir_path;
         return {409, "Conflict", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Directory already exists\"}"};
     }
     
     if (fs::create_directories(dir_path)) {
-        std::cout << "Directory created successfully: " << dir_path << std::endl;
+        LOG_DEBUG << "Directory created successfully: " << dir_path;
         return {200, "OK", {{"Content-Type", "application/json"}}, 
                 "{\"success\": true, \"message\": \"Directory created successfully\"}"};
     } else {
-        std::cout << "Failed to create directory: " << dir_path << std::endl;
+        LOG_WARN << "Failed to create directory: " << dir_path;
         return {500, "Internal Server Error", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Failed to create directory\"}"};
     }
@@ -1008,27 +1317,35 @@ std::string WebServer::calculate_file_hash(const std::string& content) {
     return ss.str();
 }
 
-std::string WebServer::generate_version_id() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
-    
-    std::string id;
-    for (int i = 0; i < 8; i++) {
-        id += (char)dis(gen);
-    }
-    
-    std::stringstream ss;
-    for (char c : id) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)(unsigned char)c;
+std::string WebServer::calculate_file_hash_at(const std::string& path) {
+    // Same digest as calculate_file_hash of the whole content, without holding it in memory
+    EVP_MD_CTX* context = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(context, EVP_sha256(), nullptr);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        char block[STREAM_BLOCK_SIZE];
+        ssize_t length;
+        while ((length = read(fd, block, sizeof(block))) > 0) {
+            EVP_DigestUpdate(context, block, length);
+        }
+        close(fd);
     }
-    return ss.str();
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    EVP_DigestFinal_ex(context, hash, nullptr);
+    EVP_MD_CTX_free(context);
+    return to_hex(hash, sizeof(hash));
+}
+
+std::string WebServer::generate_version_id() {
+    unsigned char id[8];
+    random_bytes(id, sizeof(id));
+    return to_hex(id, sizeof(id));
 }
 
 bool WebServer::init_repository(const std::string& username, const std::string& path) {
     std::string repo_key = username + "/" + path;
     
-    if (repositories.find(repo_key) != repositories.end()) {
+    if (repositories.contains(repo_key)) {
         return false; // Repository already exists
     }
     
@@ -1050,29 +1367,26 @@ bool WebServer::init_repository(const std::string& username, const std::string&
     repo.branches["main"] = initial_version.id;
     repo.head_version = initial_version.id;
     
-    repositories[repo_key] = repo;
-    save_repositories();
-    
-    return true;
+    return repositories.create(repo_key, repo);
 }
 
 bool WebServer::create_version(const std::string& username, const std::string& path, const std::string& message) {
+    OperationTimer timer(metrics, Operation::CREATE_VERSION);
     std::string repo_key = username + "/" + path;
     
-    if (repositories.find(repo_key) == repositories.end()) {
+    if (!repositories.contains(repo_key)) {
         return false;
     }
     
-    Repository& repo = repositories[repo_key];
-    
-    // Get current files and calculate hashes
+    // Get current files and calculate hashes outside the repository lock
     std::vector<FileInfo> files = list_user_files(username, path);
     std::map<std::string, std::string> file_hashes;
     std::vector<std::string> changed_files;
+    std::string user_dir = get_user_home_directory(username);
     
     for (const auto& file : files) {
         if (!file.is_directory) {
-            std::string hash = calculate_file_hash(file.content);
+            std::string hash = calculate_file_hash_at(user_dir + "/" + file.path);
             file_hashes[file.name] = hash;
             changed_files.push_back(file.name);
         }
@@ -1084,91 +1398,66 @@ bool WebServer::create_version(const std::string& username, const std::string& p
     new_version.message = message;
     new_version.author = username;
     new_version.timestamp = time(nullptr);
-    new_version.parent_id = repo.head_version;
     new_version.file_hashes = file_hashes;
     new_version.changed_files = changed_files;
     
-    repo.versions[new_version.id] = new_version;
-    repo.branches[repo.current_branch] = new_version.id;
-    repo.head_version = new_version.id;
-    
-    save_repositories();
-    return true;
+    return repositories.update(repo_key, [&](const Repository& repo, RepositoryChange& change) {
+        new_version.parent_id = repo.head_version;
+        change.add_version(new_version);
+        change.set_branch(repo.current_branch, new_version.id);
+        change.set_head(new_version.id);
+    });
 }
 
 bool WebServer::checkout_version(const std::string& username, const std::string& path, const std::string& version_id) {
     std::string repo_key = username + "/" + path;
     
-    if (repositories.find(repo_key) == repositories.end()) {
-        return false;
-    }
-    
-    Repository& repo = repositories[repo_key];
-    
-    if (repo.versions.find(version_id) == repo.versions.end()) {
-        return false;
-    }
-    
-    // For now, just update the head version
-    // In a full implementation, you'd restore the actual files
-    repo.head_version = version_id;
-    save_repositories();
-    
-    return true;
+    return repositories.update(repo_key, [&](const Repository& repo, RepositoryChange& change) {
+        if (repo.versions.find(version_id) == repo.versions.end()) {
+            return;
+        }
+        
+        // For now, just update the head version
+        // In a full implementation, you'd restore the actual files
+        change.set_head(version_id);
+    });
 }
 
 bool WebServer::create_branch(const std::string& username, const std::string& path, const std::string& branch_name) {
     std::string repo_key = username + "/" + path;
     
-    if (repositories.find(repo_key) == repositories.end()) {
-        return false;
-    }
-    
-    Repository& repo = repositories[repo_key];
-    
-    if (repo.branches.find(branch_name) != repo.branches.end()) {
-        return false; // Branch already exists
-    }
-    
-    repo.branches[branch_name] = repo.head_version;
-    save_repositories();
-    
-    return true;
+    return repositories.update(repo_key, [&](const Repository& repo, RepositoryChange& change) {
+        if (repo.branches.find(branch_name) != repo.branches.end()) {
+            return; // Branch already exists
+        }
+        
+        change.set_branch(branch_name, repo.head_version);
+    });
 }
 
 bool WebServer::switch_branch(const std::string& username, const std::string& path, const std::string& branch_name) {
     std::string repo_key = username + "/" + path;
     
-    if (repositories.find(repo_key) == repositories.end()) {
-        return false;
-    }
-    
-    Repository& repo = repositories[repo_key];
-    
-    if (repo.branches.find(branch_name) == repo.branches.end()) {
-        return false; // Branch doesn't exist
-    }
-    
-    repo.current_branch = branch_name;
-    repo.head_version = repo.branches[branch_name];
-    save_repositories();
-    
-    return true;
+    return repositories.update(repo_key, [&](const Repository& repo, RepositoryChange& change) {
+        auto it = repo.branches.find(branch_name);
+        if (it == repo.branches.end()) {
+            return; // Branch doesn't exist
+        }
+        
+        change.set_current_branch(branch_name);
+        change.set_head(it->second);
+    });
 }
 
 std::vector<Version> WebServer::get_version_history(const std::string& username, const std::string& path) {
     std::string repo_key = username + "/" + path;
     std::vector<Version> history;
     
-    if (repositories.find(repo_key) == repositories.end()) {
-        return history;
-    }
-    
-    Repository& repo = repositories[repo_key];
-    
-    for (const auto& pair : repo.versions) {
-        history.push_back(pair.second);
-    }
+    repositories.read(repo_key, [&](const Repository& repo) {
+        for (const auto& pair : repo.versions) {
+            history.push_back(pair.second);
+        }
+    });
     
     // Sort by timestamp (newest first)
     std::sort(history.begin(), history.end(), 
@@ -1177,75 +1466,9 @@ std::vector<Version> WebServer::get_version_history(const std::string& username,
     return history;
 }
 
-void WebServer::load_repositories() {
-    std::string repos_file = data_dir + "/repositories.txt";
-    std::cout << "Loading repositories from: " << repos_file << std::endl;
-    
-    std::ifstream file(repos_file);
-    if (!file.is_open()) {
-        std::cout << "No repositories file found, starting with empty repository list" << std::endl;
-        return;
-    }
-    
-    // Simple loading for now - in a real implementation you'd want more robust parsing
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        
-        std::istringstream line_stream(line);
-        std::string repo_key, name, path, current_branch, head_version;
-        
-        if (std::getline(line_stream, repo_key, '|') &&
-            std::getline(line_stream, name, '|') &&
-            std::getline(line_stream, path, '|') &&
-            std::getline(line_stream, current_branch, '|') &&
-            std::getline(line_stream, head_version, '|')) {
-            
-            Repository repo;
-            repo.name = name;
-            repo.path = path;
-            repo.current_branch = current_branch;
-            repo.head_version = head_version;
-            
-            repositories[repo_key] = repo;
-            std::cout << "Loaded repository: " << repo_key << std::endl;
-        }
-    }
-}
-
-void WebServer::save_repositories() {
-    std::string repos_file = data_dir + "/repositories.txt";
-    std::cout << "Saving repositories to: " << repos_file << std::endl;
-    
-    if (!fs::exists(data_dir)) {
-        fs::create_directories(data_dir);
-    }
-    
-    std::ofstream file(repos_file);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open repositories file for writing: " << repos_file << std::endl;
-        return;
-    }
-    
-    for (const auto& pair : repositories) {
-        const Repository& repo = pair.second;
-        file << pair.first << "|" << repo.name << "|" << repo.path << "|" 
-             << repo.current_branch << "|" << repo.head_version << "\n";
-    }
-    
-    file.close();
-}
-
 // Version control route handlers
 HttpResponse WebServer::handle_init_repo(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     std::string body = request.body;
     std::map<std::string, std::string> form_data;
@@ -1273,14 +1496,7 @@ HttpResponse WebServer::handle_init_repo(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_commit(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     std::string body = request.body;
     std::map<std::string, std::string> form_data;
@@ -1314,14 +1530,7 @@ HttpResponse WebServer::handle_commit(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_get_history(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     auto path_it = request.query_params.find("path");
     std::string path = (path_it != request.query_params.end()) ? path_it->second : "";
@@ -1350,14 +1559,7 @@ HttpResponse WebServer::handle_get_history(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_checkout(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     std::string body = request.body;
     std::map<std::string, std::string> form_data;
@@ -1386,14 +1588,7 @@ HttpResponse WebServer::handle_checkout(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_create_branch(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     std::string body = request.body;
     std::map<std::string, std::string> form_data;
@@ -1427,14 +1622,7 @@ HttpResponse WebServer::handle_create_branch(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_switch_branch(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     std::string body = request.body;
     std::map<std::string, std::string> form_data;
@@ -1468,13 +1656,7 @@ HttpResponse WebServer::handle_switch_branch(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_upload_file(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}},
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
 
     // Only support multipart/form-data for now
     auto it = request.headers.find("Content-Type");
@@ -1579,8 +1761,7 @@ HttpResponse WebServer::handle_upload_file(const HttpRequest& request) {
 }
 
 HttpResponse WebServer::handle_auth(const HttpRequest& request) {
-    std::cout << "Auth request received" << std::endl;
-    std::cout << "Request body: " << request.body << std::endl;
+    LOG_DEBUG << "Auth request received";
     
     // Parse JSON request body
     std::string body = request.body;
@@ -1612,7 +1793,7 @@ HttpResponse WebServer::handle_auth(const HttpRequest& request) {
         }
     }
     
-    std::cout << "Parsed auth data - username: " << username << ", action: " << action << std::endl;
+    LOG_DEBUG << "Parsed auth data - username: " << username << ", action: " << action;
     
     if (action == "login") {
         return handle_login_internal(username, password);
@@ -1630,29 +1811,17 @@ HttpResponse WebServer::handle_login_internal(const std::string& username, const
                 "{\"success\": false, \"message\": \"Username and password required\"}"};
     }
     
-    auto it = users.find(username);
-    if (it == users.end()) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid username or password\"}"};
-    }
-    
-    if (!verify_password(password, it->second.password_hash)) {
+    if (!check_credentials(username, password)) {
         return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Invalid username or password\"}"};
     }
     
     // Generate new session token
-    std::string token = generate_session_token();
-    Session session;
-    session.token = token;
-    session.username = username;
-    session.created = time(nullptr);
-    session.last_activity = time(nullptr);
-    session.current_directory = get_user_home_directory(username);
-    
-    sessions[session.token] = session;
-    it->second.session_token = session.token;
-    it->second.last_activity = time(nullptr);
+    std::string token;
+    if (!start_session(username, token)) {
+        return {503, "Service Unavailable", {{"Content-Type", "application/json"}}, 
+                "{\"success\": false, \"message\": \"Too many active sessions\"}"};
+    }
     
     std::string response = "{\"success\": true, \"message\": \"Login successful\", \"token\": \"" + token + "\"}";
     return {200, "OK", {{"Content-Type", "application/json"}, {"Set-Cookie", "session=" + token + "; Path=/; HttpOnly"}}, response};
@@ -1664,7 +1833,7 @@ HttpResponse WebServer::handle_register_internal(const std::string& username, co
                 "{\"success\": false, \"message\": \"Username and password required\"}"};
     }
     
-    if (users.find(username) != users.end()) {
+    if (users.contains(username)) {
         return {409, "Conflict", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Username already exists\"}"};
     }
@@ -1672,30 +1841,27 @@ HttpResponse WebServer::handle_register_internal(const std::string& username, co
     // Create new user
     User user;
     user.username = username;
-    user.password_hash = hash_password(password);
+    user.password_hash = hash_password(password, config.password_kdf);
     user.filesystem_path = create_user_filesystem(username);
     user.last_activity = time(nullptr);
     
-    users[username] = user;
+    if (!users.insert(user)) {
+        return {409, "Conflict", {{"Content-Type", "application/json"}}, 
+                "{\"success\": false, \"message\": \"Username already exists\"}"};
+    }
     
     // Create system user for terminal access
     if (!create_system_user(username)) {
-        std::cout << "Warning: Failed to create system user for: " << username << std::endl;
+        LOG_WARN << "Failed to create system user for: " << username;
         // Don't fail registration, just log warning
     }
     
     // Generate session token for new user
-    std::string token = generate_session_token();
-    Session session;
-    session.token = token;
-    session.username = username;
-    session.created = time(nullptr);
-    session.last_activity = time(nullptr);
-    session.current_directory = get_user_home_directory(username);
-    
-    sessions[session.token] = session;
-    user.session_token = session.token;
-    users[username] = user;
+    std::string token;
+    if (!start_session(username, token)) {
+        return {503, "Service Unavailable", {{"Content-Type", "application/json"}}, 
+                "{\"success\": false, \"message\": \"Too many active sessions\"}"};
+    }
     
     std::string response = "{\"success\": true, \"message\": \"Registration successful\", \"token\": \"" + token + "\"}";
     return {200, "OK", {{"Content-Type", "application/json"}, {"Set-Cookie", "session=" + token + "; Path=/; HttpOnly"}}, response};
@@ -1716,27 +1882,18 @@ HttpResponse WebServer::handle_validate_session(const HttpRequest& request) {
         }
     }
     
-    if (!is_session_valid(token)) {
+    const std::string* username = session_username(token);
+    if (!username) {
         return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"Invalid session\"}"};
     }
     
-    update_session_activity(token);
-    std::string username = sessions[token].username;
-    
-    std::string response = "{\"success\": true, \"message\": \"Session is valid\", \"username\": \"" + username + "\"}";
+    std::string response = "{\"success\": true, \"message\": \"Session is valid\", \"username\": \"" + *username + "\"}";
     return {200, "OK", {{"Content-Type", "application/json"}}, response};
 }
 
 HttpResponse WebServer::handle_save_api_key(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
-    
-    update_session_activity(token);
-    std::string username = sessions[token].username;
+    const std::string& username = request.username;
     
     // Parse JSON request body
     std::string body = request.body;
@@ -1773,49 +1930,40 @@ HttpResponse WebServer::handle_save_api_key(const HttpRequest& request) {
     }
     
     // Update user's API key information
-    auto it = users.find(username);
-    if (it != users.end()) {
-        it->second.api_key = api_key;
-        it->second.api_provider = provider;
-        it->second.api_model = model;
-        save_users(); // Save to disk
-    }
+    users.update(username, [&](User& user) {
+        user.api_key = api_key;
+        user.api_provider = provider;
+        user.api_model = model;
+    });
     
     return {200, "OK", {{"Content-Type", "application/json"}}, 
             "{\"success\": true, \"message\": \"API key saved successfully\"}"};
 }
 
 HttpResponse WebServer::handle_get_api_key(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
-    }
+    const std::string& username = request.username;
     
-    update_session_activity(token);
-    std::string username = sessions[token].username;
-    
-    auto it = users.find(username);
-    if (it == users.end()) {
+    User user;
+    if (!users.find(username, user)) {
         return {404, "Not Found", {{"Content-Type", "application/json"}}, 
                 "{\"success\": false, \"message\": \"User not found\"}"};
     }
     
-    std::string response = "{\"success\": true, \"api_key\": \"" + it->second.api_key + 
-                          "\", \"provider\": \"" + it->second.api_provider + 
-                          "\", \"model\": \"" + it->second.api_model + "\"}";
+    std::string response = "{\"success\": true, \"api_key\": \"" + user.api_key + 
+                          "\", \"provider\": \"" + user.api_provider + 
+                          "\", \"model\": \"" + user.api_model + "\"}";
     
     return {200, "OK", {{"Content-Type", "application/json"}}, response};
 }
 
 // User management functions
 bool WebServer::create_system_user(const std::string& username) {
-    std::cout << "Checking system user: " << username << std::endl;
+    LOG_DEBUG << "Checking system user: " << username;
     
     // Check if user already exists using getpwnam
     struct passwd* pwd = getpwnam(username.c_str());
     if (pwd != nullptr) {
-        std::cout << "System user already exists: " << username << " (UID: " << pwd->pw_uid << ")" << std::endl;
+        LOG_DEBUG << "System user already exists: " << username << " (UID: " << pwd->pw_uid << ")";
         
         // Ensure directories exist (don't try to change ownership without sudo)
         std::string web_app_dir = get_user_home_directory(username);
@@ -1825,34 +1973,34 @@ bool WebServer::create_system_user(const std::string& username) {
         if (!fs::exists(web_app_dir)) {
             try {
                 fs::create_directories(web_app_dir);
-                std::cout << "Created web app directory: " << web_app_dir << std::endl;
+                LOG_DEBUG << "Created web app directory: " << web_app_dir;
             } catch (const fs::filesystem_error& e) {
-                std::cout << "Warning: Could not create web app directory: " << e.what() << std::endl;
+                LOG_WARN << "Could not create web app directory: " << e.what();
             }
         }
         
         if (!fs::exists(system_home_dir)) {
             try {
                 fs::create_directories(system_home_dir);
-                std::cout << "Created system home directory: " << system_home_dir << std::endl;
+                LOG_DEBUG << "Created system home directory: " << system_home_dir;
             } catch (const fs::filesystem_error& e) {
-                std::cout << "Warning: Could not create system home directory: " << e.what() << std::endl;
+                LOG_WARN << "Could not create system home directory: " << e.what();
             }
         }
         
         return true;
     }
     
-    std::cout << "Creating system user: " << username << std::endl;
+    LOG_INFO << "Creating system user: " << username;
     
     // Create standard system home directory
     std::string system_home_dir = "/home/" + username;
     if (!fs::exists(system_home_dir)) {
         try {
             fs::create_directories(system_home_dir);
-            std::cout << "Created system home directory: " << system_home_dir << std::endl;
+            LOG_DEBUG << "Created system home directory: " << system_home_dir;
         } catch (const fs::filesystem_error& e) {
-            std::cout << "Failed to create system home directory: " << e.what() << std::endl;
+            LOG_WARN << "Failed to create system home directory: " << e.what();
             return false;
         }
     }
@@ -1862,35 +2010,35 @@ bool WebServer::create_system_user(const std::string& username) {
     if (!fs::exists(web_app_dir)) {
         try {
             fs::create_directories(web_app_dir);
-            std::cout << "Created web app directory: " << web_app_dir << std::endl;
+            LOG_DEBUG << "Created web app directory: " << web_app_dir;
         } catch (const fs::filesystem_error& e) {
-            std::cout << "Failed to create web app directory: " << e.what() << std::endl;
+            LOG_WARN << "Failed to create web app directory: " << e.what();
             return false;
         }
     }
     
     // Create system user (this requires sudo, so we'll skip if not available)
     std::string useradd_cmd = "useradd -m -d " + system_home_dir + " -s /bin/bash " + username;
-    std::cout << "Executing: " << useradd_cmd << std::endl;
+    LOG_DEBUG << "Executing: " << useradd_cmd;
     int result = system(useradd_cmd.c_str());
     
     if (result == 0) {
-        std::cout << "System user created successfully: " << username << std::endl;
+        LOG_INFO << "System user created successfully: " << username;
         return true;
     } else {
-        std::cout << "Warning: Failed to create system user (may need sudo): " << username << std::endl;
-        std::cout << "Continuing without system user creation..." << std::endl;
+        LOG_WARN << "Failed to create system user (may need sudo): " << username;
+        LOG_WARN << "Continuing without system user creation...";
         return true; // Continue anyway, the user might already exist
     }
 }
 
 bool WebServer::delete_system_user(const std::string& username) {
-    std::cout << "Deleting system user: " << username << std::endl;
+    LOG_INFO << "Deleting system user: " << username;
     
     // Check if user exists
     struct passwd* pwd = getpwnam(username.c_str());
     if (pwd == nullptr) {
-        std::cout << "User does not exist: " << username << std::endl;
+        LOG_INFO << "User does not exist: " << username;
         return true;
     }
     
@@ -1899,10 +2047,10 @@ bool WebServer::delete_system_user(const std::string& username) {
     int result = system(command.c_str());
     
     if (result == 0) {
-        std::cout << "System user deleted successfully: " << username << std::endl;
+        LOG_INFO << "System user deleted successfully: " << username;
         return true;
     } else {
-        std::cout << "Failed to delete system user: " << username << std::endl;
+        LOG_WARN << "Failed to delete system user: " << username;
         return false;
     }
 }
@@ -1992,36 +2140,33 @@ std::string WebServer::sanitize_path(const std::string& path, const std::string&
             }
         }
     } catch (const fs::filesystem_error& e) {
-        std::cout << "Filesystem error in sanitize_path: " << e.what() << std::endl;
+        LOG_WARN << "Filesystem error in sanitize_path: " << e.what();
         return user_home;
     }
 }
 
 // Update execute_terminal_command to track and update current directory per session
-std::string WebServer::execute_terminal_command(const std::string& command, const std::string& username, const std::string& directory) {
-    std::cout << "Executing terminal command for user " << username << ": " << command << std::endl;
+std::string WebServer::execute_terminal_command(const std::string& command, const std::string& username,
+                                                const std::string& session_token, const std::string& directory,
+                                                std::string* output_file) {
+    OperationTimer timer(metrics, Operation::TERMINAL_COMMAND);
+    LOG_DEBUG << "Executing terminal command" << log_field("user", username) << log_field("command", command);
     if (!is_safe_command(command)) {
         return "Error: Command not allowed for security reasons.";
     }
 
-    // Get session for user
-    Session* session_ptr = nullptr;
-    for (auto& [token, session] : sessions) {
-        if (session.username == username) {
-            session_ptr = &session;
-            break;
-        }
-    }
-    if (!session_ptr) {
-        // Fallback: use home directory
-        std::cout << "No session found for user, using home directory." << std::endl;
-        session_ptr = nullptr;
-    }
+    // Each session carries its own terminal working directory
+    std::string session_directory;
+    session_directories.find(session_token, session_directory);
+    auto set_session_directory = [&](const std::string& dir) {
+        if (session_token.empty()) return;
+        session_directories.assign(session_token, dir);
+    };
 
     // Determine current working directory
     std::string working_dir = get_user_home_directory(username);
-    if (session_ptr && !session_ptr->current_directory.empty()) {
-        working_dir = session_ptr->current_directory;
+    if (!session_directory.empty()) {
+        working_dir = session_directory;
     }
     // If a specific directory is requested (e.g., after login), use it
     if (!directory.empty()) {
@@ -2049,7 +2194,7 @@ std::string WebServer::execute_terminal_command(const std::string& command, cons
             new_dir = sanitize_path(new_dir, username);
         }
         if (!new_dir.empty() && fs::exists(new_dir) && fs::is_directory(new_dir)) {
-            if (session_ptr) session_ptr->current_directory = new_dir;
+            set_session_directory(new_dir);
             working_dir = new_dir;
         } else {
             return "cd: no such directory: " + target;
@@ -2058,8 +2203,11 @@ std::string WebServer::execute_terminal_command(const std::string& command, cons
         return "";
     }
 
-    std::cout << "Working directory: " << working_dir << std::endl;
-    std::string temp_file = "/tmp/terminal_output_" + username + "_" + std::to_string(time(nullptr));
+    LOG_DEBUG << "Working directory: " << working_dir;
+    // Commands run concurrently on the worker pool, so the name must be unique per call
+    static std::atomic<unsigned long> command_counter{0};
+    std::string temp_file = "/tmp/terminal_output_" + username + "_" + std::to_string(time(nullptr)) +
+                            "_" + std::to_string(command_counter.fetch_add(1));
     std::string non_interactive_command = command;
     if (command.find("rm ") == 0) {
         if (command.find(" -f") == std::string::npos && command.find(" --force") == std::string::npos) {
@@ -2075,8 +2223,16 @@ std::string WebServer::execute_terminal_command(const std::string& command, cons
         }
     }
     std::string full_command = "cd \"" + working_dir + "\" && " + non_interactive_command + " > '" + temp_file + "' 2>&1";
-    std::cout << "Executing command: " << full_command << std::endl;
+    LOG_DEBUG << "Executing command: " << full_command;
     int result = system(full_command.c_str());
+    LOG_DEBUG << "Command result: " << result;
+    // Update session's current directory if needed (for commands like mkdir, rm, etc, we stay in the same dir)
+    set_session_directory(working_dir);
+    if (output_file) {
+        *output_file = temp_file;
+        return "";
+    }
+    
     std::string output;
     std::ifstream temp_stream(temp_file);
     if (temp_stream.is_open()) {
@@ -2087,10 +2243,7 @@ std::string WebServer::execute_terminal_command(const std::string& command, cons
         temp_stream.close();
     }
     std::remove(temp_file.c_str());
-    std::cout << "Command result: " << result << std::endl;
-    std::cout << "Command output: " << output << std::endl;
-    // Update session's current directory if needed (for commands like mkdir, rm, etc, we stay in the same dir)
-    if (session_ptr) session_ptr->current_directory = working_dir;
+    LOG_DEBUG << "Command output: " << output;
     return output;
 }
 
@@ -2114,16 +2267,13 @@ std::string WebServer::get_current_directory(const std::string& username) {
 }
 
 HttpResponse WebServer::handle_terminal_execute(const HttpRequest& request) {
-    std::string token = extract_session_token(request);
-    if (!is_session_valid(token)) {
-        return {401, "Unauthorized", {{"Content-Type", "application/json"}}, 
-                "{\"success\": false, \"message\": \"Invalid session\"}"};
+    const std::string& token = request.session_token;
+    const std::string& username = request.username;
+    std::string current_dir;
+    if (!session_directories.find(token, current_dir)) {
+        current_dir = get_user_home_directory(username);
     }
     
-    update_session_activity(token);
-    std::string username = sessions[token].username;
-    std::string& current_dir = sessions[token].current_directory;
-    
     // Ensure system user exists for this web user
     if (!create_system_user(username)) {
         return {500, "Internal Server Error", {{"Content-Type", "application/json"}}, 
@@ -2160,7 +2310,7 @@ HttpResponse WebServer::handle_terminal_execute(const HttpRequest& request) {
                 "{\"success\": false, \"message\": \"Command required\"}"};
     }
     
-    std::cout << "Terminal command from user " << username << ": " << command << std::endl;
+    LOG_INFO << "Terminal command" << log_field("user", username) << log_field("command", command);
     
     // Use session's current directory if no directory specified
     std::string working_dir = directory.empty() ? current_dir : directory;
@@ -2172,6 +2322,7 @@ HttpResponse WebServer::handle_terminal_execute(const HttpRequest& request) {
         
         if (change_directory(username, target_dir)) {
             current_dir = target_dir;
+            session_directories.assign(token, current_dir);
             std::ostringstream json;
             json << "{\"success\": true, "
                  << "\"output\":\"\", "
@@ -2187,7 +2338,17 @@ HttpResponse WebServer::handle_terminal_execute(const HttpRequest& request) {
     }
     
     // Execute the command
-    std::string output = execute_terminal_command(command, username, working_dir);
+    std::string output_file;
+    std::string output = execute_terminal_command(command, username, token, working_dir, &output_file);
+    session_directories.find(token, current_dir);
+    
+    // Command output is streamed straight from its capture file, which is removed afterwards
+    if (!output_file.empty()) {
+        HttpResponse response{200, "OK", {{"Content-Type", "application/json"}}, ""};
+        response.stream = stream_encoded_file(output_file, "{\"success\": true, \"output\":\"",
+                                              "\", \"directory\":\"" + url_encode(current_dir) + "\"}", true);
+        return response;
+    }
     
     // Build response
     std::ostringstream json;
@@ -0,0 +1,195 @@
+//server_config.cpp
+#include "../include/server_config.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+struct Option {
+    const char* flag;       // --name on the command line
+    const char* env;        // Environment variable
+    const char* value;      // Placeholder shown in usage; null for switches
+    const char* help;
+    std::function<bool(const std::string&)> apply;
+};
+
+// Parse a non-negative integer no larger than max
+template <typename T>
+std::function<bool(const std::string&)> number(T& field, uint64_t max = std::numeric_limits<T>::max()) {
+    return [&field, max](const std::string& text) {
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+        errno = 0;
+        unsigned long long value = std::strtoull(text.c_str(), nullptr, 10);
+        if (errno == ERANGE || value > max) return false;
+        field = (T)value;
+        return true;
+    };
+}
+
+std::function<bool(const std::string&)> text(std::string& field) {
+    return [&field](const std::string& value) {
+        if (value.empty()) return false;
+        field = value;
+        return true;
+    };
+}
+
+std::function<bool(const std::string&)> boolean(bool& field) {
+    return [&field](const std::string& value) {
+        if (value == "1" || value == "true" || value == "yes" || value == "on") field = true;
+        else if (value == "0" || value == "false" || value == "no" || value == "off") field = false;
+        else return false;
+        return true;
+    };
+}
+
+std::function<bool(const std::string&)> kdf_algorithm(PasswordKdf::Algorithm& field) {
+    return [&field](const std::string& value) {
+        if (value == "pbkdf2") field = PasswordKdf::PBKDF2_SHA256;
+        else if (value == "scrypt") field = PasswordKdf::SCRYPT;
+        else return false;
+        return true;
+    };
+}
+
+std::function<bool(const std::string&)> log_level(LogLevel& field) {
+    return [&field](const std::string& value) { return logging::parse_level(value, field); };
+}
+
+std::function<bool(const std::string&)> log_format(LogFormat& field) {
+    return [&field](const std::string& value) { return logging::parse_format(value, field); };
+}
+
+std::vector<Option> options_for(ServerConfig& config) {
+    HttpLimits& http = config.http_limits;
+    ConnectionLimits& conn = config.connection_limits;
+    return {
+        {"port", "WEBEDITOR_PORT", "N", "TCP port to listen on", number(config.port)},
+        {"acceptors", "WEBEDITOR_ACCEPTORS", "N", "Event loops with their own SO_REUSEPORT listener", number(config.acceptors, 1024)},
+        {"backlog", "WEBEDITOR_BACKLOG", "N", "listen() backlog per listener", number(config.backlog)},
+        {"pin-cpus", "WEBEDITOR_PIN_CPUS", nullptr, "Pin each event loop to its own CPU", boolean(config.pin_cpus)},
+        {"defer-accept", "WEBEDITOR_DEFER_ACCEPT", "SECS", "TCP_DEFER_ACCEPT timeout, 0 to disable", number(config.defer_accept_secs)},
+        {"fastopen", "WEBEDITOR_FASTOPEN", "N", "TCP_FASTOPEN queue length, 0 to disable", number(config.fastopen_queue)},
+        {"workers", "WEBEDITOR_WORKERS", "N", "Handler threads, 0 for one per core", number(config.worker_threads, 4096)},
+        {"crypto-threads", "WEBEDITOR_CRYPTO_THREADS", "N", "Password hashing threads", number(config.crypto_threads, 4096)},
+        {"crypto-queue", "WEBEDITOR_CRYPTO_QUEUE", "N", "Queued logins before answering 503", number(config.crypto_queue)},
+        {"search-threads", "WEBEDITOR_SEARCH_THREADS", "N", "Content search threads, 0 for one per core", number(config.search_threads, 4096)},
+        {"password-kdf", "WEBEDITOR_PASSWORD_KDF", "pbkdf2|scrypt", "Key derivation for new password hashes", kdf_algorithm(config.password_kdf.algorithm)},
+        {"pbkdf2-iterations", "WEBEDITOR_PBKDF2_ITERATIONS", "N", "PBKDF2-SHA256 iteration count", number(config.password_kdf.pbkdf2_iterations, 0x7fffffff)},
+        {"scrypt-cost", "WEBEDITOR_SCRYPT_COST", "LOG2N", "scrypt CPU/memory cost as log2(N)", number(config.password_kdf.scrypt_log2_n, 24)},
+        {"data-dir", "WEBEDITOR_DATA_DIR", "PATH", "User data directory", text(config.data_dir)},
+        {"frontend-dir", "WEBEDITOR_FRONTEND_DIR", "PATH", "Static frontend directory", text(config.frontend_dir)},
+        {"static-cache-max-file", "WEBEDITOR_STATIC_CACHE_MAX_FILE", "BYTES", "Largest frontend file held in memory", number(config.static_cache_max_file)},
+        {"workspace-index-budget", "WEBEDITOR_WORKSPACE_INDEX_BUDGET", "BYTES", "Memory for indexed workspace trees, 0 to disable", number(config.workspace_index_budget)},
+        {"search-index-budget", "WEBEDITOR_SEARCH_INDEX_BUDGET", "BYTES", "Memory for content search filters, 0 to disable", number(config.search_index_budget)},
+        {"max-sessions", "WEBEDITOR_MAX_SESSIONS", "N", "Concurrent login sessions", number(config.max_sessions, 1u << 28)},
+        {"session-timeout", "WEBEDITOR_SESSION_TIMEOUT_MS", "MS", "Idle time before a session expires", number(config.session_timeout_ms)},
+        {"metrics-public", "WEBEDITOR_METRICS_PUBLIC", nullptr, "Serve /api/metrics without a login session", boolean(config.metrics_public)},
+        {"drain-timeout", "WEBEDITOR_DRAIN_TIMEOUT_MS", "MS", "Time given to in-flight requests on shutdown or restart", number(config.drain_timeout_ms)},
+        {"log-level", "WEBEDITOR_LOG_LEVEL", "debug|info|warn|error", "Least severe messages logged", log_level(config.log_level)},
+        {"log-format", "WEBEDITOR_LOG_FORMAT", "text|json", "Log line format on stdout", log_format(config.log_format)},
+        {"max-header-size", "WEBEDITOR_MAX_HEADER_SIZE", "BYTES", "Request line plus headers", number(http.max_header_size)},
+        {"max-header-count", "WEBEDITOR_MAX_HEADER_COUNT", "N", "Header fields per request", number(http.max_header_count)},
+        {"max-body-size", "WEBEDITOR_MAX_BODY_SIZE", "BYTES", "Request body", number(http.max_body_size)},
+        {"header-timeout", "WEBEDITOR_HEADER_TIMEOUT_MS", "MS", "Time allowed to send request headers", number(conn.header_timeout_ms)},
+        {"body-timeout", "WEBEDITOR_BODY_TIMEOUT_MS", "MS", "Longest pause while sending a body", number(conn.body_timeout_ms)},
+        {"idle-timeout", "WEBEDITOR_IDLE_TIMEOUT_MS", "MS", "Keep-alive wait between requests", number(conn.idle_timeout_ms)},
+        {"write-timeout", "WEBEDITOR_WRITE_TIMEOUT_MS", "MS", "Longest pause while reading a response", number(conn.write_timeout_ms)},
+        {"max-connections-per-ip", "WEBEDITOR_MAX_CONNECTIONS_PER_IP", "N", "Concurrent connections per client address", number(conn.max_connections_per_ip)},
+    };
+}
+
+} // namespace
+
+bool parse_server_config(int argc, char** argv, ServerConfig& config, std::string& error) {
+    std::vector<Option> options = options_for(config);
+
+    for (const Option& option : options) {
+        const char* value = getenv(option.env);
+        if (value && !option.apply(value)) {
+            error = std::string("Invalid value for ") + option.env + ": " + value;
+            return false;
+        }
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            error.clear();
+            return false;
+        }
+        if (arg.rfind("--", 0) != 0) {
+            error = "Unexpected argument: " + arg;
+            return false;
+        }
+
+        // Accept both --name=value and --name value
+        std::string name = arg.substr(2);
+        std::string value;
+        bool has_value = false;
+        size_t equals = name.find('=');
+        if (equals != std::string::npos) {
+            value = name.substr(equals + 1);
+            name.resize(equals);
+            has_value = true;
+        }
+
+        const Option* match = nullptr;
+        for (const Option& option : options) {
+            if (name == option.flag) match = &option;
+        }
+        if (!match) {
+            error = "Unknown option: --" + name;
+            return false;
+        }
+
+        if (!has_value) {
+            if (!match->value) {
+                value = "1";
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            } else {
+                error = "Missing value for --" + name;
+                return false;
+            }
+        }
+        if (!match->apply(value)) {
+            error = "Invalid value for --" + name + ": " + value;
+            return false;
+        }
+    }
+
+    if (config.acceptors == 0) {
+        error = "--acceptors must be at least 1";
+        return false;
+    }
+    if (config.crypto_threads == 0) {
+        error = "--crypto-threads must be at least 1";
+        return false;
+    }
+    if (config.password_kdf.pbkdf2_iterations == 0 || config.password_kdf.scrypt_log2_n == 0) {
+        error = "Password hashing cost must be at least 1";
+        return false;
+    }
+    if (config.max_sessions == 0) {
+        error = "--max-sessions must be at least 1";
+        return false;
+    }
+    return true;
+}
+
+std::string server_config_usage(const char* program) {
+    ServerConfig defaults;
+    std::ostringstream usage;
+    usage << "Usage: " << program << " [options]\n\nOptions (environment variable in brackets):\n";
+    for (const Option& option : options_for(defaults)) {
+        std::string flag = std::string("--") + option.flag + (option.value ? std::string(" ") + option.value : "");
+        usage << "  " << flag << std::string(flag.size() < 32 ? 32 - flag.size() : 1, ' ')
+              << option.help << " [" << option.env << "]\n";
+    }
+    return usage.str();
+}
@@ -0,0 +1,165 @@
+//session_snapshot.cpp
+#include "../include/session_snapshot.hpp"
+#include "../include/log_file.hpp"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+// File layout: SnapshotHeader, then per session the token words, idle time,
+// username length, directory length and the two strings
+const char SNAPSHOT_MAGIC[8] = {'W', 'E', 'S', 'N', 'A', 'P', '0', '1'};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint64_t count;
+    int64_t saved_at_ms;      // Wall clock, since monotonic time does not survive a reboot
+    uint32_t body_crc;        // crc32 of everything after the header
+    uint32_t reserved;
+};
+
+struct EntryHeader {
+    uint64_t token[4];
+    uint64_t idle_ms;
+    uint32_t username_length;
+    uint32_t directory_length;
+};
+
+int64_t wall_clock_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+std::string system_error(const std::string& what, const std::string& path) {
+    return what + " " + path + ": " + strerror(errno);
+}
+
+} // namespace
+
+bool write_session_snapshot(const std::string& path, const std::vector<SessionSnapshotEntry>& entries,
+                            std::string& error) {
+    size_t size = sizeof(SnapshotHeader);
+    for (const auto& entry : entries) {
+        size += sizeof(EntryHeader) + entry.session.username.size() + entry.directory.size();
+    }
+
+    std::string temp_path = path + ".tmp";
+    int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = system_error("Cannot create", temp_path);
+        return false;
+    }
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (base == MAP_FAILED) {
+        error = system_error("Cannot map", temp_path);
+        close(fd);
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    char* out = static_cast<char*>(base) + sizeof(SnapshotHeader);
+    for (const auto& entry : entries) {
+        EntryHeader entry_header;
+        memcpy(entry_header.token, entry.session.token.words, sizeof(entry_header.token));
+        entry_header.idle_ms = entry.session.idle_ms;
+        entry_header.username_length = (uint32_t)entry.session.username.size();
+        entry_header.directory_length = (uint32_t)entry.directory.size();
+        memcpy(out, &entry_header, sizeof(entry_header));
+        out += sizeof(entry_header);
+        memcpy(out, entry.session.username.data(), entry.session.username.size());
+        out += entry.session.username.size();
+        memcpy(out, entry.directory.data(), entry.directory.size());
+        out += entry.directory.size();
+    }
+
+    SnapshotHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.count = entries.size();
+    header.saved_at_ms = wall_clock_ms();
+    header.body_crc = (uint32_t)crc32(0, reinterpret_cast<const Bytef*>(base) + sizeof(SnapshotHeader),
+                                      (uInt)(size - sizeof(SnapshotHeader)));
+    memcpy(base, &header, sizeof(header));
+
+    bool synced = msync(base, size, MS_SYNC) == 0;
+    munmap(base, size);
+    close(fd);
+    if (!synced || rename(temp_path.c_str(), path.c_str()) != 0) {
+        error = system_error("Cannot write", path);
+        unlink(temp_path.c_str());
+        return false;
+    }
+    log_file::sync_directory(path.substr(0, path.rfind('/')));
+    return true;
+}
+
+bool read_session_snapshot(const std::string& path, std::vector<SessionSnapshotEntry>& entries, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return true;
+        error = system_error("Cannot open", path);
+        return false;
+    }
+    size_t size = log_file::file_size(fd);
+    if (size < sizeof(SnapshotHeader)) {
+        close(fd);
+        error = path + " is truncated";
+        return false;
+    }
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        error = system_error("Cannot map", path);
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(base);
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    bool valid = memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+                 header.body_crc == (uint32_t)crc32(0, reinterpret_cast<const Bytef*>(data) + sizeof(header),
+                                                    (uInt)(size - sizeof(header)));
+    // Time spent on disk counts as idle time
+    int64_t elapsed = wall_clock_ms() - header.saved_at_ms;
+    uint64_t downtime = elapsed > 0 ? (uint64_t)elapsed : 0;
+
+    size_t position = sizeof(header);
+    for (uint64_t i = 0; valid && i < header.count; i++) {
+        EntryHeader entry_header;
+        if (size - position < sizeof(entry_header)) {
+            valid = false;
+            break;
+        }
+        memcpy(&entry_header, data + position, sizeof(entry_header));
+        position += sizeof(entry_header);
+        if (size - position < (uint64_t)entry_header.username_length + entry_header.directory_length) {
+            valid = false;
+            break;
+        }
+
+        SessionSnapshotEntry entry;
+        memcpy(entry.session.token.words, entry_header.token, sizeof(entry_header.token));
+        entry.session.idle_ms = entry_header.idle_ms + downtime;
+        entry.session.username.assign(data + position, entry_header.username_length);
+        position += entry_header.username_length;
+        entry.directory.assign(data + position, entry_header.directory_length);
+        position += entry_header.directory_length;
+        entries.push_back(std::move(entry));
+    }
+    munmap(base, size);
+
+    if (!valid) {
+        entries.clear();
+        error = path + " is corrupt";
+        return false;
+    }
+    return true;
+}
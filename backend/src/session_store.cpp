@@ -0,0 +1,289 @@
+//session_store.cpp
+#include "../include/session_store.hpp"
+#include "../include/crypto.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+const uint64_t SWEEP_TICK_MS = 1000;
+
+// Tick-resolution clock read without a hardware timer access; plenty for
+// second-granularity activity stamps and far cheaper than monotonic_ms()
+uint64_t coarse_monotonic_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+SessionToken SessionToken::generate() {
+    SessionToken token;
+    random_bytes(token.words, sizeof(token.words));
+    return token;
+}
+
+bool SessionToken::parse(std::string_view hex, SessionToken& out) {
+    if (hex.size() != 64) return false;
+    for (int word = 0; word < 4; word++) {
+        uint64_t value = 0;
+        for (int i = 0; i < 16; i++) {
+            int digit = hex_digit(hex[word * 16 + i]);
+            if (digit < 0) return false;
+            value = (value << 4) | (uint64_t)digit;
+        }
+        out.words[word] = value;
+    }
+    return true;
+}
+
+std::string SessionToken::to_hex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(64, '0');
+    for (int word = 0; word < 4; word++) {
+        for (int i = 0; i < 16; i++) {
+            hex[word * 16 + i] = digits[(words[word] >> (60 - 4 * i)) & 0xf];
+        }
+    }
+    return hex;
+}
+
+SessionStore::SessionStore(size_t max_sessions, uint64_t idle_timeout_ms, EndCallback on_end)
+    : max_sessions(max_sessions), idle_timeout_ms(idle_timeout_ms),
+      activity_resolution_ms(std::min<uint64_t>(1000, idle_timeout_ms / 8)), on_end(std::move(on_end)),
+      timers(SWEEP_TICK_MS, coarse_monotonic_ms()) {
+    // Live entries never fill more than half the table, which keeps probe sequences short
+    capacity = 64;
+    while (capacity < max_sessions * 2) capacity <<= 1;
+    mask = capacity - 1;
+    slots.reset(new Slot[capacity]);
+    timer_nodes.reset(new TimerNode[capacity]);
+    sweeper = std::thread(&SessionStore::sweep_loop, this);
+}
+
+SessionStore::~SessionStore() {
+    {
+        std::lock_guard<std::mutex> lock(timers_mutex);
+        stopping = true;
+    }
+    timers_changed.notify_one();
+    sweeper.join();
+    // Nodes must leave the wheel before either is destroyed
+    for (size_t i = 0; i < capacity; i++) {
+        timers.cancel(timer_nodes[i]);
+    }
+}
+
+SessionStore::SlotView SessionStore::read_slot(const Slot& slot) const {
+    SlotView view;
+    for (;;) {
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) continue; // Writer in progress
+        view.state = slot.state.load(std::memory_order_relaxed);
+        for (int i = 0; i < 4; i++) {
+            view.token.words[i] = slot.token[i].load(std::memory_order_relaxed);
+        }
+        view.username = slot.username.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) return view;
+    }
+}
+
+void SessionStore::lock_slot(Slot& slot) {
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    for (;;) {
+        if (sequence & 1) {
+            sequence = slot.sequence.load(std::memory_order_relaxed);
+        } else if (slot.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire,
+                                                       std::memory_order_relaxed)) {
+            break;
+        }
+    }
+    // Readers that observe any of the following stores also observe the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SessionStore::unlock_slot(Slot& slot) {
+    slot.sequence.fetch_add(1, std::memory_order_release);
+}
+
+size_t SessionStore::find_slot(const SessionToken& token, SlotView& view) const {
+    // No insert ever landed further than max_probe from its home slot
+    size_t limit = max_probe.load(std::memory_order_acquire);
+    size_t index = home_slot(token);
+    for (size_t distance = 0; distance <= limit; distance++, index = (index + 1) & mask) {
+        view = read_slot(slots[index]);
+        if (view.state == EMPTY) break;
+        if (view.state == LIVE && view.token == token) return index;
+    }
+    return capacity;
+}
+
+const std::string* SessionStore::intern(const std::string& username) {
+    std::lock_guard<std::mutex> lock(names_mutex);
+    return &*names.insert(username).first;
+}
+
+bool SessionStore::create(const std::string& username, SessionToken& token) {
+    token = SessionToken::generate();
+    return insert(token, username, coarse_monotonic_ms());
+}
+
+bool SessionStore::insert(const SessionToken& token, const std::string& username, uint64_t last_active_ms) {
+    if (live.fetch_add(1, std::memory_order_relaxed) >= max_sessions) {
+        live.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const std::string* name = intern(username);
+
+    // Take the first slot not holding a live session; tombstones are reused
+    size_t index = home_slot(token);
+    for (size_t distance = 0;; distance++, index = (index + 1) & mask) {
+        Slot& slot = slots[index];
+        if (slot.state.load(std::memory_order_relaxed) == LIVE) continue;
+        lock_slot(slot);
+        if (slot.state.load(std::memory_order_relaxed) == LIVE) {
+            unlock_slot(slot);
+            continue;
+        }
+        for (int i = 0; i < 4; i++) {
+            slot.token[i].store(token.words[i], std::memory_order_relaxed);
+        }
+        slot.username.store(name, std::memory_order_relaxed);
+        slot.last_active_ms.store(last_active_ms, std::memory_order_relaxed);
+        slot.state.store(LIVE, std::memory_order_relaxed);
+
+        size_t longest = max_probe.load(std::memory_order_relaxed);
+        while (distance > longest && !max_probe.compare_exchange_weak(longest, distance, std::memory_order_release)) {
+        }
+        unlock_slot(slot);
+        break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(timers_mutex);
+        timers.schedule(timer_nodes[index], last_active_ms + idle_timeout_ms);
+    }
+    timers_changed.notify_one();
+    return true;
+}
+
+std::vector<SessionStore::SavedSession> SessionStore::save() const {
+    std::vector<SavedSession> saved;
+    uint64_t now = coarse_monotonic_ms();
+    for (size_t i = 0; i < capacity; i++) {
+        SlotView view = read_slot(slots[i]);
+        if (view.state != LIVE) continue;
+        uint64_t last_active = slots[i].last_active_ms.load(std::memory_order_relaxed);
+        saved.push_back({view.token, *view.username, now > last_active ? now - last_active : 0});
+    }
+    return saved;
+}
+
+bool SessionStore::restore(const SavedSession& session) {
+    SlotView view;
+    if (session.idle_ms >= idle_timeout_ms || find_slot(session.token, view) != capacity) return false;
+    // Monotonic time restarts at boot, so the stamp is rebuilt from the idle time
+    uint64_t now = coarse_monotonic_ms();
+    return insert(session.token, session.username, now > session.idle_ms ? now - session.idle_ms : 0);
+}
+
+const std::string* SessionStore::validate(const SessionToken& token) {
+    SlotView view;
+    size_t index = find_slot(token, view);
+    if (index == capacity) return nullptr;
+
+    Slot& slot = slots[index];
+    uint64_t now = coarse_monotonic_ms();
+    uint64_t last_active = slot.last_active_ms.load(std::memory_order_relaxed);
+    if (now > last_active) {
+        // Idle too long: refuse it now and leave removal to the sweeper
+        if (now - last_active > idle_timeout_ms) return nullptr;
+        if (now - last_active >= activity_resolution_ms) {
+            slot.last_active_ms.store(now, std::memory_order_relaxed);
+        }
+    }
+    return view.username;
+}
+
+void SessionStore::remove(const SessionToken& token) {
+    SlotView view;
+    size_t index = find_slot(token, view);
+    if (index != capacity) {
+        erase_slot(index, token);
+    }
+}
+
+bool SessionStore::erase_slot(size_t index, const SessionToken& token) {
+    Slot& slot = slots[index];
+    bool matches;
+    {
+        // The timer is cancelled before the tombstone can be reused, or an
+        // insert landing in between would lose its own timer. timers_mutex
+        // comes first: the sweeper holds it while reading slots.
+        std::lock_guard<std::mutex> lock(timers_mutex);
+        lock_slot(slot);
+        matches = slot.state.load(std::memory_order_relaxed) == LIVE;
+        for (int i = 0; matches && i < 4; i++) {
+            matches = slot.token[i].load(std::memory_order_relaxed) == token.words[i];
+        }
+        if (matches) {
+            // A tombstone, not EMPTY: later entries may have probed past this slot
+            slot.state.store(DELETED, std::memory_order_relaxed);
+            slot.username.store(nullptr, std::memory_order_relaxed);
+            timers.cancel(timer_nodes[index]);
+        }
+        unlock_slot(slot);
+    }
+    if (!matches) return false;
+
+    live.fetch_sub(1, std::memory_order_relaxed);
+    if (on_end) on_end(token);
+    return true;
+}
+
+void SessionStore::sweep_loop() {
+    std::vector<std::pair<size_t, SessionToken>> expired;
+    std::unique_lock<std::mutex> lock(timers_mutex);
+    while (!stopping) {
+        if (timers.size() == 0) {
+            timers_changed.wait(lock);
+        } else {
+            timers_changed.wait_for(lock, std::chrono::milliseconds(timers.tick_ms()));
+        }
+        if (stopping) break;
+
+        uint64_t now = coarse_monotonic_ms();
+        timers.advance(now, [&](TimerNode& node) {
+            size_t index = &node - timer_nodes.get();
+            SlotView view = read_slot(slots[index]);
+            if (view.state != LIVE) return;
+            // Used since the timer was set: push the deadline out instead of expiring
+            uint64_t deadline = slots[index].last_active_ms.load(std::memory_order_relaxed) + idle_timeout_ms;
+            if (deadline > now) {
+                timers.schedule(node, deadline);
+            } else {
+                expired.emplace_back(index, view.token);
+            }
+        });
+
+        if (!expired.empty()) {
+            lock.unlock();
+            for (const auto& entry : expired) {
+                erase_slot(entry.first, entry.second);
+            }
+            expired.clear();
+            lock.lock();
+        }
+    }
+}
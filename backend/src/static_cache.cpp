@@ -0,0 +1,275 @@
+//static_cache.cpp
+#include "../include/static_cache.hpp"
+#include "../include/logger.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <cstring>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <openssl/sha.h>
+#include <zlib.h>
+#include <brotli/encode.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+
+// Only text formats benefit from compression
+bool is_compressible(const std::string& mime_type) {
+    return mime_type.rfind("text/", 0) == 0 ||
+           mime_type == "application/javascript" ||
+           mime_type == "application/json" ||
+           mime_type == "image/svg+xml";
+}
+
+std::shared_ptr<const std::string> gzip_compress(const std::string& input) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nullptr;
+    }
+
+    std::string output(deflateBound(&stream, input.size()), '\0');
+    stream.next_in = (Bytef*)input.data();
+    stream.avail_in = input.size();
+    stream.next_out = (Bytef*)&output[0];
+    stream.avail_out = output.size();
+    int result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    if (result != Z_STREAM_END) return nullptr;
+    return std::make_shared<const std::string>(std::move(output));
+}
+
+std::shared_ptr<const std::string> brotli_compress(const std::string& input) {
+    size_t encoded_size = BrotliEncoderMaxCompressedSize(input.size());
+    if (encoded_size == 0) return nullptr;
+
+    std::string output(encoded_size, '\0');
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               input.size(), (const uint8_t*)input.data(),
+                               &encoded_size, (uint8_t*)&output[0])) {
+        return nullptr;
+    }
+    output.resize(encoded_size);
+    return std::make_shared<const std::string>(std::move(output));
+}
+
+// Keep a precompressed variant only when it saves at least 10%
+std::shared_ptr<const std::string> worthwhile(std::shared_ptr<const std::string> compressed, size_t original) {
+    if (!compressed || compressed->size() * 10 > original * 9) return nullptr;
+    return compressed;
+}
+
+// Tag of a coded representation: strong validators differ per content-coding
+// (RFC 9110 section 8.8.3), so the coding is appended inside the quotes
+std::string coded_etag(const std::string& etag, const char* coding) {
+    return etag.substr(0, etag.size() - 1) + "-" + coding + '"';
+}
+
+std::string content_etag(const std::string& content) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256((const unsigned char*)content.data(), content.size(), hash);
+
+    std::ostringstream ss;
+    ss << '"';
+    for (int i = 0; i < 16; i++) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    }
+    ss << '"';
+    return ss.str();
+}
+
+} // namespace
+
+std::string http_date(time_t when) {
+    char buffer[64];
+    struct tm tm_utc;
+    gmtime_r(&when, &tm_utc);
+    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+    return buffer;
+}
+
+std::string weak_etag(const struct stat& st) {
+    std::ostringstream etag;
+    etag << "W/\"" << std::hex << st.st_size << "-" << st.st_mtim.tv_sec << "-" << st.st_mtim.tv_nsec << '"';
+    return etag.str();
+}
+
+std::string mime_type_for(const std::string& filename, const char* fallback) {
+    std::string ext = fs::path(filename).extension().string();
+    if (ext == ".html") return "text/html";
+    if (ext == ".css") return "text/css";
+    if (ext == ".js") return "application/javascript";
+    if (ext == ".json") return "application/json";
+    if (ext == ".txt") return "text/plain";
+    if (ext == ".svg") return "image/svg+xml";
+    if (ext == ".png") return "image/png";
+    if (ext == ".jpg" || ext == ".jpeg") return "image/jpeg";
+    if (ext == ".gif") return "image/gif";
+    if (ext == ".ico") return "image/x-icon";
+    if (ext == ".woff2") return "font/woff2";
+    if (ext == ".webp") return "image/webp";
+    if (ext == ".xml") return "application/xml";
+    if (ext == ".pdf") return "application/pdf";
+    if (ext == ".wasm") return "application/wasm";
+    if (ext == ".zip") return "application/zip";
+    if (ext == ".gz") return "application/gzip";
+    if (ext == ".mp4") return "video/mp4";
+    if (ext == ".mp3") return "audio/mpeg";
+    return fallback;
+}
+
+StaticFileCache::StaticFileCache(const std::string& root, size_t max_cached_size)
+    : root(root), max_cached_size(max_cached_size), snapshot(std::make_shared<const Snapshot>()), inotify_fd(-1) {
+}
+
+StaticFileCache::~StaticFileCache() {
+    stopping = true;
+    if (watcher.joinable()) {
+        watcher.join();
+    }
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+    }
+}
+
+void StaticFileCache::load() {
+    auto next = std::make_shared<Snapshot>();
+    scan_directory("", *next);
+    publish(next);
+    LOG_INFO << "Static cache loaded " << next->size() << " files from " << root;
+}
+
+void StaticFileCache::start_watching() {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        LOG_ERROR << "inotify unavailable, static files will not hot reload";
+        return;
+    }
+
+    std::vector<std::string> dirs = {""};
+    for (size_t i = 0; i < dirs.size(); i++) {
+        add_watch(dirs[i]);
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(root + dirs[i], ec)) {
+            if (entry.is_directory()) {
+                dirs.push_back(dirs[i] + "/" + entry.path().filename().string());
+            }
+        }
+    }
+    watcher = std::thread(&StaticFileCache::watch_loop, this);
+}
+
+std::shared_ptr<const StaticAsset> StaticFileCache::find(const std::string& url_path) const {
+    std::shared_ptr<const Snapshot> current = std::atomic_load(&snapshot);
+    auto it = current->find(url_path == "/" ? "/index.html" : url_path);
+    if (it == current->end()) return nullptr;
+    return it->second;
+}
+
+void StaticFileCache::publish(std::shared_ptr<const Snapshot> next) {
+    std::atomic_store(&snapshot, next);
+}
+
+std::shared_ptr<const StaticAsset> StaticFileCache::load_asset(const std::string& url_path) const {
+    std::string file_path = root + url_path;
+    struct stat st;
+    if (stat(file_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return nullptr;
+
+    auto asset = std::make_shared<StaticAsset>();
+    asset->file_path = file_path;
+    asset->mime_type = mime_type_for(file_path);
+    asset->last_modified = http_date(st.st_mtime);
+    asset->size = st.st_size;
+
+    if ((size_t)st.st_size > max_cached_size) {
+        // Served with sendfile(); the validator comes from metadata, hence weak
+        asset->etag = weak_etag(st);
+        return asset;
+    }
+
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) return nullptr;
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    auto content = std::make_shared<const std::string>(buffer.str());
+
+    asset->size = content->size();
+    asset->etag = content_etag(*content);
+    if (is_compressible(asset->mime_type)) {
+        asset->gzip = worthwhile(gzip_compress(*content), content->size());
+        asset->brotli = worthwhile(brotli_compress(*content), content->size());
+        if (asset->gzip) asset->gzip_etag = coded_etag(asset->etag, "gz");
+        if (asset->brotli) asset->brotli_etag = coded_etag(asset->etag, "br");
+    }
+    asset->identity = content;
+    return asset;
+}
+
+void StaticFileCache::scan_directory(const std::string& url_dir, Snapshot& next) {
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(root + url_dir, ec)) {
+        std::string url_path = url_dir + "/" + entry.path().filename().string();
+        if (entry.is_directory()) {
+            scan_directory(url_path, next);
+        } else if (auto asset = load_asset(url_path)) {
+            next[url_path] = asset;
+        }
+    }
+}
+
+void StaticFileCache::add_watch(const std::string& url_dir) {
+    int wd = inotify_add_watch(inotify_fd, (root + url_dir).c_str(), WATCH_MASK);
+    if (wd >= 0) {
+        watched_dirs[wd] = url_dir;
+    }
+}
+
+void StaticFileCache::watch_loop() {
+    alignas(struct inotify_event) char buffer[16384];
+    pollfd pfd = {inotify_fd, POLLIN, 0};
+
+    while (!stopping) {
+        if (poll(&pfd, 1, 500) <= 0) continue;
+
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) continue;
+
+        // Copy-on-write: build the next snapshot from the current one
+        auto next = std::make_shared<Snapshot>(*std::atomic_load(&snapshot));
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            auto* event = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            auto dir_it = watched_dirs.find(event->wd);
+            if (dir_it == watched_dirs.end() || event->len == 0) continue;
+            std::string url_path = dir_it->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    add_watch(url_path);
+                    scan_directory(url_path, *next);
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    std::string prefix = url_path + "/";
+                    for (auto it = next->begin(); it != next->end();) {
+                        it = (it->first.rfind(prefix, 0) == 0) ? next->erase(it) : std::next(it);
+                    }
+                }
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                next->erase(url_path);
+            } else if (auto asset = load_asset(url_path)) {
+                (*next)[url_path] = asset;
+                LOG_INFO << "Static cache reloaded " << url_path;
+            }
+        }
+        publish(next);
+    }
+}
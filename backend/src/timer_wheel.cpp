@@ -0,0 +1,50 @@
+//timer_wheel.cpp
+#include "../include/timer_wheel.hpp"
+
+TimerWheel::TimerWheel(uint64_t tick_ms, uint64_t now_ms)
+    : tick(tick_ms), current(now_ms / tick_ms), count(0) {
+    for (auto& level : slots) {
+        for (auto& slot : level) {
+            slot.prev = slot.next = &slot;
+        }
+    }
+}
+
+void TimerWheel::schedule(TimerNode& node, uint64_t deadline_ms) {
+    cancel(node);
+    // Round up so a timer never fires before its deadline
+    uint64_t expires = (deadline_ms + tick - 1) / tick;
+    node.expires = expires > current ? expires : current + 1;
+    place(node);
+    count++;
+}
+
+void TimerWheel::place(TimerNode& node) {
+    uint64_t delta = node.expires - current;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (SLOTS << (SLOT_BITS * level))) {
+        level++;
+    }
+    // Beyond the top level's span the slot is revisited each rotation and re-placed
+    TimerNode& slot = slots[level][(node.expires >> (SLOT_BITS * level)) & (SLOTS - 1)];
+
+    node.prev = slot.prev;
+    node.next = &slot;
+    slot.prev->next = &node;
+    slot.prev = &node;
+}
+
+void TimerWheel::cascade(int level) {
+    TimerNode& slot = slots[level][(current >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    if (slot.next == &slot) return;
+
+    // Detach the whole list first; re-placed nodes may land back in this slot
+    TimerNode* node = slot.next;
+    slot.prev->next = nullptr;
+    slot.prev = slot.next = &slot;
+    while (node) {
+        TimerNode* next = node->next;
+        place(*node);
+        node = next;
+    }
+}
@@ -0,0 +1,540 @@
+//user_store.cpp
+#include "../include/user_store.hpp"
+#include "../include/log_file.hpp"
+#include "../include/logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// users.log begins with LOG_MAGIC and the generation; log_file records follow
+struct UserStore::IndexHeader {
+    char magic[8];
+    uint64_t generation;       // Log generation this index describes
+    uint64_t capacity;         // Slot count, a power of two
+    uint64_t count;            // Occupied slots, one per user
+    uint64_t checkpoint;       // Log offset up to which the slots are complete on disk
+    uint64_t live_bytes;       // Size of the latest record of every user
+};
+
+struct UserStore::IndexSlot {
+    uint64_t hash;             // FNV-1a of the username
+    uint64_t offset;           // Latest record; 0 marks an empty slot
+    uint32_t length;
+    uint32_t reserved;
+};
+
+using namespace log_file;
+
+namespace {
+
+const char LOG_MAGIC[8] = {'W', 'E', 'U', 'S', 'R', 'L', 'G', '1'};
+const char INDEX_MAGIC[8] = {'W', 'E', 'U', 'S', 'R', 'I', 'X', '1'};
+const uint64_t LOG_HEADER_SIZE = 16;
+const uint8_t RECORD_VERSION = 1;
+const uint64_t SLOTS_OFFSET = 64;              // Index header, padded
+const uint64_t INITIAL_CAPACITY = 1024;
+const uint64_t CHECKPOINT_INTERVAL = 1024;     // Index updates between checkpoints
+const uint64_t COMPACT_MIN_BYTES = 1 << 20;    // Smaller logs are never compacted
+
+uint64_t hash_username(const std::string& username) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : username) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string encode_record(const User& user) {
+    std::string record = begin_record();
+    put_u8(record, RECORD_VERSION);
+    put_string(record, user.username);
+    put_string(record, user.password_hash);
+    put_string(record, user.filesystem_path);
+    put_string(record, user.api_key);
+    put_string(record, user.api_provider);
+    put_string(record, user.api_model);
+    put_i64(record, user.last_activity);
+    finish_record(record);
+    return record;
+}
+
+bool decode_payload(const std::string& payload, User& user) {
+    Reader reader(payload.data(), payload.size());
+    uint8_t version;
+    int64_t last_activity;
+    if (!reader.read_u8(version) || version != RECORD_VERSION) return false;
+    if (!reader.read_string(user.username) || !reader.read_string(user.password_hash) ||
+        !reader.read_string(user.filesystem_path) || !reader.read_string(user.api_key) ||
+        !reader.read_string(user.api_provider) || !reader.read_string(user.api_model) ||
+        !reader.read_i64(last_activity)) {
+        return false;
+    }
+    user.last_activity = (time_t)last_activity;
+    return true;
+}
+
+} // namespace
+
+UserStore::UserStore(const std::string& data_dir)
+    : log_path(data_dir + "/users.log"), index_path(data_dir + "/users.idx") {
+}
+
+UserStore::~UserStore() {
+    std::unique_lock<std::shared_mutex> store(store_mutex);
+    if (index.header && unindexed == 0) {
+        checkpoint();
+    }
+    unmap_index(index);
+    if (log_fd >= 0) close(log_fd);
+}
+
+bool UserStore::open(std::string& error) {
+    std::string data_dir = log_path.substr(0, log_path.rfind('/'));
+    std::string legacy_path = data_dir + "/users.txt";
+
+    log_fd = ::open(log_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (log_fd < 0) {
+        error = "Cannot open " + log_path + ": " + strerror(errno);
+        return false;
+    }
+
+    bool fresh = file_size(log_fd) == 0;
+    if (fresh) {
+        char log_header[LOG_HEADER_SIZE];
+        generation = 1;
+        memcpy(log_header, LOG_MAGIC, sizeof(LOG_MAGIC));
+        memcpy(log_header + 8, &generation, sizeof(generation));
+        if (!write_all(log_fd, log_header, sizeof(log_header), 0) || fdatasync(log_fd) != 0) {
+            error = "Cannot initialize " + log_path + ": " + strerror(errno);
+            return false;
+        }
+    } else {
+        char log_header[LOG_HEADER_SIZE];
+        if (!read_all(log_fd, log_header, sizeof(log_header), 0) || memcmp(log_header, LOG_MAGIC, 8) != 0) {
+            error = log_path + " is not a user log";
+            return false;
+        }
+        memcpy(&generation, log_header + 8, sizeof(generation));
+    }
+
+    // A usable index only needs the records written after its checkpoint
+    bool usable = map_index(index_path, 0, false, index) && index.header->generation == generation &&
+                  index.header->checkpoint >= LOG_HEADER_SIZE && index.header->checkpoint <= file_size(log_fd);
+    if (usable) {
+        if (!replay(index.header->checkpoint)) {
+            error = "Cannot read " + log_path;
+            return false;
+        }
+    } else {
+        LOG_INFO << "Rebuilding user index from " << log_path;
+        if (!rebuild_index()) {
+            error = "Cannot rebuild " + index_path;
+            return false;
+        }
+    }
+    fdatasync(log_fd);
+    durable_end = log_end;
+
+    if (fresh && access(legacy_path.c_str(), F_OK) == 0 && !import_legacy(legacy_path)) {
+        error = "Cannot import " + legacy_path;
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> store(store_mutex);
+    checkpoint();
+    LOG_INFO << "User store ready: " << index.header->count << " users";
+    return true;
+}
+
+bool UserStore::find(const std::string& username, User& out) {
+    return load(username) && cache.find(username, out);
+}
+
+bool UserStore::contains(const std::string& username) {
+    return load(username);
+}
+
+bool UserStore::insert(const User& user) {
+    if (load(user.username)) return false;
+
+    bool inserted = false;
+    uint64_t offset = 0, end = 0;
+    cache.upsert(user.username, [&](User& entry) {
+        if (!entry.username.empty()) return true; // Lost a race with another insert
+        end = append(user, offset);
+        entry = user;
+        inserted = true;
+        return true;
+    });
+    return inserted && commit(user.username, offset, end);
+}
+
+size_t UserStore::size() const {
+    std::shared_lock<std::shared_mutex> store(store_mutex);
+    return index.header ? index.header->count : 0;
+}
+
+bool UserStore::load(const std::string& username) {
+    if (cache.contains(username)) return true;
+
+    User user;
+    {
+        std::shared_lock<std::shared_mutex> store(store_mutex);
+        if (find_slot(hash_username(username), username, &user)->offset == 0) return false;
+    }
+    // A concurrent load may have won; either copy is current
+    cache.insert(username, std::move(user));
+    return true;
+}
+
+uint64_t UserStore::append(const User& user, uint64_t& offset) {
+    std::string record = encode_record(user);
+    std::shared_lock<std::shared_mutex> store(store_mutex);
+    std::lock_guard<std::mutex> lock(append_mutex);
+    offset = log_end;
+    if (!write_all(log_fd, record.data(), record.size(), offset)) {
+        throw std::runtime_error(std::string("Cannot append to user log: ") + strerror(errno));
+    }
+    log_end += record.size();
+    unindexed++;
+    return log_end;
+}
+
+void UserStore::wait_durable(uint64_t end) {
+    // Whoever finds no sync in flight syncs everything appended so far; the rest wait for it
+    std::unique_lock<std::mutex> lock(sync_mutex);
+    while (durable_end < end) {
+        if (syncing) {
+            sync_done.wait(lock);
+            continue;
+        }
+        syncing = true;
+        uint64_t target;
+        {
+            std::lock_guard<std::mutex> append_lock(append_mutex);
+            target = log_end;
+        }
+        lock.unlock();
+        int result = fdatasync(log_fd);
+        lock.lock();
+        syncing = false;
+        if (result == 0 && target > durable_end) durable_end = target;
+        sync_done.notify_all();
+        if (result != 0) {
+            throw std::runtime_error(std::string("Cannot sync user log: ") + strerror(errno));
+        }
+    }
+}
+
+bool UserStore::commit(const std::string& username, uint64_t offset, uint64_t end) {
+    {
+        std::shared_lock<std::shared_mutex> store(store_mutex);
+        wait_durable(end);
+    }
+
+    // The index only ever points at durable records
+    std::unique_lock<std::shared_mutex> store(store_mutex);
+    index_record(username, offset, (uint32_t)(end - offset));
+    unindexed--;
+    updates_since_checkpoint++;
+
+    // Both need every appended record indexed
+    if (unindexed == 0) {
+        uint64_t log_bytes = log_end - LOG_HEADER_SIZE;
+        if (log_bytes > COMPACT_MIN_BYTES && log_bytes > 2 * index.header->live_bytes) {
+            compact();
+        } else if (updates_since_checkpoint >= CHECKPOINT_INTERVAL) {
+            checkpoint();
+        }
+    }
+    return true;
+}
+
+bool UserStore::read_record(int fd, uint64_t offset, User& user, uint32_t& length) const {
+    std::string payload;
+    return log_file::read_record(fd, offset, payload, length) && decode_payload(payload, user);
+}
+
+UserStore::IndexSlot* UserStore::find_slot(uint64_t hash, const std::string& username, User* found) const {
+    uint64_t mask = index.header->capacity - 1;
+    for (uint64_t i = hash & mask;; i = (i + 1) & mask) {
+        IndexSlot* slot = &index.slots[i];
+        if (slot->offset == 0) return slot;
+        if (slot->hash != hash) continue;
+
+        // Full hashes rarely collide, but the record has the final say
+        User user;
+        uint32_t length;
+        if (read_record(log_fd, slot->offset, user, length) && user.username == username) {
+            if (found) *found = std::move(user);
+            return slot;
+        }
+    }
+}
+
+void UserStore::index_record(const std::string& username, uint64_t offset, uint32_t length) {
+    uint64_t hash = hash_username(username);
+    IndexSlot* slot = find_slot(hash, username);
+    if (slot->offset == 0) {
+        if ((index.header->count + 1) * 2 > index.header->capacity) {
+            grow_index();
+            slot = find_slot(hash, username);
+        }
+        slot->hash = hash;
+        slot->offset = offset;
+        slot->length = length;
+        index.header->count++;
+        index.header->live_bytes += length;
+    } else if (offset > slot->offset) {
+        // Replays and out-of-order commits never move a user back to an older record
+        index.header->live_bytes += (uint64_t)length - slot->length;
+        slot->offset = offset;
+        slot->length = length;
+    }
+}
+
+bool UserStore::map_index(const std::string& path, uint64_t capacity, bool create, Index& out) const {
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0), 0600);
+    if (fd < 0) return false;
+
+    size_t size = create ? SLOTS_OFFSET + capacity * sizeof(IndexSlot) : file_size(fd);
+    if ((create && ftruncate(fd, (off_t)size) != 0) || size < SLOTS_OFFSET) {
+        close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    Index mapping;
+    mapping.fd = fd;
+    mapping.size = size;
+    mapping.header = static_cast<IndexHeader*>(base);
+    mapping.slots = reinterpret_cast<IndexSlot*>(static_cast<char*>(base) + SLOTS_OFFSET);
+    if (create) {
+        memcpy(mapping.header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+        mapping.header->generation = generation;
+        mapping.header->capacity = capacity;
+        mapping.header->checkpoint = LOG_HEADER_SIZE;
+    } else {
+        uint64_t stored_capacity = mapping.header->capacity;
+        bool valid = memcmp(mapping.header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && stored_capacity != 0 &&
+                     (stored_capacity & (stored_capacity - 1)) == 0 &&
+                     size == SLOTS_OFFSET + stored_capacity * sizeof(IndexSlot);
+        if (!valid) {
+            unmap_index(mapping);
+            return false;
+        }
+    }
+    out = mapping;
+    return true;
+}
+
+void UserStore::unmap_index(Index& mapping) const {
+    if (mapping.header) munmap(mapping.header, mapping.size);
+    if (mapping.fd >= 0) close(mapping.fd);
+    mapping = Index();
+}
+
+void UserStore::grow_index() {
+    std::string temp_path = index_path + ".tmp";
+    Index grown;
+    if (!map_index(temp_path, index.header->capacity * 2, true, grown)) {
+        throw std::runtime_error("Cannot grow user index");
+    }
+    grown.header->count = index.header->count;
+    grown.header->live_bytes = index.header->live_bytes;
+    grown.header->checkpoint = index.header->checkpoint;
+
+    // Hashes are already unique per user, so slots move without touching the log
+    uint64_t mask = grown.header->capacity - 1;
+    for (uint64_t i = 0; i < index.header->capacity; i++) {
+        const IndexSlot& slot = index.slots[i];
+        if (slot.offset == 0) continue;
+        uint64_t target = slot.hash & mask;
+        while (grown.slots[target].offset != 0) target = (target + 1) & mask;
+        grown.slots[target] = slot;
+    }
+
+    msync(grown.header, grown.size, MS_SYNC);
+    rename(temp_path.c_str(), index_path.c_str());
+    unmap_index(index);
+    index = grown;
+}
+
+bool UserStore::rebuild_index() {
+    unmap_index(index);
+    if (!map_index(index_path, INITIAL_CAPACITY, true, index)) return false;
+    return replay(LOG_HEADER_SIZE);
+}
+
+bool UserStore::replay(uint64_t from) {
+    uint64_t size = file_size(log_fd);
+    uint64_t offset = from;
+    uint64_t records = 0;
+    while (offset < size) {
+        User user;
+        uint32_t length;
+        if (!read_record(log_fd, offset, user, length)) break;
+        index_record(user.username, offset, length);
+        offset += length;
+        records++;
+    }
+    // Anything after the last whole record is a write cut short by a crash
+    if (offset < size) {
+        LOG_WARN << "Discarding " << (size - offset) << " bytes of incomplete user log";
+        if (ftruncate(log_fd, (off_t)offset) != 0) return false;
+    }
+    if (records > 0) {
+        LOG_INFO << "Replayed " << records << " user log records";
+    }
+    log_end = offset;
+    return true;
+}
+
+void UserStore::checkpoint() {
+    // Slots first, then the header that vouches for them
+    msync(index.header, index.size, MS_SYNC);
+    index.header->checkpoint = log_end;
+    msync(index.header, SLOTS_OFFSET, MS_SYNC);
+    updates_since_checkpoint = 0;
+}
+
+void UserStore::compact() {
+    std::string data_dir = log_path.substr(0, log_path.rfind('/'));
+    std::string temp_log = log_path + ".compact";
+    std::string temp_index = index_path + ".compact";
+    uint64_t next_generation = generation + 1;
+
+    int fd = ::open(temp_log.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    Index compacted;
+    if (fd < 0) return;
+    std::swap(generation, next_generation);
+    bool mapped = map_index(temp_index, index.header->capacity, true, compacted);
+    std::swap(generation, next_generation);
+    if (!mapped) {
+        close(fd);
+        return;
+    }
+
+    // Copy each user's latest record, in slot order, into the new generation
+    std::string buffer(LOG_HEADER_SIZE, '\0');
+    memcpy(&buffer[0], LOG_MAGIC, sizeof(LOG_MAGIC));
+    memcpy(&buffer[8], &next_generation, sizeof(next_generation));
+    uint64_t end = 0;
+    bool ok = true;
+    for (uint64_t i = 0; ok && i < index.header->capacity; i++) {
+        const IndexSlot& slot = index.slots[i];
+        if (slot.offset == 0) continue;
+        size_t start = buffer.size();
+        buffer.resize(start + slot.length);
+        ok = read_all(log_fd, &buffer[start], slot.length, slot.offset);
+        compacted.slots[i] = slot;
+        compacted.slots[i].offset = end + start;
+        if (buffer.size() >= COMPACT_MIN_BYTES) {
+            ok = ok && write_all(fd, buffer.data(), buffer.size(), end);
+            end += buffer.size();
+            buffer.clear();
+        }
+    }
+    ok = ok && write_all(fd, buffer.data(), buffer.size(), end) && fdatasync(fd) == 0;
+    end += buffer.size();
+    if (!ok) {
+        LOG_ERROR << "User log compaction failed: " << strerror(errno);
+        unmap_index(compacted);
+        close(fd);
+        unlink(temp_log.c_str());
+        unlink(temp_index.c_str());
+        return;
+    }
+
+    compacted.header->count = index.header->count;
+    compacted.header->live_bytes = index.header->live_bytes;
+    compacted.header->checkpoint = end;
+    msync(compacted.header, compacted.size, MS_SYNC);
+
+    // A crash between the renames leaves an index of the wrong generation, which is rebuilt
+    rename(temp_log.c_str(), log_path.c_str());
+    rename(temp_index.c_str(), index_path.c_str());
+    sync_directory(data_dir);
+
+    LOG_INFO << "Compacted user log from " << log_end << " to " << end << " bytes";
+    close(log_fd);
+    unmap_index(index);
+    log_fd = fd;
+    index = compacted;
+    generation = next_generation;
+    {
+        std::lock_guard<std::mutex> append_lock(append_mutex);
+        log_end = end;
+    }
+    {
+        std::lock_guard<std::mutex> sync_lock(sync_mutex);
+        durable_end = end;
+    }
+    updates_since_checkpoint = 0;
+}
+
+bool UserStore::import_legacy(const std::string& path) {
+    LOG_INFO << "Importing users from: " << path;
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    struct Pending {
+        std::string username;
+        uint64_t offset;
+        uint64_t end;
+    };
+    std::vector<Pending> pending;
+    std::string line;
+    int line_number = 0;
+
+    while (std::getline(file, line)) {
+        line_number++;
+        if (line.empty()) continue;
+
+        std::istringstream line_stream(line);
+        User user;
+        std::string last_activity_str;
+        if (!std::getline(line_stream, user.username, '|') || !std::getline(line_stream, user.password_hash, '|') ||
+            !std::getline(line_stream, user.filesystem_path, '|') || !std::getline(line_stream, last_activity_str, '|')) {
+            LOG_WARN << "Invalid user data at line " << line_number;
+            continue;
+        }
+        try {
+            user.last_activity = std::stol(last_activity_str);
+        } catch (const std::exception&) {
+            LOG_WARN << "Invalid timestamp at line " << line_number << ", using current time";
+            user.last_activity = time(nullptr);
+        }
+
+        // API key fields are optional, for backward compatibility
+        user.api_provider = "openai";
+        user.api_model = "gpt-3.5-turbo";
+        if (std::getline(line_stream, user.api_key, '|') && std::getline(line_stream, user.api_provider, '|')) {
+            std::getline(line_stream, user.api_model, '|');
+        }
+
+        Pending record{user.username, 0, 0};
+        record.end = append(user, record.offset);
+        pending.push_back(std::move(record));
+    }
+
+    // One sync covers the whole import
+    for (const Pending& record : pending) {
+        commit(record.username, record.offset, record.end);
+    }
+    file.close();
+    rename(path.c_str(), (path + ".imported").c_str());
+    LOG_INFO << "Imported " << pending.size() << " users";
+    return true;
+}
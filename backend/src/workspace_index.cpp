@@ -0,0 +1,483 @@
+//workspace_index.cpp
+#include "../include/workspace_index.hpp"
+#include "../include/logger.hpp"
+#include "../include/metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_MODIFY |
+                            IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+// How long a workspace that did not fit is served from the disk before indexing is tried again
+const uint64_t RETRY_INTERVAL_MS = 60 * 1000;
+// Dead bytes in a name arena before it is compacted
+const size_t MIN_COMPACTION_BYTES = 4096;
+
+} // namespace
+
+WorkspaceIndex::WorkspaceIndex(const std::string& users_root, size_t memory_budget)
+    : users_root(users_root), memory_budget(memory_budget) {
+    if (memory_budget == 0) return;
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        LOG_WARN << "inotify unavailable, workspace listings will read the disk: " << strerror(errno);
+    }
+}
+
+WorkspaceIndex::~WorkspaceIndex() {
+    stopping = true;
+    if (watcher.joinable()) watcher.join();
+    if (inotify_fd >= 0) close(inotify_fd);
+}
+
+void WorkspaceIndex::start_watching() {
+    if (inotify_fd < 0 || watcher.joinable()) return;
+    watcher = std::thread(&WorkspaceIndex::watch_loop, this);
+}
+
+WorkspaceIndex::Result WorkspaceIndex::list(const std::string& username, const std::string& relative_dir,
+                                            const ListingQuery& query, ListingPage& page) {
+    std::vector<ListingEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Tree* tree = tree_for(username);
+        uint32_t dir;
+        if (!tree || !resolve(*tree, relative_dir, dir)) return Result::UNAVAILABLE;
+        if (dir == NO_NODE) return Result::NOT_FOUND;
+        const Node& node = tree->nodes[dir];
+        if (!node.indexed) return node.is_directory ? Result::UNAVAILABLE : Result::NOT_FOUND;
+
+        entries.reserve(node.children.size());
+        for (uint32_t child : node.children) {
+            entries.push_back(entry_of(*tree, child));
+        }
+    }
+    return select_page(entries, query, page) ? Result::FOUND : Result::BAD_CURSOR;
+}
+
+WorkspaceIndex::Result WorkspaceIndex::find(const std::string& username, const std::string& relative_path,
+                                            ListingEntry& entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Tree* tree = tree_for(username);
+    uint32_t node;
+    if (!tree || !resolve(*tree, relative_path, node)) return Result::UNAVAILABLE;
+    if (node == NO_NODE) return Result::NOT_FOUND;
+    entry = entry_of(*tree, node);
+    return Result::FOUND;
+}
+
+WorkspaceIndex::Result WorkspaceIndex::paths(const std::string& username, std::shared_ptr<const PathList>& list) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Tree* tree = tree_for(username);
+    if (!tree) return Result::UNAVAILABLE;
+    // Shared, so matching runs outside the lock against a consistent snapshot
+    list = path_list_of(*tree);
+    return Result::FOUND;
+}
+
+WorkspaceIndex::Result WorkspaceIndex::paths(const std::string& username, std::shared_ptr<const PathList>& list,
+                                             std::vector<FileStamp>& stamps) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Tree* tree = tree_for(username);
+    if (!tree) return Result::UNAVAILABLE;
+    list = path_list_of(*tree);
+    stamps.resize(tree->path_nodes.size());
+    for (size_t i = 0; i < stamps.size(); i++) {
+        const Node& node = tree->nodes[tree->path_nodes[i]];
+        stamps[i] = {node.size, node.modified_ns};
+    }
+    return Result::FOUND;
+}
+
+size_t WorkspaceIndex::memory_used() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_bytes;
+}
+
+size_t WorkspaceIndex::user_count() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return trees.size();
+}
+
+WorkspaceIndex::Tree* WorkspaceIndex::tree_for(const std::string& username) {
+    if (inotify_fd < 0 || username.empty() || username == "." || username == ".." ||
+        username.find('/') != std::string::npos) {
+        return nullptr;
+    }
+    drain_events();
+
+    auto it = trees.find(username);
+    if (it != trees.end()) {
+        it->second->last_used = ++use_clock;
+        return it->second.get();
+    }
+
+    uint64_t now_ms = monotonic_us() / 1000;
+    auto retry = retry_after_ms.find(username);
+    if (retry != retry_after_ms.end()) {
+        if (now_ms < retry->second) return nullptr;
+        retry_after_ms.erase(retry);
+    }
+    // No workspace yet: nothing to index, and nothing to remember
+    struct stat st;
+    if (stat((users_root + "/" + username).c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return nullptr;
+
+    auto created = std::make_unique<Tree>();
+    created->username = username;
+    Tree* tree = created.get();
+    trees[username] = std::move(created);
+    if (!build(*tree)) {
+        drop_tree(username);
+        retry_after_ms[username] = now_ms + RETRY_INTERVAL_MS;
+        LOG_WARN << "Workspace of " << username << " not indexed: over the memory budget or out of inotify watches";
+        return nullptr;
+    }
+    tree->last_used = ++use_clock;
+    LOG_DEBUG << "Indexed workspace" << log_field("user", username)
+              << log_field("entries", std::to_string(tree->nodes.size())) << log_field("bytes", std::to_string(tree->bytes));
+    enforce_budget(tree);
+    return tree;
+}
+
+bool WorkspaceIndex::build(Tree& tree) {
+    uint32_t root = add_node(tree, NO_NODE, "");
+    bool real_directory;
+    return stat_node(tree, root, real_directory) && real_directory && scan_directory(tree, root);
+}
+
+bool WorkspaceIndex::scan_directory(Tree& tree, uint32_t node) {
+    std::string path = path_of(tree, node);
+    // Watch before reading, so nothing created during the scan is missed
+    int watch = inotify_add_watch(inotify_fd, path.c_str(), WATCH_MASK);
+    if (watch < 0) {
+        // Gone already; the event removing it is queued
+        return errno == ENOENT || errno == ENOTDIR;
+    }
+    watches[watch] = {&tree, node};
+    tree.nodes[node].watch = watch;
+    tree.nodes[node].indexed = true;
+
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return true;
+    int dir_fd = dirfd(dir);
+    std::vector<uint32_t> subdirectories;
+    while (dirent* d = readdir(dir)) {
+        if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+        struct stat st;
+        if (fstatat(dir_fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+        bool real_directory = S_ISDIR(st.st_mode);
+        // Symlinks are listed as their target but never descended into
+        if (S_ISLNK(st.st_mode)) fstatat(dir_fd, d->d_name, &st, 0);
+
+        uint32_t child = add_node(tree, NO_NODE, d->d_name);
+        Node& entry = tree.nodes[child];
+        entry.parent = node;
+        entry.is_directory = S_ISDIR(st.st_mode);
+        entry.size = S_ISREG(st.st_mode) ? (uint64_t)st.st_size : 0;
+        entry.modified_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        tree.nodes[node].children.push_back(child);
+        tree.child_slots++;
+        if (real_directory) subdirectories.push_back(child);
+    }
+    closedir(dir);
+
+    // Sorted once here rather than by insertion
+    std::vector<uint32_t>& children = tree.nodes[node].children;
+    std::sort(children.begin(), children.end(),
+              [&](uint32_t a, uint32_t b) { return tree.name(a) < tree.name(b); });
+    account(tree);
+    if (tree.bytes > memory_budget) return false;
+
+    for (uint32_t child : subdirectories) {
+        if (!scan_directory(tree, child)) return false;
+    }
+    return true;
+}
+
+bool WorkspaceIndex::stat_node(Tree& tree, uint32_t node, bool& real_directory) {
+    std::string path = path_of(tree, node);
+    struct stat st;
+    if (lstat(path.c_str(), &st) < 0) return false;
+    real_directory = S_ISDIR(st.st_mode);
+    if (S_ISLNK(st.st_mode)) stat(path.c_str(), &st);
+
+    Node& entry = tree.nodes[node];
+    entry.is_directory = S_ISDIR(st.st_mode);
+    entry.size = S_ISREG(st.st_mode) ? (uint64_t)st.st_size : 0;
+    entry.modified_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+uint32_t WorkspaceIndex::add_node(Tree& tree, uint32_t parent, std::string_view name) {
+    uint32_t index;
+    if (!tree.free_nodes.empty()) {
+        index = tree.free_nodes.back();
+        tree.free_nodes.pop_back();
+    } else {
+        index = (uint32_t)tree.nodes.size();
+        tree.nodes.emplace_back();
+    }
+    tree.path_list.reset();
+    Node& node = tree.nodes[index];
+    node.parent = parent;
+    node.name_offset = (uint32_t)tree.names.size();
+    node.name_length = (uint32_t)name.size();
+    node.live = true;
+    tree.names.append(name);
+
+    if (parent != NO_NODE) {
+        std::vector<uint32_t>& siblings = tree.nodes[parent].children;
+        auto position = std::lower_bound(siblings.begin(), siblings.end(), name,
+                                         [&](uint32_t sibling, std::string_view key) { return tree.name(sibling) < key; });
+        siblings.insert(position, index);
+        tree.child_slots++;
+    }
+    return index;
+}
+
+void WorkspaceIndex::remove_node(Tree& tree, uint32_t node) {
+    tree.path_list.reset();
+    uint32_t parent = tree.nodes[node].parent;
+    if (parent != NO_NODE) {
+        std::vector<uint32_t>& siblings = tree.nodes[parent].children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), node));
+        tree.child_slots--;
+    }
+
+    std::vector<uint32_t> pending = {node};
+    while (!pending.empty()) {
+        uint32_t current = pending.back();
+        pending.pop_back();
+        Node& removed = tree.nodes[current];
+        if (removed.watch >= 0) {
+            // A directory moved out of the workspace keeps its watch unless it is removed here
+            inotify_rm_watch(inotify_fd, removed.watch);
+            watches.erase(removed.watch);
+        }
+        pending.insert(pending.end(), removed.children.begin(), removed.children.end());
+        tree.child_slots -= removed.children.size();
+        tree.dead_name_bytes += removed.name_length;
+        removed = Node();
+        tree.free_nodes.push_back(current);
+    }
+}
+
+uint32_t WorkspaceIndex::find_child(const Tree& tree, uint32_t parent, std::string_view name) const {
+    const std::vector<uint32_t>& siblings = tree.nodes[parent].children;
+    auto position = std::lower_bound(siblings.begin(), siblings.end(), name,
+                                     [&](uint32_t sibling, std::string_view key) { return tree.name(sibling) < key; });
+    if (position == siblings.end() || tree.name(*position) != name) return NO_NODE;
+    return *position;
+}
+
+bool WorkspaceIndex::resolve(const Tree& tree, const std::string& relative_path, uint32_t& node) const {
+    uint32_t current = 0;
+    size_t start = 0;
+    while (start < relative_path.size()) {
+        size_t end = relative_path.find('/', start);
+        if (end == std::string::npos) end = relative_path.size();
+        std::string_view segment(relative_path.data() + start, end - start);
+        start = end + 1;
+        if (segment.empty() || segment == ".") continue;
+        if (segment == "..") return false;
+
+        const Node& parent = tree.nodes[current];
+        if (!parent.indexed) {
+            // Below a symlinked directory the disk has to answer; below a file nothing exists
+            if (parent.is_directory) return false;
+            node = NO_NODE;
+            return true;
+        }
+        current = find_child(tree, current, segment);
+        if (current == NO_NODE) break;
+    }
+    node = current;
+    return true;
+}
+
+std::string WorkspaceIndex::path_of(const Tree& tree, uint32_t node) const {
+    std::vector<std::string_view> segments;
+    for (uint32_t current = node; current != 0 && current != NO_NODE; current = tree.nodes[current].parent) {
+        segments.push_back(tree.name(current));
+    }
+    std::string path = users_root + "/" + tree.username;
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        path += '/';
+        path += *it;
+    }
+    return path;
+}
+
+ListingEntry WorkspaceIndex::entry_of(const Tree& tree, uint32_t node) const {
+    const Node& source = tree.nodes[node];
+    ListingEntry entry;
+    entry.name = std::string(tree.name(node));
+    entry.size = source.size;
+    entry.last_modified = (time_t)(source.modified_ns / 1000000000);
+    entry.is_directory = source.is_directory;
+    return entry;
+}
+
+const std::shared_ptr<const PathList>& WorkspaceIndex::path_list_of(Tree& tree) {
+    if (!tree.path_list) {
+        auto built = std::make_shared<PathList>();
+        std::string prefix;
+        tree.path_nodes.clear();
+        collect_paths(tree, 0, prefix, *built, tree.path_nodes);
+        tree.path_list = std::move(built);
+        account(tree);
+        enforce_budget(&tree);
+    }
+    return tree.path_list;
+}
+
+void WorkspaceIndex::collect_paths(const Tree& tree, uint32_t node, std::string& prefix, PathList& list,
+                                   std::vector<uint32_t>& nodes) const {
+    size_t length = prefix.size();
+    for (uint32_t child : tree.nodes[node].children) {
+        prefix.resize(length);
+        if (length != 0) prefix += '/';
+        prefix += tree.name(child);
+        list.add(prefix, tree.nodes[child].is_directory);
+        nodes.push_back(child);
+        if (tree.nodes[child].indexed) collect_paths(tree, child, prefix, list, nodes);
+    }
+    prefix.resize(length);
+}
+
+void WorkspaceIndex::drain_events() {
+    alignas(struct inotify_event) char buffer[16384];
+    bool changed = false;
+    ssize_t length;
+    while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        changed = true;
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            auto* event = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; every tree is suspect
+                LOG_WARN << "Workspace index missed inotify events, rebuilding trees on demand";
+                while (!trees.empty()) {
+                    std::string username = trees.begin()->first;
+                    drop_tree(username);
+                }
+                continue;
+            }
+            auto watch = watches.find(event->wd);
+            if (watch == watches.end()) continue;
+            Tree& tree = *watch->second.tree;
+            uint32_t node = watch->second.node;
+
+            if (event->mask & IN_IGNORED) {
+                tree.nodes[node].watch = -1;
+                watches.erase(watch);
+            } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // Below the root, the parent's event covers it
+                if (node == 0) {
+                    std::string username = tree.username;
+                    drop_tree(username);
+                }
+            } else if (event->len > 0) {
+                apply_event(tree, node, event->mask, event->name);
+            }
+        }
+    }
+    if (!changed) return;
+
+    for (auto& pair : trees) {
+        account(*pair.second);
+    }
+    enforce_budget(nullptr);
+}
+
+void WorkspaceIndex::apply_event(Tree& tree, uint32_t dir, uint32_t mask, const char* name) {
+    uint32_t child = find_child(tree, dir, name);
+    bool real_directory = false;
+    if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (child != NO_NODE) remove_node(tree, child);
+    } else if (mask & (IN_CREATE | IN_MOVED_TO)) {
+        // Whatever had this name before has been replaced
+        if (child != NO_NODE) remove_node(tree, child);
+        child = add_node(tree, dir, name);
+        if (!stat_node(tree, child, real_directory)) {
+            remove_node(tree, child);
+        } else if (real_directory && !scan_directory(tree, child)) {
+            std::string username = tree.username;
+            drop_tree(username);
+            return;
+        }
+    } else if (child != NO_NODE && !stat_node(tree, child, real_directory)) {
+        remove_node(tree, child);
+    }
+
+    // Adding or removing an entry moves the directory's own modification time
+    if (mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) {
+        stat_node(tree, dir, real_directory);
+    }
+}
+
+void WorkspaceIndex::account(Tree& tree) {
+    if (tree.dead_name_bytes > MIN_COMPACTION_BYTES && tree.dead_name_bytes > tree.names.size() / 2) {
+        std::string names;
+        names.reserve(tree.names.size() - tree.dead_name_bytes);
+        for (Node& node : tree.nodes) {
+            if (!node.live) continue;
+            std::string_view name(tree.names.data() + node.name_offset, node.name_length);
+            node.name_offset = (uint32_t)names.size();
+            names.append(name);
+        }
+        tree.names = std::move(names);
+        tree.dead_name_bytes = 0;
+    }
+
+    size_t bytes = sizeof(Tree) + tree.nodes.capacity() * sizeof(Node) + tree.names.capacity() +
+                   tree.child_slots * sizeof(uint32_t) + tree.free_nodes.capacity() * sizeof(uint32_t) +
+                   (tree.path_list ? tree.path_list->memory_used() : 0) + tree.path_nodes.capacity() * sizeof(uint32_t);
+    total_bytes = total_bytes - tree.bytes + bytes;
+    tree.bytes = bytes;
+}
+
+void WorkspaceIndex::enforce_budget(const Tree* keep) {
+    while (total_bytes > memory_budget) {
+        const Tree* victim = nullptr;
+        for (const auto& pair : trees) {
+            const Tree* candidate = pair.second.get();
+            if (candidate != keep && (!victim || candidate->last_used < victim->last_used)) victim = candidate;
+        }
+        if (!victim) break;
+        std::string username = victim->username;
+        drop_tree(username);
+    }
+}
+
+void WorkspaceIndex::drop_tree(const std::string& username) {
+    auto it = trees.find(username);
+    if (it == trees.end()) return;
+    Tree& tree = *it->second;
+    for (const Node& node : tree.nodes) {
+        if (node.live && node.watch >= 0) {
+            inotify_rm_watch(inotify_fd, node.watch);
+            watches.erase(node.watch);
+        }
+    }
+    total_bytes -= tree.bytes;
+    trees.erase(it);
+}
+
+void WorkspaceIndex::watch_loop() {
+    pollfd pfd = {inotify_fd, POLLIN, 0};
+    while (!stopping) {
+        if (poll(&pfd, 1, 500) <= 0) continue;
+        std::lock_guard<std::mutex> lock(mutex);
+        drain_events();
+    }
+}
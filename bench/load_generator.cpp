@@ -0,0 +1,556 @@
+//load_generator.cpp
+// HTTP load generator for the editor's API. Drives scripted workloads over
+// keep-alive connections in closed-loop (send on reply) or open-loop (send
+// on a fixed schedule) mode and prints one JSON object per workload.
+#include "metrics.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 8080;
+    std::vector<std::string> workloads;
+    bool open_loop = false;
+    double rate = 1000;          // Open loop: requests per second over all connections
+    size_t connections = 16;
+    size_t threads = 2;
+    double duration = 10;        // Seconds measured, after the warmup
+    double warmup = 1;
+    size_t users = 4;
+    size_t body_size = 4096;     // Saved and uploaded file size
+};
+
+const char* const WORKLOADS[] = {"login", "files", "file", "save", "upload", "commit", "terminal", "mixed"};
+
+struct BenchUser {
+    std::string name;
+    std::string password;
+    std::string token;
+};
+
+// Incremental HTTP/1.1 response reader: Content-Length and chunked bodies
+class ResponseReader {
+public:
+    enum class Status { NEED_MORE, DONE, ERROR };
+
+    explicit ResponseReader(bool keep_body = false) : keep_body(keep_body) {}
+
+    // Consume bytes from the front of buffer; leftovers stay for the next response
+    Status feed(std::string& buffer) {
+        while (true) {
+            switch (state) {
+            case State::HEAD: {
+                size_t end = buffer.find("\r\n\r\n");
+                if (end == std::string::npos) return Status::NEED_MORE;
+                if (!parse_head(buffer.substr(0, end))) return Status::ERROR;
+                buffer.erase(0, end + 4);
+                state = chunked ? State::CHUNK_SIZE : State::BODY;
+                break;
+            }
+            case State::BODY:
+                if (!take(buffer)) return Status::NEED_MORE;
+                return finish();
+            case State::CHUNK_SIZE: {
+                size_t end = buffer.find("\r\n");
+                if (end == std::string::npos) return Status::NEED_MORE;
+                remaining = strtoull(buffer.c_str(), nullptr, 16);
+                buffer.erase(0, end + 2);
+                state = remaining == 0 ? State::TRAILER : State::CHUNK_DATA;
+                break;
+            }
+            case State::CHUNK_DATA:
+                if (!take(buffer)) return Status::NEED_MORE;
+                remaining = 2;
+                state = State::CHUNK_END;
+                break;
+            case State::CHUNK_END:
+                if (buffer.size() < remaining) return Status::NEED_MORE;
+                buffer.erase(0, remaining);
+                state = State::CHUNK_SIZE;
+                break;
+            case State::TRAILER: {
+                size_t end = buffer.find("\r\n");
+                if (end == std::string::npos) return Status::NEED_MORE;
+                buffer.erase(0, end + 2);
+                if (end == 0) return finish();
+                break;
+            }
+            }
+        }
+    }
+
+    int status() const { return status_code; }
+    bool close_after() const { return close; }
+    const std::string& body() const { return body_text; }
+
+private:
+    enum class State { HEAD, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_END, TRAILER };
+
+    bool parse_head(const std::string& head) {
+        status_code = 0;
+        chunked = close = false;
+        remaining = 0;
+        body_text.clear();
+        if (head.compare(0, 5, "HTTP/") != 0 || head.size() < 12) return false;
+        status_code = atoi(head.c_str() + 9);
+        size_t line = head.find("\r\n");
+        while (line != std::string::npos) {
+            size_t start = line + 2;
+            line = head.find("\r\n", start);
+            std::string field = head.substr(start, line == std::string::npos ? std::string::npos : line - start);
+            size_t colon = field.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = field.substr(0, colon);
+            std::string value = field.substr(colon + 1);
+            if (strcasecmp(name.c_str(), "Content-Length") == 0) remaining = strtoull(value.c_str(), nullptr, 10);
+            if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) chunked = value.find("chunked") != std::string::npos;
+            if (strcasecmp(name.c_str(), "Connection") == 0) close = value.find("close") != std::string::npos;
+        }
+        return status_code > 0;
+    }
+
+    // Consume up to remaining body bytes; true once all have arrived
+    bool take(std::string& buffer) {
+        size_t count = std::min<size_t>(remaining, buffer.size());
+        if (keep_body) body_text.append(buffer, 0, count);
+        buffer.erase(0, count);
+        remaining -= count;
+        return remaining == 0;
+    }
+
+    Status finish() {
+        state = State::HEAD;
+        return Status::DONE;
+    }
+
+    bool keep_body;
+    State state = State::HEAD;
+    int status_code = 0;
+    bool chunked = false;
+    bool close = false;
+    uint64_t remaining = 0;
+    std::string body_text;
+};
+
+int connect_to(const Options& options, bool blocking) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | (blocking ? 0 : SOCK_NONBLOCK), 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+    if (connect(fd, (sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::string build_request(const char* method, const std::string& path, const BenchUser* user,
+                          const std::string& content_type = "", const std::string& body = "") {
+    std::string request = std::string(method) + " " + path + " HTTP/1.1\r\nHost: localhost\r\n";
+    if (user && !user->token.empty()) request += "Cookie: session=" + user->token + "\r\n";
+    if (!content_type.empty()) request += "Content-Type: " + content_type + "\r\n";
+    if (!body.empty() || strcmp(method, "POST") == 0) {
+        request += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    return request + "\r\n" + body;
+}
+
+// Blocking round trip, used to prepare users before the measured run
+bool round_trip(const Options& options, const std::string& request, int& status, std::string& body) {
+    int fd = connect_to(options, true);
+    if (fd < 0) return false;
+    bool sent = send(fd, request.data(), request.size(), MSG_NOSIGNAL) == (ssize_t)request.size();
+    ResponseReader reader(true);
+    std::string buffer;
+    ResponseReader::Status result = ResponseReader::Status::NEED_MORE;
+    char chunk[16384];
+    while (sent && result == ResponseReader::Status::NEED_MORE) {
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) break;
+        buffer.append(chunk, received);
+        result = reader.feed(buffer);
+    }
+    close(fd);
+    if (result != ResponseReader::Status::DONE) return false;
+    status = reader.status();
+    body = reader.body();
+    return true;
+}
+
+std::string payload(size_t size, uint64_t sequence) {
+    std::string content = "v" + std::to_string(sequence) + "-";
+    while (content.size() < size) content += "abcdefghijklmnopqrstuvwxyz0123456789";
+    content.resize(size);
+    return content;
+}
+
+std::string auth_body(const BenchUser& user, const char* action) {
+    return "{\"username\":\"" + user.name + "\",\"password\":\"" + user.password + "\",\"action\":\"" + action + "\"}";
+}
+
+// Register (if needed) and log in every user, then give each a file and a repository
+bool prepare_users(const Options& options, std::vector<BenchUser>& users) {
+    for (size_t i = 0; i < options.users; i++) {
+        BenchUser user{"bench" + std::to_string(i), "bench-password-" + std::to_string(i), ""};
+        int status;
+        std::string body;
+        if (!round_trip(options, build_request("POST", "/api/auth", nullptr, "application/json", auth_body(user, "register")),
+                        status, body)) {
+            fprintf(stderr, "Cannot reach %s:%u\n", options.host.c_str(), options.port);
+            return false;
+        }
+        if (!round_trip(options, build_request("POST", "/api/auth", nullptr, "application/json", auth_body(user, "login")),
+                        status, body) || status != 200) {
+            fprintf(stderr, "Login failed for %s: %s\n", user.name.c_str(), body.c_str());
+            return false;
+        }
+        size_t token_start = body.find("\"token\": \"");
+        if (token_start == std::string::npos) return false;
+        token_start += 10;
+        user.token = body.substr(token_start, body.find('"', token_start) - token_start);
+
+        const char* form = "application/x-www-form-urlencoded";
+        round_trip(options, build_request("POST", "/api/create", &user, form, "filename=bench.txt"), status, body);
+        round_trip(options, build_request("POST", "/api/save", &user, form,
+                                          "filename=bench.txt&content=" + payload(options.body_size, 0)), status, body);
+        round_trip(options, build_request("POST", "/api/init-repo", &user, form, "path="), status, body);
+        users.push_back(user);
+    }
+    return true;
+}
+
+// The request a connection sends as its sequence'th, for a workload
+std::string next_request(const std::string& workload, const Options& options, const BenchUser& user,
+                         size_t connection, uint64_t sequence) {
+    const char* form = "application/x-www-form-urlencoded";
+    std::string kind = workload;
+    if (workload == "commit") {
+        // Edit, commit, look at the log
+        static const char* const steps[] = {"save", "commit-only", "history"};
+        kind = steps[sequence % 3];
+    } else if (workload == "mixed") {
+        // Roughly an editing session: browse, open, save, now and then commit
+        static const char* const steps[] = {"files", "file", "file", "save", "file", "files", "save", "history",
+                                            "file", "commit-only"};
+        kind = steps[sequence % 10];
+    }
+
+    if (kind == "login") {
+        return build_request("POST", "/api/auth", nullptr, "application/json", auth_body(user, "login"));
+    }
+    if (kind == "files") return build_request("GET", "/api/files", &user);
+    if (kind == "file") return build_request("GET", "/api/file?filename=bench.txt", &user);
+    if (kind == "history") return build_request("GET", "/api/history?path=", &user);
+    if (kind == "save") {
+        return build_request("POST", "/api/save", &user, form,
+                             "filename=bench.txt&content=" + payload(options.body_size, sequence));
+    }
+    if (kind == "commit-only") {
+        return build_request("POST", "/api/commit", &user, form, "path=&message=bench+" + std::to_string(sequence));
+    }
+    if (kind == "upload") {
+        std::string boundary = "benchboundary" + std::to_string(connection);
+        std::string body = "--" + boundary + "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"upload" +
+                           std::to_string(connection) + ".txt\"\r\nContent-Type: text/plain\r\n\r\n" +
+                           payload(options.body_size, sequence) + "\r\n--" + boundary + "--\r\n";
+        return build_request("POST", "/api/upload", &user, "multipart/form-data; boundary=" + boundary, body);
+    }
+    return build_request("POST", "/api/terminal/execute", &user, "application/json", "{\"command\":\"ls\"}");
+}
+
+struct RunStats {
+    LatencyHistogram latency;
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> errors{0};           // 4xx/5xx answers and broken connections
+};
+
+struct ClientConnection {
+    int fd = -1;
+    size_t index = 0;
+    const BenchUser* user = nullptr;
+    std::string out;
+    size_t out_offset = 0;
+    std::string in;
+    ResponseReader reader;
+    bool busy = false;
+    uint64_t started_us = 0;     // Open loop: when the request was due, not when it went out
+    uint64_t next_due_us = 0;
+    uint64_t sequence = 0;
+};
+
+class LoadThread {
+public:
+    LoadThread(const Options& options, const std::string& workload, const std::vector<BenchUser>& users,
+               size_t first_connection, size_t connection_count, RunStats& stats)
+        : options(options), workload(workload), stats(stats), connections(connection_count) {
+        for (size_t i = 0; i < connection_count; i++) {
+            connections[i].index = first_connection + i;
+            connections[i].user = &users[(first_connection + i) % users.size()];
+        }
+        // Each connection carries an equal share of the open-loop rate
+        interval_us = (uint64_t)(1e6 * (double)options.connections / options.rate);
+    }
+
+    void run(uint64_t start_us, uint64_t measure_from_us, uint64_t end_us) {
+        this->measure_from_us = measure_from_us;
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        for (auto& conn : connections) {
+            // Stagger open-loop schedules so connections do not fire in lockstep
+            conn.next_due_us = start_us + interval_us * conn.index / options.connections;
+            if (!open_connection(conn)) stats.errors++;
+        }
+        if (!options.open_loop) {
+            for (auto& conn : connections) {
+                if (conn.fd >= 0) send_next(conn, monotonic_us());
+            }
+        }
+
+        epoll_event events[256];
+        while (true) {
+            uint64_t now = monotonic_us();
+            if (now >= end_us) break;
+            int timeout_ms = (int)((end_us - now) / 1000) + 1;
+            if (options.open_loop) {
+                for (auto& conn : connections) {
+                    if (conn.busy || conn.fd < 0) continue;
+                    if (conn.next_due_us <= now) {
+                        send_next(conn, conn.next_due_us);
+                    } else {
+                        timeout_ms = std::min<int>(timeout_ms, (int)((conn.next_due_us - now) / 1000));
+                    }
+                }
+            }
+            int count = epoll_wait(epoll_fd, events, 256, timeout_ms);
+            for (int i = 0; i < count; i++) {
+                ClientConnection& conn = connections[events[i].data.u64];
+                if (!service(conn)) reconnect(conn);
+            }
+        }
+        for (auto& conn : connections) {
+            if (conn.fd >= 0) close(conn.fd);
+        }
+        close(epoll_fd);
+    }
+
+private:
+    bool open_connection(ClientConnection& conn) {
+        conn.fd = connect_to(options, false);
+        if (conn.fd < 0) return false;
+        epoll_event event = {};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = &conn - connections.data();
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn.fd, &event);
+        conn.in.clear();
+        conn.reader = ResponseReader();
+        return true;
+    }
+
+    void reconnect(ClientConnection& conn) {
+        if (conn.busy) stats.errors++;
+        conn.busy = false;
+        close(conn.fd);
+        if (!open_connection(conn)) {
+            stats.errors++;
+            return;
+        }
+        if (!options.open_loop) send_next(conn, monotonic_us());
+    }
+
+    void send_next(ClientConnection& conn, uint64_t started_us) {
+        conn.out = next_request(workload, options, *conn.user, conn.index, conn.sequence++);
+        conn.out_offset = 0;
+        conn.started_us = started_us;
+        conn.busy = true;
+        conn.next_due_us += interval_us;
+        flush(conn);
+    }
+
+    bool flush(ClientConnection& conn) {
+        while (conn.out_offset < conn.out.size()) {
+            ssize_t sent = send(conn.fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset,
+                                MSG_NOSIGNAL);
+            if (sent < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+            conn.out_offset += sent;
+        }
+        return true;
+    }
+
+    // Handle readiness; false if the connection must be replaced
+    bool service(ClientConnection& conn) {
+        if (!flush(conn)) return false;
+        char buffer[65536];
+        bool peer_closed = false;
+        while (true) {
+            ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                conn.in.append(buffer, received);
+                continue;
+            }
+            if (received == 0) peer_closed = true;
+            else if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            break;
+        }
+
+        while (conn.busy) {
+            ResponseReader::Status status = conn.reader.feed(conn.in);
+            if (status == ResponseReader::Status::ERROR) return false;
+            if (status == ResponseReader::Status::NEED_MORE) break;
+
+            uint64_t now = monotonic_us();
+            conn.busy = false;
+            if (conn.started_us >= measure_from_us) {
+                stats.latency.record(now - conn.started_us);
+                stats.completed++;
+                if (conn.reader.status() >= 400) stats.errors++;
+            }
+            if (conn.reader.close_after()) return false;
+            if (!options.open_loop) {
+                send_next(conn, now);
+            } else if (conn.next_due_us <= now) {
+                // Behind schedule: latency still counts from when the request was due
+                send_next(conn, conn.next_due_us);
+            }
+        }
+        return !peer_closed;
+    }
+
+    const Options& options;
+    const std::string& workload;
+    RunStats& stats;
+    std::vector<ClientConnection> connections;
+    uint64_t interval_us = 0;
+    uint64_t measure_from_us = 0;
+    int epoll_fd = -1;
+};
+
+void run_workload(const Options& options, const std::string& workload, const std::vector<BenchUser>& users) {
+    RunStats stats;
+    uint64_t start_us = monotonic_us();
+    uint64_t measure_from_us = start_us + (uint64_t)(options.warmup * 1e6);
+    uint64_t end_us = measure_from_us + (uint64_t)(options.duration * 1e6);
+
+    size_t thread_count = std::max<size_t>(1, std::min(options.threads, options.connections));
+    std::vector<std::unique_ptr<LoadThread>> loaders;
+    std::vector<std::thread> threads;
+    size_t first = 0;
+    for (size_t i = 0; i < thread_count; i++) {
+        size_t count = options.connections / thread_count + (i < options.connections % thread_count ? 1 : 0);
+        loaders.push_back(std::make_unique<LoadThread>(options, workload, users, first, count, stats));
+        first += count;
+    }
+    for (auto& loader : loaders) {
+        threads.emplace_back([&, loader = loader.get()] { loader->run(start_us, measure_from_us, end_us); });
+    }
+    for (auto& thread : threads) thread.join();
+
+    const LatencyHistogram& latency = stats.latency;
+    uint64_t completed = stats.completed.load();
+    printf("{\"workload\":\"%s\",\"mode\":\"%s\",\"connections\":%zu,\"threads\":%zu,", workload.c_str(),
+           options.open_loop ? "open" : "closed", options.connections, thread_count);
+    if (options.open_loop) printf("\"target_rps\":%.1f,", options.rate);
+    printf("\"duration_s\":%.3f,\"requests\":%llu,\"errors\":%llu,\"rps\":%.1f,"
+           "\"latency_us\":{\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+           options.duration, (unsigned long long)completed, (unsigned long long)stats.errors.load(),
+           completed / options.duration, completed ? (double)latency.sum() / completed : 0.0,
+           (unsigned long long)latency.value_at_percentile(50), (unsigned long long)latency.value_at_percentile(90),
+           (unsigned long long)latency.value_at_percentile(99), (unsigned long long)latency.value_at_percentile(99.9),
+           (unsigned long long)latency.value_at_percentile(100));
+    fflush(stdout);
+}
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --host ADDR           Server IPv4 address (127.0.0.1)\n"
+            "  --port N              Server port (8080)\n"
+            "  --workload LIST       Comma-separated workloads, or all (all):\n"
+            "                        login, files, file, save, upload, commit, terminal, mixed\n"
+            "  --mode closed|open    Send on each reply, or on a fixed schedule (closed)\n"
+            "  --rate N              Open loop: requests per second in total (1000)\n"
+            "  --connections N       Concurrent keep-alive connections (16)\n"
+            "  --threads N           Client threads (2)\n"
+            "  --duration SECS       Measured time per workload (10)\n"
+            "  --warmup SECS         Unmeasured time before it (1)\n"
+            "  --users N             Accounts the connections share (4)\n"
+            "  --body-size BYTES     Saved and uploaded file size (4096)\n"
+            "Prints one JSON object per workload; latencies are in microseconds.\n",
+            program);
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    std::string workloads = "all";
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--help" || i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        if (flag == "--host") options.host = value;
+        else if (flag == "--port") options.port = (uint16_t)atoi(value.c_str());
+        else if (flag == "--workload") workloads = value;
+        else if (flag == "--mode" && (value == "open" || value == "closed")) options.open_loop = value == "open";
+        else if (flag == "--rate") options.rate = atof(value.c_str());
+        else if (flag == "--connections") options.connections = strtoull(value.c_str(), nullptr, 10);
+        else if (flag == "--threads") options.threads = strtoull(value.c_str(), nullptr, 10);
+        else if (flag == "--duration") options.duration = atof(value.c_str());
+        else if (flag == "--warmup") options.warmup = atof(value.c_str());
+        else if (flag == "--users") options.users = strtoull(value.c_str(), nullptr, 10);
+        else if (flag == "--body-size") options.body_size = strtoull(value.c_str(), nullptr, 10);
+        else return false;
+    }
+    if (options.connections == 0 || options.users == 0 || options.duration <= 0 || options.rate <= 0) return false;
+
+    if (workloads == "all") {
+        options.workloads.assign(std::begin(WORKLOADS), std::end(WORKLOADS));
+        return true;
+    }
+    size_t start = 0;
+    while (start <= workloads.size()) {
+        size_t end = workloads.find(',', start);
+        if (end == std::string::npos) end = workloads.size();
+        std::string name = workloads.substr(start, end - start);
+        bool known = false;
+        for (const char* workload : WORKLOADS) known = known || name == workload;
+        if (!known) return false;
+        options.workloads.push_back(name);
+        start = end + 1;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<BenchUser> users;
+    if (!prepare_users(options, users)) return 1;
+    for (const std::string& workload : options.workloads) {
+        run_workload(options, workload, users);
+    }
+    return 0;
+}
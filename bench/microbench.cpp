@@ -0,0 +1,347 @@
+//microbench.cpp
+// Microbenchmarks for the server's per-request helpers and for whole
+// requests through WebServer::dispatch(). Each benchmark runs
+// its operation in growing batches until a batch takes the minimum time,
+// then reports ns/op along with the heap allocations and bytes each
+// operation requested, counted by replacing the global operator new.
+#include "content_search.hpp"
+#include "logger.hpp"
+#include "response_writer.hpp"
+#include "server.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Allocations made by this thread; the server's idle pool threads do not count
+struct AllocationCounter {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+thread_local AllocationCounter allocation_counter;
+
+void* counted_allocate(size_t size) {
+    allocation_counter.allocations++;
+    allocation_counter.bytes += size;
+    if (void* memory = malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+} // namespace
+
+void* operator new(size_t size) { return counted_allocate(size); }
+void* operator new[](size_t size) { return counted_allocate(size); }
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+
+namespace {
+
+struct Options {
+    double min_time = 0.2;       // Seconds for the measured batch
+    std::string filter;          // Run benchmarks whose name contains this
+    bool json = false;
+};
+
+// Keep the optimizer from discarding a benchmark's result
+template <typename T>
+void keep(const T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+uint64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+template <typename Operation>
+void run_benchmark(const Options& options, const char* name, Operation&& operation) {
+    if (!options.filter.empty() && std::string(name).find(options.filter) == std::string::npos) return;
+
+    operation();    // Warm caches and any lazily built state
+    uint64_t iterations = 1;
+    while (true) {
+        AllocationCounter before = allocation_counter;
+        uint64_t start = monotonic_ns();
+        for (uint64_t i = 0; i < iterations; i++) operation();
+        uint64_t elapsed = monotonic_ns() - start;
+        AllocationCounter after = allocation_counter;
+
+        if (elapsed >= options.min_time * 1e9 || iterations >= (1ull << 40)) {
+            double ns_per_op = (double)elapsed / iterations;
+            double allocs_per_op = (double)(after.allocations - before.allocations) / iterations;
+            double bytes_per_op = (double)(after.bytes - before.bytes) / iterations;
+            if (options.json) {
+                printf("{\"benchmark\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,"
+                       "\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f}\n",
+                       name, (unsigned long long)iterations, ns_per_op, allocs_per_op, bytes_per_op);
+            } else {
+                printf("%-36s %12llu %12.1f %10.2f %12.1f\n", name, (unsigned long long)iterations, ns_per_op,
+                       allocs_per_op, bytes_per_op);
+            }
+            fflush(stdout);
+            return;
+        }
+        // Aim past the minimum time from the rate so far, growing at most 100x per step
+        double target = elapsed > 0 ? options.min_time * 1e9 * 1.2 / elapsed * iterations : iterations * 100.0;
+        iterations = std::max(iterations + 1, std::min(iterations * 100, (uint64_t)target));
+    }
+}
+
+std::string payload(size_t size) {
+    std::string text;
+    text.reserve(size);
+    const char* line = "    for (size_t i = 0; i < count; i++) total += values[i] * 2; // \"sum\" & more\n";
+    while (text.size() < size) text += line;
+    text.resize(size);
+    return text;
+}
+
+const char* const REQUEST_HEADERS =
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: application/json, text/plain, */*\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Referer: http://localhost:8080/\r\n"
+    "Cookie: theme=dark; session=3f2a9c4b7d1e8f60a5b4c3d2e1f0a9b87c6d5e4f3a2b1c0d9e8f7a6b5c4d3e2f\r\n"
+    "Connection: keep-alive\r\n";
+
+} // namespace
+
+// Friend of WebServer: drives its private helpers against a scratch data directory
+class MicroBenchmarks {
+public:
+    explicit MicroBenchmarks(const Options& options) : options(options) {}
+
+    int run() {
+        char scratch_template[] = "/tmp/webeditor-microbench-XXXXXX";
+        if (!mkdtemp(scratch_template)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        scratch = scratch_template;
+        fs::create_directories(scratch + "/frontend");
+
+        ServerConfig config;
+        config.data_dir = scratch + "/data";
+        config.frontend_dir = scratch + "/frontend";
+        config.worker_threads = 1;
+        config.crypto_threads = 1;
+        {
+            WebServer server(config);
+            prepare_workspace(server);
+            if (!options.json) {
+                printf("%-36s %12s %12s %10s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+            }
+            run_all(server);
+        }
+        fs::remove_all(scratch);
+        return 0;
+    }
+
+private:
+    static constexpr const char* USER = "bench";
+    static const size_t LISTED_FILES = 64;
+
+    void prepare_workspace(WebServer& server) {
+        std::string home = server.create_user_filesystem(USER);
+        fs::create_directories(home + "/src/module");
+        std::string content = payload(4096);
+        for (size_t i = 0; i < LISTED_FILES; i++) {
+            server.write_file_content(home + "/src/file" + std::to_string(i) + ".cpp", content);
+        }
+    }
+
+    void run_all(WebServer& server) {
+        std::string get_request = "GET /api/file?path=src%2Fmodule%2Fmain%20file.cpp&directory=src HTTP/1.1\r\n" +
+                                  std::string(REQUEST_HEADERS) + "\r\n";
+        std::string save_body = "{\"path\":\"src/main.cpp\",\"content\":\"" + payload(4096) + "\"}";
+        std::string post_request = "POST /api/save HTTP/1.1\r\n" + std::string(REQUEST_HEADERS) +
+                                   "Content-Type: application/json\r\nContent-Length: " +
+                                   std::to_string(save_body.size()) + "\r\n\r\n" + save_body;
+
+        run_benchmark(options, "parse_http_request/get", [&] { keep(server.parse_http_request(get_request)); });
+        run_benchmark(options, "parse_http_request/post_4k", [&] { keep(server.parse_http_request(post_request)); });
+
+        // Handlers build an HttpResponse and the loop serializes it with a ResponseWriter
+        std::string json_body = "{\"success\": true, \"message\": \"File saved successfully\", \"path\": \"src/main.cpp\"}";
+        run_benchmark(options, "build_http_response/json", [&] {
+            HttpResponse response{200, "OK", {{"Content-Type", "application/json"}}, json_body};
+            ResponseWriter writer(std::move(response));
+            keep(writer);
+        });
+        std::string file_body = payload(4096);
+        run_benchmark(options, "build_http_response/headers_4k", [&] {
+            HttpResponse response{200, "OK", {{"Content-Type", "text/plain; charset=utf-8"},
+                                              {"ETag", "\"5f3a9c-1000\""},
+                                              {"Last-Modified", "Thu, 15 Oct 2026 09:12:44 GMT"},
+                                              {"Cache-Control", "no-cache"},
+                                              {"Vary", "Accept-Encoding"}}, file_body};
+            ResponseWriter writer(std::move(response));
+            keep(writer);
+        });
+
+        std::string path = "src/module/main file (copy).cpp";
+        std::string encoded_path = server.url_encode(path);
+        std::string content = payload(4096);
+        std::string encoded_content = server.url_encode(content);
+        run_benchmark(options, "url_encode/path", [&] { keep(server.url_encode(path)); });
+        run_benchmark(options, "url_encode/4k", [&] { keep(server.url_encode(content)); });
+        run_benchmark(options, "url_decode/path", [&] { keep(server.url_decode(encoded_path)); });
+        run_benchmark(options, "url_decode/4k", [&] { keep(server.url_decode(encoded_content)); });
+
+        HttpRequest cookie_request = server.parse_http_request(get_request);
+        run_benchmark(options, "extract_session_token", [&] { keep(server.extract_session_token(cookie_request)); });
+
+        std::string large_content = payload(64 * 1024);
+        run_benchmark(options, "calculate_file_hash/4k", [&] { keep(server.calculate_file_hash(content)); });
+        run_benchmark(options, "calculate_file_hash/64k", [&] { keep(server.calculate_file_hash(large_content)); });
+
+        run_benchmark(options, "list_user_files/64x4k", [&] { keep(server.list_user_files(USER, "src")); });
+        std::string listed_dir = server.get_user_home_directory(USER) + "/src";
+        ListingQuery first_page;
+        first_page.limit = 16;
+        run_benchmark(options, "list_directory/name_page_16", [&] {
+            ListingPage page;
+            keep(list_directory(listed_dir, first_page, page));
+        });
+
+        // A 100k-path workspace: 1000 directories of 100 files, three levels deep
+        PathList paths;
+        for (int i = 0; i < 100000; i++) {
+            char path[96];
+            snprintf(path, sizeof(path), "src/module_%02d/component%02d/file_%05d_handler.cpp", i / 10000,
+                     i / 100 % 100, i);
+            paths.add(path, false);
+        }
+        std::vector<FuzzyMatch> matches;
+        run_benchmark(options, "fuzzy_find/100k_sparse", [&] { keep(fuzzy_find(paths, "c42f99", 20, matches)); });
+        run_benchmark(options, "fuzzy_find/100k_dense", [&] { keep(fuzzy_find(paths, "hndlr", 20, matches)); });
+
+        // Content search over 1 MiB of text without a match, so the whole buffer is scanned
+        std::string text = payload(1024 * 1024);
+        std::string error;
+        SearchPattern literal, folded, expression;
+        literal.compile("needle_value", false, false, error);
+        folded.compile("Needle_Value", false, true, error);
+        expression.compile("needle_[a-z]+ =", true, false, error);
+        auto scan = [&](const SearchPattern& pattern) {
+            size_t start, length;
+            return pattern.find(text.data(), text.size(), 0, start, length);
+        };
+        run_benchmark(options, "search_find/literal_1m", [&] { keep(scan(literal)); });
+        run_benchmark(options, "search_find/ignore_case_1m", [&] { keep(scan(folded)); });
+        run_benchmark(options, "search_find/regex_1m", [&] { keep(scan(expression)); });
+        run_benchmark(options, "trigram_filter/build_64k", [&] {
+            keep(TrigramFilter::build(large_content.data(), large_content.size()).memory_used());
+        });
+
+        run_benchmark(options, "sanitize_path/existing", [&] { keep(server.sanitize_path("src/module", USER)); });
+        run_benchmark(options, "sanitize_path/new_file", [&] { keep(server.sanitize_path("src/new.cpp", USER)); });
+        run_benchmark(options, "sanitize_path/escape", [&] { keep(server.sanitize_path("../../etc", USER)); });
+
+        run_dispatch(server);
+    }
+
+    static HttpRequest make_request(const char* method, const char* path, const std::string& token,
+                                    std::string body = "") {
+        HttpRequest request;
+        request.method = method;
+        request.path = path;
+        request.version = "HTTP/1.1";
+        request.headers["Host"] = "localhost";
+        if (!token.empty()) request.headers["Cookie"] = "session=" + token;
+        if (!body.empty()) request.headers["Content-Type"] = "application/x-www-form-urlencoded";
+        request.body = std::move(body);
+        return request;
+    }
+
+    // Whole requests through the public in-process API, as an embedder would send them
+    void run_dispatch(WebServer& server) {
+        std::string credentials = "{\"username\":\"dispatch\",\"password\":\"dispatch-password\",\"action\":\"";
+        server.dispatch(make_request("POST", "/api/auth", "", credentials + "register\"}"));
+        HttpResponse login = server.dispatch(make_request("POST", "/api/auth", "", credentials + "login\"}"));
+        size_t token_start = login.body.find("\"token\": \"");
+        if (login.status_code != 200 || token_start == std::string::npos) {
+            fprintf(stderr, "dispatch login failed: %d %s\n", login.status_code, login.body.c_str());
+            return;
+        }
+        token_start += 10;
+        std::string token = login.body.substr(token_start, login.body.find('"', token_start) - token_start);
+
+        std::string save_body = "filename=bench.txt&content=" + server.url_encode(payload(4096));
+        server.dispatch(make_request("POST", "/api/create", token, "filename=bench.txt"));
+        server.dispatch(make_request("POST", "/api/save", token, save_body));
+
+        run_benchmark(options, "dispatch/files", [&] {
+            HttpResponse response = server.dispatch(make_request("GET", "/api/files", token));
+            collect_body(response);
+            keep(response);
+        });
+        run_benchmark(options, "dispatch/file_4k", [&] {
+            HttpRequest request = make_request("GET", "/api/file", token);
+            request.query_params["filename"] = "bench.txt";
+            HttpResponse response = server.dispatch(std::move(request));
+            collect_body(response);
+            keep(response);
+        });
+        run_benchmark(options, "dispatch/save_4k", [&] {
+            keep(server.dispatch(make_request("POST", "/api/save", token, save_body)));
+        });
+        run_benchmark(options, "dispatch/unauthorized", [&] {
+            keep(server.dispatch(make_request("GET", "/api/files", "")));
+        });
+    }
+
+    const Options& options;
+    std::string scratch;
+};
+
+namespace {
+
+void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --time SECS           Minimum measured time per benchmark (0.2)\n"
+            "  --filter TEXT         Run benchmarks whose name contains TEXT\n"
+            "  --json                One JSON object per benchmark instead of a table\n",
+            program);
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--json") {
+            options.json = true;
+            continue;
+        }
+        if (flag == "--help" || i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        if (flag == "--time") options.min_time = atof(value.c_str());
+        else if (flag == "--filter") options.filter = value;
+        else return false;
+    }
+    return options.min_time > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage(argv[0]);
+        return 2;
+    }
+    logging::configure(LogLevel::WARN, LogFormat::TEXT);
+    return MicroBenchmarks(options).run();
+}
@@ -0,0 +1,35 @@
+#!/bin/bash
+# Start a scratch server and run the load generator against it.
+#
+#   BENCH_PORT       Port for the scratch server (18080)
+#   BENCH_WORKLOADS  Comma-separated workloads (all)
+#   BENCH_ARGS       Extra load generator options, e.g. "--mode open --rate 2000"
+#   SERVER_ARGS      Extra server options
+#
+# Results go to stdout and build/bench-results.jsonl, one JSON object per
+# workload; the server's /api/metrics at the end goes to build/bench-metrics.txt.
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+BUILD="$ROOT/build"
+PORT=${BENCH_PORT:-18080}
+WORKLOADS=${BENCH_WORKLOADS:-all}
+
+SCRATCH=$(mktemp -d)
+"$BUILD/webserver" --port "$PORT" --data-dir "$SCRATCH/data" --frontend-dir "$ROOT/frontend" \
+    --log-level warn --metrics-public $SERVER_ARGS > "$SCRATCH/server.log" 2>&1 &
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null; wait $SERVER 2>/dev/null; rm -rf "$SCRATCH"' EXIT
+
+for _ in $(seq 50); do
+    (echo > "/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+    kill -0 $SERVER 2>/dev/null || { cat "$SCRATCH/server.log"; exit 1; }
+    sleep 0.1
+done
+
+"$BUILD/load_generator" --port "$PORT" --workload "$WORKLOADS" $BENCH_ARGS | tee "$BUILD/bench-results.jsonl"
+
+if command -v curl > /dev/null; then
+    curl -s "http://127.0.0.1:$PORT/api/metrics" > "$BUILD/bench-metrics.txt"
+fi
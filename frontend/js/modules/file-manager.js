@@ -2,7 +2,6 @@
 class FileManager {
     constructor() {
         this.files = [];
-        this.allFiles = [];
         this.currentPath = '';
         this.currentFile = null;
         this.hasUnsavedChanges = false;
@@ -28,7 +27,8 @@ class FileManager {
     async loadUserFiles(path = '') {
         this.currentPath = path;
         try {
-            const response = await fetch(`/api/files?path=${encodeURIComponent(path)}`, {
+            // Search goes through /api/find, so the top level is not needed again
+            const response = await fetch(`/api/files?path=${encodeURIComponent(path)}&allFiles=false`, {
                 method: 'GET',
                 credentials: 'include'
             });
@@ -37,7 +37,6 @@ class FileManager {
                 const data = await response.json();
                 if (data.success) {
                     this.files = data.files || [];
-                    this.allFiles = data.allFiles || [];
                     this.renderFileList();
                     this.updateBreadcrumb();
                 } else {
@@ -164,28 +163,28 @@ class FileManager {
         if (!path) return;
         
         try {
-            const response = await fetch(`/api/file?filename=${encodeURIComponent(path)}`, {
+            // Raw bytes, decoded as UTF-8 by the browser
+            const response = await fetch(`/api/raw?filename=${encodeURIComponent(path)}`, {
                 method: 'GET',
                 credentials: 'include'
             });
             
             if (response.ok) {
-                const data = await response.json();
-                if (data.success) {
-                    this.currentFile = {
-                        name: path,
-                        content: decodeURIComponent(data.content),
-                        originalContent: decodeURIComponent(data.content)
-                    };
-                    
-                    if (window.editorManager) {
-                        window.editorManager.loadFile(this.currentFile);
-                    }
-                    
-                    this.renderFileList(); // Update active state
-                } else {
-                    showNotification(`Failed to open file: ${data.message}`, 'error');
+                const content = await response.text();
+                this.currentFile = {
+                    name: path,
+                    content: content,
+                    originalContent: content
+                };
+                
+                if (window.editorManager) {
+                    window.editorManager.loadFile(this.currentFile);
                 }
+                
+                this.renderFileList(); // Update active state
+            } else {
+                const data = await response.json().catch(() => ({ message: `HTTP ${response.status}` }));
+                showNotification(`Failed to open file: ${data.message}`, 'error');
             }
         } catch (error) {
             console.error('Error opening file:', error);
@@ -263,7 +262,6 @@ class FileManager {
 
     clearFiles() {
         this.files = [];
-        this.allFiles = [];
         this.currentPath = '';
         this.currentFile = null;
         this.hasUnsavedChanges = false;
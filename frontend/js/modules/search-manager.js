@@ -65,7 +65,7 @@ class SearchManager {
         }
     }
 
-    performSearch(query) {
+    async performSearch(query) {
         if (!query) {
             this.searchResults.innerHTML = `
                 <div class="empty-search">
@@ -76,77 +76,71 @@ class SearchManager {
             return;
         }
         
-        const allFiles = window.fileManager ? window.fileManager.allFiles : [];
-        const results = this.fuzzySearch(allFiles, query);
+        // Ranked on the server against every path in the workspace
+        const results = await this.findFiles(query);
+        if (results === null || query !== this.searchInput.value.trim()) {
+            return;
+        }
         
         if (results.length === 0) {
             this.searchResults.innerHTML = `
                 <div class="empty-search">
                     <i class="fas fa-search"></i>
-                    <p>No files found matching "${query}"</p>
+                    <p>No files found matching "${this.escapeHtml(query)}"</p>
                 </div>
             `;
             return;
         }
         
         this.searchResults.innerHTML = results.map(result => `
-            <div class="search-result-item" onclick="searchManager.selectSearchResult('${result.fullPath}', ${result.isDirectory})">
+            <div class="search-result-item" data-path="${this.escapeHtml(result.path)}" data-directory="${result.isDirectory}">
                 <i class="fas ${result.isDirectory ? 'fa-folder' : 'fa-file-alt'}"></i>
                 <div class="search-result-info">
-                    <div class="search-result-name">${this.highlightMatch(result.name, query)}</div>
-                    <div class="search-result-path">${result.fullPath}</div>
+                    <div class="search-result-name">${this.highlightMatch(result)}</div>
+                    <div class="search-result-path">${this.escapeHtml(result.path)}</div>
                 </div>
             </div>
         `).join('');
+        this.searchResults.querySelectorAll('.search-result-item').forEach(item => {
+            item.addEventListener('click', () => {
+                this.selectSearchResult(item.dataset.path, item.dataset.directory === 'true');
+            });
+        });
     }
 
-    fuzzySearch(files, query) {
-        const results = [];
-        const queryLower = query.toLowerCase();
-        
-        files.forEach(file => {
-            const nameLower = file.name.toLowerCase();
-            const pathLower = file.fullPath.toLowerCase();
-            
-            // Check if query matches file name or path
-            if (nameLower.includes(queryLower) || pathLower.includes(queryLower)) {
-                const score = this.calculateSearchScore(file, queryLower);
-                results.push({
-                    ...file,
-                    score: score
-                });
+    async findFiles(query) {
+        try {
+            const response = await fetch(`/api/find?q=${encodeURIComponent(query)}&limit=10`, {
+                method: 'GET',
+                credentials: 'include'
+            });
+            if (!response.ok) {
+                return null;
             }
-        });
-        
-        // Sort by relevance score
-        return results.sort((a, b) => b.score - a.score).slice(0, 10);
+            const data = await response.json();
+            return data.success ? data.results : null;
+        } catch (error) {
+            console.error('Error searching files:', error);
+            return null;
+        }
     }
 
-    calculateSearchScore(file, query) {
-        const nameLower = file.name.toLowerCase();
-        const pathLower = file.fullPath.toLowerCase();
-        
-        let score = 0;
-        
-        // Exact name match gets highest score
-        if (nameLower === query) score += 100;
-        // Name starts with query
-        else if (nameLower.startsWith(query)) score += 50;
-        // Name contains query
-        else if (nameLower.includes(query)) score += 25;
-        
-        // Path contains query
-        if (pathLower.includes(query)) score += 10;
-        
-        // Directories get slight bonus
-        if (file.isDirectory) score += 5;
-        
-        return score;
+    escapeHtml(text) {
+        return text.replace(/&/g, '&amp;').replace(/</g, '&lt;').replace(/>/g, '&gt;')
+            .replace(/"/g, '&quot;').replace(/'/g, '&#39;');
     }
 
-    highlightMatch(text, query) {
-        const regex = new RegExp(`(${query.replace(/[.*+?^${}()|[\]\\]/g, '\\$&')})`, 'gi');
-        return text.replace(regex, '<span class="highlight">$1</span>');
+    // Highlight the matched characters of the result's name; positions are
+    // UTF-8 byte offsets into its full path
+    highlightMatch(result) {
+        const encoder = new TextEncoder();
+        const matched = new Set(result.positions || []);
+        let offset = encoder.encode(result.path).length - encoder.encode(result.name).length;
+        return Array.from(result.name).map(char => {
+            const hit = matched.has(offset);
+            offset += encoder.encode(char).length;
+            return hit ? `<span class="highlight">${this.escapeHtml(char)}</span>` : this.escapeHtml(char);
+        }).join('');
     }
 
     selectSearchResult(path, isDirectory) {
@@ -54,6 +54,102 @@ DIR_RESPONSE=$(curl -s -X POST http://localhost:8080/api/create-dir \
 
 echo "Directory creation response: $DIR_RESPONSE"
 
+# Test metrics access (assumes the server runs without --metrics-public)
+echo "7. Testing metrics without a session..."
+METRICS_STATUS=$(curl -s -o /dev/null -w "%{http_code}" http://localhost:8080/api/metrics)
+if [ "$METRICS_STATUS" = "401" ]; then
+    echo "✅ Metrics refused without a session"
+else
+    echo "❌ Metrics returned $METRICS_STATUS without a session, expected 401"
+fi
+
+# Test raw file ranges and validators
+echo "8. Testing raw file ranges..."
+curl -s -X POST http://localhost:8080/api/save \
+    -H "Content-Type: application/x-www-form-urlencoded" \
+    -b cookies.txt \
+    -d "filename=range.txt&content=0123456789" > /dev/null
+RAW_URL="http://localhost:8080/api/raw?filename=range.txt"
+
+RANGE_BODY=$(curl -s -b cookies.txt -H "Range: bytes=2-5" -w " %{http_code}" "$RAW_URL")
+if [ "$RANGE_BODY" = "2345 206" ]; then
+    echo "✅ Single range returned 206 with its bytes"
+else
+    echo "❌ Single range returned '$RANGE_BODY', expected '2345 206'"
+fi
+
+RANGE_STATUS=$(curl -s -o /dev/null -b cookies.txt -H "Range: bytes=20-" -w "%{http_code}" "$RAW_URL")
+if [ "$RANGE_STATUS" = "416" ]; then
+    echo "✅ Range past the end returned 416"
+else
+    echo "❌ Range past the end returned $RANGE_STATUS, expected 416"
+fi
+
+RANGE_BODY=$(curl -s -b cookies.txt -H "Range: bytes=0-1,4-5" -w " %{http_code}" "$RAW_URL")
+if [ "$RANGE_BODY" = "0123456789 200" ]; then
+    echo "✅ Multiple ranges fell back to the whole file"
+else
+    echo "❌ Multiple ranges returned '$RANGE_BODY', expected '0123456789 200'"
+fi
+
+ETAG=$(curl -s -o /dev/null -D - -b cookies.txt "$RAW_URL" | tr -d '\r' | sed -n 's/^[Ee][Tt][Aa][Gg]: //p')
+RANGE_STATUS=$(curl -s -o /dev/null -b cookies.txt -H "If-None-Match: $ETAG" -w "%{http_code}" "$RAW_URL")
+if [ -n "$ETAG" ] && [ "$RANGE_STATUS" = "304" ]; then
+    echo "✅ If-None-Match with the ETag returned 304"
+else
+    echo "❌ If-None-Match with ETag '$ETAG' returned $RANGE_STATUS, expected 304"
+fi
+
+# Test content search; the match count comes from the final summary line
+echo "9. Testing content search..."
+save_file() {
+    curl -s -X POST http://localhost:8080/api/save \
+        -H "Content-Type: application/x-www-form-urlencoded" \
+        -b cookies.txt \
+        --data-urlencode "filename=$1" \
+        --data-urlencode "content=$2" > /dev/null
+}
+search_summary() {
+    curl -s -G http://localhost:8080/api/search -b cookies.txt --data-urlencode "q=$1" "${@:2}" | tail -n 1
+}
+check_search() {
+    local expected="$1" summary
+    shift
+    summary=$(search_summary "$@")
+    if [[ "$summary" == *"\"matches\":$expected,"* ]]; then
+        echo "✅ Search '$1' found $expected"
+    else
+        echo "❌ Search '$1' returned '$summary', expected $expected matches"
+    fi
+}
+save_file search-literal.txt "$(printf 'Needle one\nneedle two\nneedle three')"
+save_file search-alternation.txt "quux"
+save_file search-optional.txt "abcefg"
+save_file search-interval.txt "wxyabc"
+save_file search-escape.txt "sum(x) = abc_def"
+save_file search-class.txt "abc7def"
+save_file search-bracket.txt "abc]def"
+
+check_search 2 "needle"
+check_search 3 "NEEDLE" -d ignoreCase=true
+SEARCH_SUMMARY=$(search_summary "needle" -d limit=1)
+if [[ "$SEARCH_SUMMARY" == *"\"matches\":1,"* && "$SEARCH_SUMMARY" == *"\"truncated\":true"* ]]; then
+    echo "✅ Search limit truncated the results"
+else
+    echo "❌ Search with limit=1 returned '$SEARCH_SUMMARY', expected 1 match, truncated"
+fi
+# Each pattern runs twice: the second run is filtered by the trigram index,
+# which must never rule out a file the expression matches
+for pass in 1 2; do
+    check_search 1 "fooo|quux" -d regex=true
+    check_search 1 "abcd?efg" -d regex=true
+    check_search 1 "wxyz{0,2}abc" -d regex=true
+    check_search 1 'sum\(x\) =' -d regex=true
+    check_search 2 'abc\wdef' -d regex=true
+    check_search 1 "abc[[:digit:]]def" -d regex=true
+    check_search 1 "abc[]x]def" -d regex=true
+done
+
 # Clean up
 rm -f cookies.txt
 